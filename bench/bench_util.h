@@ -0,0 +1,89 @@
+/**
+ * @file bench_util.h
+ * @brief Timing and CAN socket helpers shared by the benchmarks.
+ */
+
+#ifndef _OSCC_BENCH_UTIL_H_
+#define _OSCC_BENCH_UTIL_H_
+
+
+#include <linux/can.h>
+#include <net/if.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Current value of the given clock in nanoseconds.
+ */
+static inline uint64_t bench_clock_ns(clockid_t clock)
+{
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (uint64_t)now.tv_sec*1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Monotonic wall-clock time in nanoseconds.
+ */
+static inline uint64_t bench_now_ns()
+{
+  return bench_clock_ns(CLOCK_MONOTONIC);
+}
+
+/**
+ * @brief CPU time consumed by the calling thread in nanoseconds.
+ */
+static inline uint64_t bench_thread_cpu_ns()
+{
+  return bench_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/**
+ * @brief Opens a raw CAN socket bound to the named interface.
+ *
+ * @return socket descriptor, or -1 on failure
+ */
+static inline int bench_open_can_socket(const char* interface)
+{
+  int sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (sock < 0)
+  {
+    perror("Opening CAN socket failed:");
+    return -1;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  size_t length = strnlen(interface, IFNAMSIZ-1);
+  memcpy(ifr.ifr_name, interface, length);
+  ifr.ifr_name[length] = '\0';
+
+  struct sockaddr_can can_address;
+  memset(&can_address, 0, sizeof(can_address));
+  can_address.can_family = AF_CAN;
+
+  if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0)
+  {
+    perror("Finding CAN index failed:");
+    close(sock);
+    return -1;
+  }
+
+  can_address.can_ifindex = ifr.ifr_ifindex;
+  if (bind(sock, (struct sockaddr*) &can_address, sizeof(can_address)) < 0)
+  {
+    perror("Socket binding failed:");
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+
+#endif // _OSCC_BENCH_UTIL_H_
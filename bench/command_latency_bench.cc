@@ -0,0 +1,939 @@
+/**
+ * @file command_latency_bench.cc
+ * @brief Measures end-to-end command latency on a CAN interface, usually
+ *        vcan, with kernel timestamps, under configurable background
+ *        vehicle traffic.
+ *
+ * Every sample sends one command, brake, throttle and steering in turn, twice:
+ *
+ * - A probe socket with CAN_RAW_RECV_OWN_MSGS and SO_TIMESTAMPING writes the
+ *   command frame itself. The TX_SCHED timestamp marks the frame entering
+ *   the device queue, and the kernel receive timestamp of its own echo marks
+ *   it leaving the interface, which vcan and echo-capable drivers only loop
+ *   back once it was sent.
+ * - The library publishes the command. The probe socket timestamps the frame
+ *   on the bus, and a *_with_meta report subscriber gets the kernel receive
+ *   time and the dispatch time of the report answering it.
+ *
+ * Reports come from the built-in responder (-R), which answers every command
+ * frame at once, or from an oscc_emulator started with -e. The emulator also
+ * publishes its periodic reports, so a small share of its samples measure
+ * a periodic report that happened to follow the command.
+ *
+ * All timestamps are software timestamps on CLOCK_REALTIME, except the
+ * dispatch time, which is compared with CLOCK_MONOTONIC. Latencies go into
+ * log-linear histograms that keep values within 1.6%, printed as
+ * p50/p90/p99/p99.9/max and, with -o, written in HdrHistogram's percentile
+ * distribution format.
+ *
+ * Usage: command_latency_bench [-n samples] [-r rate_hz] [-l frames_per_s]
+ *                              [-b vehicle interface] [-V vehicle] [-R] [-S]
+ *                              [-w timeout_ms] [-o histograms.hgrm]
+ *                              <oscc interface>
+ *
+ *   -n  Samples, spread evenly over the three commands (default 3000)
+ *   -r  Samples per second (default 200)
+ *   -l  Background vehicle frames per second (default 0)
+ *   -b  Interface for the background traffic, which also opens it as the
+ *       vehicle CAN (default: the OSCC interface)
+ *   -V  Vehicle whose frames make up the background traffic
+ *   -R  Answer commands with the built-in responder instead of an emulator
+ *   -S  Receive in the SIGIO handler instead of the RX thread
+ *   -w  Time to wait for each echo and report (default 100 ms)
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Needs struct timespec from time.h
+#include <linux/errqueue.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/include/periodic_executor.h"
+#include "core/src/internal/oscc.h"
+#include "core/src/internal/vehicle_profiles.h"
+
+#define DEFAULT_SAMPLES 3000
+#define DEFAULT_RATE_HZ 200
+#define DEFAULT_TIMEOUT_MS 100
+
+// Background traffic is written in batches once per millisecond
+#define LOAD_PERIOD_US 1000
+
+// Values below the sub-bucket count are exact, larger values keep
+// seven significant bits
+#define HISTOGRAM_SUB_BUCKETS 128
+#define HISTOGRAM_HALF_BUCKETS ( HISTOGRAM_SUB_BUCKETS / 2 )
+#define HISTOGRAM_BUCKETS ( HISTOGRAM_SUB_BUCKETS + 57 * HISTOGRAM_HALF_BUCKETS )
+
+// Rows per halving of the remaining percentile in the distribution output
+#define HISTOGRAM_TICKS_PER_HALF 5
+
+typedef enum
+{
+  COMMAND_BRAKE,
+  COMMAND_THROTTLE,
+  COMMAND_STEERING,
+  COMMAND_COUNT
+} command_t;
+
+typedef enum
+{
+  STAGE_ENQUEUE, /*!< Probe write() to TX_SCHED. */
+  STAGE_WIRE, /*!< TX_SCHED to the kernel receive of the own echo. */
+  STAGE_PUBLISH_CALL, /*!< oscc_publish_* call to its return. */
+  STAGE_PUBLISH_BUS, /*!< oscc_publish_* call to the kernel receive of the frame. */
+  STAGE_REPORT, /*!< oscc_publish_* return to the kernel receive of the report. */
+  STAGE_CALLBACK, /*!< oscc_publish_* return to the report dispatch. */
+  STAGE_COUNT
+} stage_t;
+
+typedef struct
+{
+  const char* name;
+  canid_t command_can_id;
+  canid_t report_can_id;
+} command_desc_s;
+
+typedef struct
+{
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t total;
+  uint64_t max_ns;
+  double sum_ns;
+  double sum_squares_ns;
+} latency_histogram_s;
+
+typedef struct
+{
+  uint64_t sched_ns; /*!< TX_SCHED of the probe frame. */
+  uint64_t echo_ns; /*!< Receive of the own echo of the probe frame. */
+  uint64_t bus_ns; /*!< Receive of the frame the library wrote. */
+} probe_stamps_s;
+
+static const command_desc_s global_commands[COMMAND_COUNT] =
+{
+  { "brake", OSCC_BRAKE_COMMAND_CAN_ID, OSCC_BRAKE_REPORT_CAN_ID },
+  { "throttle", OSCC_THROTTLE_COMMAND_CAN_ID, OSCC_THROTTLE_REPORT_CAN_ID },
+  { "steering", OSCC_STEERING_COMMAND_CAN_ID, OSCC_STEERING_REPORT_CAN_ID }
+};
+
+static const char* global_stage_names[STAGE_COUNT] =
+{
+  "write->enqueue",
+  "enqueue->rx",
+  "publish call",
+  "publish->bus",
+  "publish->report",
+  "publish->callback"
+};
+
+static latency_histogram_s global_histograms[STAGE_COUNT][COMMAND_COUNT];
+static unsigned long long global_missed[STAGE_COUNT][COMMAND_COUNT];
+
+static volatile sig_atomic_t global_stop = 0;
+
+// Written by the main loop, read by the report callbacks. Samples are
+// numbered from 1 so that 0 means none is armed.
+static std::atomic<int> global_pending_command(COMMAND_COUNT);
+static std::atomic<uint64_t> global_pending_since_ns(0);
+static std::atomic<uint32_t> global_pending_sample(0);
+
+// Written by the report callbacks, read by the main loop. The timestamps
+// belong to the sample in global_report_sample, so a callback that finishes
+// after its sample timed out cannot pass them off as the next one's.
+static std::atomic<uint32_t> global_report_sample(0);
+static std::atomic<uint64_t> global_report_rx_ns(0);
+static std::atomic<uint64_t> global_report_dispatch_ns(0);
+
+// Background traffic
+static double global_load_fps = 0.0;
+static double global_load_carry = 0.0;
+static int global_load_socket = -1;
+static unsigned long long global_load_written = 0;
+static unsigned long long global_load_dropped = 0;
+
+static void signal_handler(int signal_number)
+{
+  if (signal_number == SIGINT || signal_number == SIGTERM)
+    global_stop = 1;
+}
+
+static uint64_t timespec_ns(struct timespec const* time)
+{
+  return (uint64_t) time->tv_sec*1000000000ULL + (uint64_t) time->tv_nsec;
+}
+
+static size_t histogram_index(uint64_t value)
+{
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return value;
+
+  int shift = (63 - __builtin_clzll(value)) - 6;
+
+  return HISTOGRAM_SUB_BUCKETS
+         + (shift - 1) * HISTOGRAM_HALF_BUCKETS
+         + ((value >> shift) - HISTOGRAM_HALF_BUCKETS);
+}
+
+// Largest value counted in a bucket
+static uint64_t histogram_bucket_value(size_t index)
+{
+  if (index < HISTOGRAM_SUB_BUCKETS)
+    return index;
+
+  size_t shift = (index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_HALF_BUCKETS + 1;
+  uint64_t sub_bucket = (index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_HALF_BUCKETS
+                        + HISTOGRAM_HALF_BUCKETS;
+
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+static void histogram_record(latency_histogram_s* histogram, uint64_t value_ns)
+{
+  ++histogram->counts[histogram_index(value_ns)];
+  ++histogram->total;
+  histogram->sum_ns += value_ns;
+  histogram->sum_squares_ns += (double) value_ns * value_ns;
+
+  if (value_ns > histogram->max_ns)
+    histogram->max_ns = value_ns;
+}
+
+static uint64_t histogram_percentile(latency_histogram_s const* histogram, double percentile)
+{
+  uint64_t target = (uint64_t) (percentile / 100.0 * histogram->total + 0.5);
+  uint64_t count = 0;
+
+  if (target < 1)
+    target = 1;
+
+  for (size_t i=0; i<HISTOGRAM_BUCKETS; ++i)
+  {
+    count += histogram->counts[i];
+    if (count >= target)
+    {
+      uint64_t value = histogram_bucket_value(i);
+      return value < histogram->max_ns ? value : histogram->max_ns;
+    }
+  }
+
+  return histogram->max_ns;
+}
+
+// Records the time from one timestamp to a later one, if both were taken
+static void record_latency(stage_t stage, command_t command, uint64_t from_ns, uint64_t to_ns)
+{
+  if (from_ns==0 || to_ns==0)
+    ++global_missed[stage][command];
+  else
+    histogram_record(&global_histograms[stage][command], to_ns>from_ns ? to_ns - from_ns : 0);
+}
+
+static void report_received(command_t command, oscc_frame_meta_s const* meta)
+{
+  uint32_t sample = global_pending_sample.load(std::memory_order_acquire);
+
+  if (sample == 0
+      || global_pending_command.load(std::memory_order_relaxed) != command
+      || global_report_sample.load(std::memory_order_relaxed) == sample)
+    return;
+
+  // A report received before the command was published answered an
+  // earlier frame
+  uint64_t rx_ns = timespec_ns(&meta->rx_timestamp);
+  if (rx_ns < global_pending_since_ns.load(std::memory_order_relaxed))
+    return;
+
+  global_report_rx_ns.store(rx_ns, std::memory_order_relaxed);
+  global_report_dispatch_ns.store(timespec_ns(&meta->dispatch_time), std::memory_order_relaxed);
+
+  // Only claim the sample if it is still the one being measured
+  uint32_t previous = global_report_sample.load(std::memory_order_relaxed);
+  if (global_pending_sample.load(std::memory_order_relaxed) == sample)
+    global_report_sample.compare_exchange_strong(previous, sample, std::memory_order_release);
+}
+
+static void brake_report_callback(oscc_brake_report_s* report, oscc_frame_meta_s const* meta)
+{
+  (void) report;
+  report_received(COMMAND_BRAKE, meta);
+}
+
+static void throttle_report_callback(oscc_throttle_report_s* report, oscc_frame_meta_s const* meta)
+{
+  (void) report;
+  report_received(COMMAND_THROTTLE, meta);
+}
+
+static void steering_report_callback(oscc_steering_report_s* report, oscc_frame_meta_s const* meta)
+{
+  (void) report;
+  report_received(COMMAND_STEERING, meta);
+}
+
+static oscc_result_t publish_command(command_t command, double value)
+{
+  if (command == COMMAND_BRAKE)
+    return oscc_publish_brake_position(value);
+  else if (command == COMMAND_THROTTLE)
+    return oscc_publish_throttle_position(value);
+  else
+    return oscc_publish_steering_torque(value);
+}
+
+// The same frame the library writes for the command
+static void encode_command(command_t command, double value, struct can_frame* frame)
+{
+  memset(frame, 0, sizeof(*frame));
+  frame->can_id = global_commands[command].command_can_id;
+
+  if (command == COMMAND_BRAKE)
+  {
+    oscc_brake_command_s brake_cmd;
+    oscc_encode_brake_command(&brake_cmd, value);
+    memcpy(frame->data, &brake_cmd, sizeof(brake_cmd));
+    frame->can_dlc = sizeof(brake_cmd);
+  }
+  else if (command == COMMAND_THROTTLE)
+  {
+    oscc_throttle_command_s throttle_cmd;
+    oscc_encode_throttle_command(&throttle_cmd, value);
+    memcpy(frame->data, &throttle_cmd, sizeof(throttle_cmd));
+    frame->can_dlc = sizeof(throttle_cmd);
+  }
+  else
+  {
+    oscc_steering_command_s steering_cmd;
+    oscc_encode_steering_command(&steering_cmd, value);
+    memcpy(frame->data, &steering_cmd, sizeof(steering_cmd));
+    frame->can_dlc = sizeof(steering_cmd);
+  }
+}
+
+static int open_command_socket(const char* interface)
+{
+  int sock = bench_open_can_socket(interface);
+  if (sock < 0)
+    return -1;
+
+  struct can_filter filters[COMMAND_COUNT];
+  for (int c=0; c<COMMAND_COUNT; ++c)
+  {
+    filters[c].can_id = global_commands[c].command_can_id;
+    filters[c].can_mask = CAN_SFF_MASK;
+  }
+
+  if (setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FILTER, filters, sizeof(filters)) < 0)
+  {
+    perror("Setting command filters failed:");
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+static int open_probe_socket(const char* interface)
+{
+  int sock = open_command_socket(interface);
+  if (sock < 0)
+    return -1;
+
+  int enable = 1;
+  if (setsockopt(sock, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &enable, sizeof(enable)) < 0)
+  {
+    perror("Enabling own messages failed:");
+    close(sock);
+    return -1;
+  }
+
+  // Software stamps only: hardware stamps run on the controller clock and
+  // cannot be compared with the others
+  int flags = SOF_TIMESTAMPING_TX_SCHED
+              | SOF_TIMESTAMPING_RX_SOFTWARE
+              | SOF_TIMESTAMPING_SOFTWARE
+              | SOF_TIMESTAMPING_OPT_TSONLY;
+  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+  {
+    perror("Enabling timestamping failed:");
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+// Kernel timestamp of a received message and, for error queue messages,
+// the kind of timestamp
+static uint64_t message_timestamp_ns(struct msghdr* msg, uint32_t* stamp_type)
+{
+  uint64_t stamp_ns = 0;
+
+  for (struct cmsghdr* cmsg=CMSG_FIRSTHDR(msg); cmsg!=NULL; cmsg=CMSG_NXTHDR(msg, cmsg))
+  {
+    if (cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMPING)
+    {
+      struct scm_timestamping stamps;
+      memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+      stamp_ns = timespec_ns(&stamps.ts[0]);
+    }
+    else if (cmsg->cmsg_level==SOL_CAN_RAW && cmsg->cmsg_type==SCM_CAN_RAW_ERRQUEUE)
+    {
+      struct sock_extended_err error;
+      memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+      *stamp_type = error.ee_info;
+    }
+  }
+
+  return stamp_ns;
+}
+
+// Reads everything pending on the probe socket and its error queue
+static void probe_drain(int sock, canid_t can_id, probe_stamps_s* stamps)
+{
+  struct can_frame frame;
+  struct iovec iov;
+  struct msghdr msg;
+  char control[512];
+
+  for (int queue=0; queue<2; ++queue)
+  {
+    while (true)
+    {
+      uint32_t stamp_type = UINT32_MAX;
+
+      iov.iov_base = &frame;
+      iov.iov_len = sizeof(frame);
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      if (recvmsg(sock, &msg, MSG_DONTWAIT | (queue==0 ? MSG_ERRQUEUE : 0)) < 0)
+        break;
+
+      uint64_t stamp_ns = message_timestamp_ns(&msg, &stamp_type);
+
+      if (queue == 0)
+      {
+        if (stamp_type==SCM_TSTAMP_SCHED && stamps->sched_ns==0)
+          stamps->sched_ns = stamp_ns;
+      }
+      else if (frame.can_id != can_id)
+        continue;
+      else if (msg.msg_flags & MSG_CONFIRM)
+      {
+        if (stamps->echo_ns == 0)
+          stamps->echo_ns = stamp_ns;
+      }
+      else if (stamps->bus_ns == 0)
+        stamps->bus_ns = stamp_ns;
+    }
+  }
+}
+
+// Drains the probe socket until the echo, or the library frame and the
+// report for report_sample, arrived
+static void probe_wait(int sock,
+                       canid_t can_id,
+                       probe_stamps_s* stamps,
+                       uint32_t report_sample,
+                       uint64_t deadline_ns)
+{
+  while (!global_stop)
+  {
+    probe_drain(sock, can_id, stamps);
+
+    bool done = report_sample != 0
+                ? stamps->bus_ns!=0
+                  && global_report_sample.load(std::memory_order_acquire)==report_sample
+                : stamps->echo_ns!=0;
+
+    uint64_t now_ns = bench_now_ns();
+    if (done || now_ns>=deadline_ns)
+      break;
+
+    // Reports arrive on the library socket, so check for them every
+    // millisecond
+    struct pollfd fd = { sock, POLLIN, 0 };
+    poll(&fd, 1, 1);
+  }
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+  struct timespec deadline;
+  deadline.tv_sec = deadline_ns / 1000000000ULL;
+  deadline.tv_nsec = deadline_ns % 1000000000ULL;
+
+  while (!global_stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+    ;
+}
+
+// Helper threads leave the signals to the main thread and the SIGIO handler
+static void block_signals()
+{
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGIO);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+}
+
+static oscc_result_t write_load(void* user_data)
+{
+  oscc_vehicle_profile_s const* profile = (oscc_vehicle_profile_s const*) user_data;
+  canid_t can_ids[4] =
+  {
+    profile->wheel_speed_can_id,
+    profile->steering_wheel_angle_can_id,
+    profile->brake_pressure_can_id,
+    profile->speed_can_id
+  };
+
+  global_load_carry += global_load_fps * LOAD_PERIOD_US / 1e6;
+
+  while (global_load_carry >= 1.0)
+  {
+    global_load_carry -= 1.0;
+
+    canid_t can_id = can_ids[global_load_written % 4];
+    if (can_id == OSCC_VEHICLE_NO_CAN_ID)
+      can_id = can_ids[0];
+
+    struct can_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = can_id;
+    frame.can_dlc = CAN_MAX_DLEN;
+    for (int b=0; b<CAN_MAX_DLEN; ++b)
+      frame.data[b] = (uint8_t) (global_load_written + b*31);
+
+    ++global_load_written;
+
+    // A full queue drops the frame, like a busy bus would delay it
+    if (write(global_load_socket, &frame, CAN_MTU) != CAN_MTU)
+      ++global_load_dropped;
+  }
+
+  return OSCC_OK;
+}
+
+static void* load_thread(void* arg)
+{
+  block_signals();
+
+  periodic_executor_s* executor = (periodic_executor_s*) arg;
+  periodic_executor_run(executor,
+                        write_load,
+                        (void*) oscc_vehicle_profile(),
+                        &global_stop);
+
+  return NULL;
+}
+
+// Answers every command frame with its report at once
+static void* responder_thread(void* arg)
+{
+  block_signals();
+
+  int sock = *(int*) arg;
+
+  while (!global_stop)
+  {
+    struct pollfd fd = { sock, POLLIN, 0 };
+    if (poll(&fd, 1, 100) <= 0)
+      continue;
+
+    struct can_frame frame;
+    if (read(sock, &frame, sizeof(frame)) != CAN_MTU)
+      continue;
+
+    for (int c=0; c<COMMAND_COUNT; ++c)
+    {
+      if (frame.can_id != global_commands[c].command_can_id)
+        continue;
+
+      // The three reports share one layout
+      oscc_brake_report_s report;
+      memset(&report, 0, sizeof(report));
+      report.magic[0] = OSCC_MAGIC_BYTE_0;
+      report.magic[1] = OSCC_MAGIC_BYTE_1;
+      report.enabled = 1;
+
+      struct can_frame reply;
+      memset(&reply, 0, sizeof(reply));
+      reply.can_id = global_commands[c].report_can_id;
+      reply.can_dlc = sizeof(report);
+      memcpy(reply.data, &report, sizeof(report));
+
+      if (write(sock, &reply, CAN_MTU) != CAN_MTU)
+        perror("Writing report failed:");
+    }
+  }
+
+  return NULL;
+}
+
+static void run_sample(int probe_socket, unsigned long sample, uint64_t slot_ns, uint64_t period_ns, uint64_t timeout_ns)
+{
+  command_t command = (command_t) (sample % COMMAND_COUNT);
+  canid_t can_id = global_commands[command].command_can_id;
+  double value = (sample / COMMAND_COUNT) % 2 == 0 ? 0.1 : 0.2;
+
+  // The probe writes the command frame itself and sees its own echo
+  probe_stamps_s stamps;
+  memset(&stamps, 0, sizeof(stamps));
+
+  struct can_frame frame;
+  encode_command(command, value, &frame);
+
+  uint64_t write_ns = bench_clock_ns(CLOCK_REALTIME);
+  if (write(probe_socket, &frame, CAN_MTU) != CAN_MTU)
+    perror("Writing probe frame failed:");
+
+  probe_wait(probe_socket, can_id, &stamps, 0, bench_now_ns() + timeout_ns);
+  probe_drain(probe_socket, can_id, &stamps);
+
+  record_latency(STAGE_ENQUEUE, command, write_ns, stamps.sched_ns);
+  record_latency(STAGE_WIRE, command, stamps.sched_ns, stamps.echo_ns);
+
+  // Leave time for the answer to the probe before the library publishes
+  sleep_until(slot_ns + period_ns / 2);
+
+  memset(&stamps, 0, sizeof(stamps));
+  uint32_t report_sample = (uint32_t) sample + 1;
+
+  uint64_t call_ns = bench_clock_ns(CLOCK_REALTIME);
+  global_pending_since_ns.store(call_ns, std::memory_order_relaxed);
+  global_pending_command.store(command, std::memory_order_relaxed);
+  global_pending_sample.store(report_sample, std::memory_order_release);
+
+  oscc_result_t result = publish_command(command, value);
+
+  uint64_t return_ns = bench_clock_ns(CLOCK_REALTIME);
+  uint64_t return_monotonic_ns = bench_now_ns();
+
+  if (result != OSCC_OK)
+    printf("Warning: Publishing the %s command failed\n", global_commands[command].name);
+
+  probe_wait(probe_socket, can_id, &stamps, report_sample, return_monotonic_ns + timeout_ns);
+
+  global_pending_sample.store(0, std::memory_order_release);
+  global_pending_command.store(COMMAND_COUNT, std::memory_order_relaxed);
+
+  bool received = global_report_sample.load(std::memory_order_acquire) == report_sample;
+  uint64_t report_rx_ns = global_report_rx_ns.load(std::memory_order_relaxed);
+  uint64_t report_dispatch_ns = global_report_dispatch_ns.load(std::memory_order_relaxed);
+
+  record_latency(STAGE_PUBLISH_CALL, command, call_ns, return_ns);
+  record_latency(STAGE_PUBLISH_BUS, command, call_ns, stamps.bus_ns);
+  record_latency(STAGE_REPORT, command, return_ns, received ? report_rx_ns : 0);
+  record_latency(STAGE_CALLBACK, command, return_monotonic_ns, received ? report_dispatch_ns : 0);
+}
+
+static void print_results()
+{
+  printf("%-18s %-9s %8s %8s %10s %10s %10s %10s %10s %10s\n",
+         "stage", "command", "count", "missed",
+         "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "mean us");
+
+  for (int s=0; s<STAGE_COUNT; ++s)
+  {
+    for (int c=0; c<COMMAND_COUNT; ++c)
+    {
+      latency_histogram_s const* histogram = &global_histograms[s][c];
+
+      printf("%-18s %-9s %8llu %8llu",
+             global_stage_names[s],
+             global_commands[c].name,
+             (unsigned long long) histogram->total,
+             global_missed[s][c]);
+
+      if (histogram->total == 0)
+      {
+        printf(" %10s %10s %10s %10s %10s %10s\n", "-", "-", "-", "-", "-", "-");
+        continue;
+      }
+
+      printf(" %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+             histogram_percentile(histogram, 50.0) / 1e3,
+             histogram_percentile(histogram, 90.0) / 1e3,
+             histogram_percentile(histogram, 99.0) / 1e3,
+             histogram_percentile(histogram, 99.9) / 1e3,
+             histogram->max_ns / 1e3,
+             histogram->sum_ns / histogram->total / 1e3);
+    }
+  }
+}
+
+// Writes one percentile distribution in HdrHistogram's text format, in us
+static void write_distribution(FILE* file, latency_histogram_s const* histogram)
+{
+  fprintf(file, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+  uint64_t count = 0;
+  double next_percentile = 0.0;
+  int tick = 0;
+
+  for (size_t i=0; i<HISTOGRAM_BUCKETS && count<histogram->total; ++i)
+  {
+    if (histogram->counts[i] == 0)
+      continue;
+
+    count += histogram->counts[i];
+    double percentile = (double) count / histogram->total;
+    uint64_t value = histogram_bucket_value(i);
+    if (value > histogram->max_ns)
+      value = histogram->max_ns;
+
+    // One row per reporting tick passed, as HdrHistogram prints them
+    while (next_percentile<=percentile && next_percentile<1.0)
+    {
+      fprintf(file, "%12.3f %1.12f %10llu %14.2f\n",
+              value / 1e3,
+              next_percentile,
+              (unsigned long long) count,
+              1.0 / (1.0 - next_percentile));
+
+      // The last bucket is printed once, then as the 100% row below
+      if (count == histogram->total)
+        break;
+
+      ++tick;
+      next_percentile = 1.0 - pow(0.5, (double) tick / HISTOGRAM_TICKS_PER_HALF);
+    }
+  }
+
+  fprintf(file, "%12.3f %1.12f %10llu\n",
+          histogram->max_ns / 1e3,
+          1.0,
+          (unsigned long long) histogram->total);
+
+  double mean = histogram->sum_ns / histogram->total;
+  double variance = histogram->sum_squares_ns / histogram->total - mean * mean;
+
+  fprintf(file, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n",
+          mean / 1e3,
+          variance > 0.0 ? sqrt(variance) / 1e3 : 0.0);
+  fprintf(file, "#[Max     = %12.3f, Total count    = %12llu]\n",
+          histogram->max_ns / 1e3,
+          (unsigned long long) histogram->total);
+  fprintf(file, "#[Buckets = %12d, SubBuckets     = %12d]\n",
+          HISTOGRAM_BUCKETS / HISTOGRAM_HALF_BUCKETS,
+          HISTOGRAM_SUB_BUCKETS);
+}
+
+static bool write_histograms(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (file == NULL)
+  {
+    printf("Error: Could not open %s\n", path);
+    return false;
+  }
+
+  for (int s=0; s<STAGE_COUNT; ++s)
+  {
+    for (int c=0; c<COMMAND_COUNT; ++c)
+    {
+      if (global_histograms[s][c].total == 0)
+        continue;
+
+      fprintf(file, "# %s %s\n", global_stage_names[s], global_commands[c].name);
+      write_distribution(file, &global_histograms[s][c]);
+      fprintf(file, "\n");
+    }
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+static void print_usage(const char* program)
+{
+  printf("Usage: %s [-n samples] [-r rate_hz] [-l frames_per_s] [-b vehicle interface] "
+         "[-V vehicle] [-R] [-S] [-w timeout_ms] [-o histograms.hgrm] <oscc interface>\n",
+         program);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long samples = DEFAULT_SAMPLES;
+  double rate_hz = DEFAULT_RATE_HZ;
+  unsigned long timeout_ms = DEFAULT_TIMEOUT_MS;
+  const char* vehicle_interface = NULL;
+  const char* vehicle = NULL;
+  const char* histogram_path = NULL;
+  bool responder = false;
+  oscc_rx_mode_t rx_mode = OSCC_RX_MODE_THREAD;
+  int option = 0;
+
+  while ((option = getopt(argc, argv, "n:r:l:b:V:RSw:o:")) != -1)
+  {
+    if (option == 'n')
+      samples = strtoul(optarg, NULL, 10);
+    else if (option == 'r')
+      rate_hz = strtod(optarg, NULL);
+    else if (option == 'l')
+      global_load_fps = strtod(optarg, NULL);
+    else if (option == 'b')
+      vehicle_interface = optarg;
+    else if (option == 'V')
+      vehicle = optarg;
+    else if (option == 'R')
+      responder = true;
+    else if (option == 'S')
+      rx_mode = OSCC_RX_MODE_SIGNAL;
+    else if (option == 'w')
+      timeout_ms = strtoul(optarg, NULL, 10);
+    else if (option == 'o')
+      histogram_path = optarg;
+    else
+    {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (rate_hz<=0.0 || global_load_fps<0.0)
+  {
+    printf("Error: The rate must be positive and the load not negative\n");
+    return 1;
+  }
+
+  const char* oscc_interface = argv[optind];
+
+  if (vehicle!=NULL && oscc_select_vehicle_by_name(vehicle)!=OSCC_OK)
+    return 1;
+
+  if (oscc_set_rx_mode(rx_mode) != OSCC_OK
+      || init_oscc_can(oscc_interface) != OSCC_OK
+      || (vehicle_interface!=NULL && init_vehicle_can(vehicle_interface)!=OSCC_OK))
+  {
+    printf("Error: Could not open the CAN interfaces\n");
+    return 1;
+  }
+
+  oscc_subscribe_to_brake_reports_with_meta(brake_report_callback);
+  oscc_subscribe_to_throttle_reports_with_meta(throttle_report_callback);
+  oscc_subscribe_to_steering_reports_with_meta(steering_report_callback);
+
+  if (oscc_start_rx() != OSCC_OK)
+  {
+    printf("Error: Could not start receiving\n");
+    oscc_close(0);
+    return 1;
+  }
+
+  int probe_socket = open_probe_socket(oscc_interface);
+  int responder_socket = responder ? open_command_socket(oscc_interface) : -1;
+  global_load_socket = bench_open_can_socket(vehicle_interface != NULL ? vehicle_interface : oscc_interface);
+
+  if (probe_socket<0 || (responder && responder_socket<0) || global_load_socket<0)
+  {
+    printf("Error: Could not open the benchmark sockets\n");
+    oscc_close(0);
+    return 1;
+  }
+
+  // Write only
+  setsockopt(global_load_socket, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0);
+
+  struct sigaction sig;
+  memset(&sig, 0, sizeof(sig));
+  sig.sa_handler = signal_handler;
+  sigaction(SIGINT, &sig, NULL);
+  sigaction(SIGTERM, &sig, NULL);
+
+  pthread_t responder_id;
+  bool responder_started = responder
+                           && pthread_create(&responder_id, NULL, responder_thread, &responder_socket) == 0;
+
+  periodic_executor_s executor;
+  pthread_t load_id;
+  bool load_started = global_load_fps > 0.0
+                      && periodic_executor_init(&executor, LOAD_PERIOD_US) == OSCC_OK
+                      && pthread_create(&load_id, NULL, load_thread, &executor) == 0;
+
+  if ((responder && !responder_started) || (global_load_fps>0.0 && !load_started))
+    printf("Error: Could not start the benchmark threads\n");
+
+  // The emulator takes commands only while enabled
+  if (oscc_enable() != OSCC_OK)
+    printf("Warning: Enabling the modules failed\n");
+
+  printf("Measuring %lu samples at %g Hz with %g background frames/s, %s\n",
+         samples,
+         rate_hz,
+         global_load_fps,
+         responder ? "answered by the built-in responder" : "answered by oscc_emulator -e");
+
+  uint64_t period_ns = (uint64_t) (1e9 / rate_hz);
+  uint64_t timeout_ns = timeout_ms * 1000000ULL;
+  uint64_t slot_ns = bench_now_ns() + 50000000ULL;
+
+  for (unsigned long sample=0; sample<samples && !global_stop; ++sample)
+  {
+    sleep_until(slot_ns);
+    run_sample(probe_socket, sample, slot_ns, period_ns, timeout_ns);
+
+    slot_ns += period_ns;
+
+    // Do not try to catch up after a sample timed out
+    if (slot_ns < bench_now_ns())
+      slot_ns = bench_now_ns();
+  }
+
+  oscc_disable();
+
+  global_stop = 1;
+
+  if (load_started)
+  {
+    pthread_join(load_id, NULL);
+    printf("Background traffic: %llu frames written, %llu dropped\n",
+           global_load_written,
+           global_load_dropped);
+    periodic_executor_print_stats(&executor, "background");
+    periodic_executor_close(&executor);
+  }
+
+  if (responder_started)
+    pthread_join(responder_id, NULL);
+
+  oscc_close(0);
+  close(probe_socket);
+  close(global_load_socket);
+  if (responder_socket >= 0)
+    close(responder_socket);
+
+  print_results();
+
+  if (histogram_path!=NULL && !write_histograms(histogram_path))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file dbc_decode_bench.cc
+ * @brief Measures runtime DBC decoding throughput and checks it against the
+ *        handwritten vehicle decoders.
+ *
+ * Random payloads are generated for every message of the DBC file and
+ * decoded round robin into one signal vector. The rate is compared with the
+ * frame rate of a saturated 1 Mbit/s CAN bus carrying 8-byte frames.
+ *
+ * Usage: dbc_decode_bench [dbc file] [frames]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench/bench_util.h"
+#include "core/include/dbc.h"
+#include "core/include/oscc.h"
+
+#define DEFAULT_DBC_FILE "core/include/vehicles/kia_niro.dbc"
+#define DEFAULT_FRAME_COUNT 20000000UL
+#define FRAMES_PER_MESSAGE 64
+
+// An 8-byte standard frame is at least 111 bits on the wire, before stuffing
+#define BUS_FRAMES_PER_SECOND ( 1000000.0 / 111.0 )
+
+static void random_frame(struct canfd_frame* frame, canid_t can_id)
+{
+  memset(frame, 0, sizeof(*frame));
+  frame->can_id = can_id;
+  frame->len = CAN_MAX_DLEN;
+  for (int i=0; i<CAN_MAX_DLEN; ++i)
+    frame->data[i] = rand() & 0xFF;
+}
+
+static struct can_frame classic_frame(struct canfd_frame const* frame)
+{
+  struct can_frame classic;
+  memset(&classic, 0, sizeof(classic));
+  classic.can_id = frame->can_id;
+  classic.can_dlc = frame->len;
+  memcpy(classic.data, frame->data, CAN_MAX_DLEN);
+  return classic;
+}
+
+// Compares every decoded signal the handwritten getters also produce; the
+// getters truncate wheel speeds to 0.1 km/h
+static unsigned long check_against_getters(dbc_database_s const* database,
+                                           struct canfd_frame const* frames,
+                                           size_t frame_count,
+                                           double* values)
+{
+  struct
+  {
+    const char* name;
+    oscc_result_t (*getter)(struct can_frame const* const, double*);
+    double tolerance;
+    int index;
+  } checks[] =
+  {
+    { "steering_wheel_angle", get_steering_wheel_angle, 1e-9, 0 },
+    { "brake_pressure", get_brake_pressure, 1e-9, 0 },
+    { "vehicle_speed", get_vehicle_speed, 1e-9, 0 },
+    { "wheel_speed_front_left", get_wheel_speed_left_front, 0.1, 0 },
+    { "wheel_speed_front_right", get_wheel_speed_right_front, 0.1, 0 },
+    { "wheel_speed_rear_left", get_wheel_speed_left_rear, 0.1, 0 },
+    { "wheel_speed_rear_right", get_wheel_speed_right_rear, 0.1, 0 },
+  };
+  size_t check_count = sizeof(checks) / sizeof(checks[0]);
+  unsigned long compared = 0;
+  unsigned long mismatches = 0;
+
+  for (size_t c=0; c<check_count; ++c)
+    checks[c].index = dbc_find_signal(database, checks[c].name);
+
+  for (size_t f=0; f<frame_count; ++f)
+  {
+    struct can_frame classic = classic_frame(&frames[f]);
+    dbc_decode_frame(database, &frames[f], values, dbc_signal_count(database));
+
+    for (size_t c=0; c<check_count; ++c)
+    {
+      double expected = 0;
+      if (checks[c].index==DBC_SIGNAL_NOT_FOUND
+          || checks[c].getter(&classic, &expected)!=OSCC_OK)
+        continue;
+
+      ++compared;
+      if (fabs(values[checks[c].index] - expected) > checks[c].tolerance)
+      {
+        if (mismatches == 0)
+          printf("Mismatch: %s decoded %f, getter %f\n",
+                 checks[c].name, values[checks[c].index], expected);
+        ++mismatches;
+      }
+    }
+  }
+
+  printf("Checked %lu values against the handwritten getters, %lu mismatches\n",
+         compared, mismatches);
+
+  return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+  const char* path = argc > 1 ? argv[1] : DEFAULT_DBC_FILE;
+  unsigned long frame_count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_FRAME_COUNT;
+
+  dbc_database_s* database = (dbc_database_s*) malloc(sizeof(dbc_database_s));
+  if (database==NULL || dbc_load(database, path)!=OSCC_OK || frame_count==0)
+  {
+    printf("Usage: %s [dbc file] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  size_t signal_count = dbc_signal_count(database);
+  size_t mix_size = database->message_count * FRAMES_PER_MESSAGE;
+  double* values = (double*) calloc(signal_count, sizeof(double));
+  struct canfd_frame* frames = (struct canfd_frame*) calloc(mix_size, sizeof(struct canfd_frame));
+
+  if (values==NULL || frames==NULL || mix_size==0)
+  {
+    printf("Error: Nothing to decode in %s\n", path);
+    return 1;
+  }
+
+  srand(1);
+  for (size_t i=0; i<mix_size; ++i)
+    random_frame(&frames[i], database->messages[i % database->message_count].can_id);
+
+  printf("%s: %zu messages, %zu signals\n", path, database->message_count, signal_count);
+
+  unsigned long mismatches = check_against_getters(database, frames, mix_size, values);
+
+  unsigned long decoded = 0;
+  uint64_t start_ns = bench_now_ns();
+  uint64_t start_cpu_ns = bench_thread_cpu_ns();
+
+  for (unsigned long i=0; i<frame_count; ++i)
+    decoded += dbc_decode_frame(database, &frames[i % mix_size], values, signal_count);
+
+  uint64_t wall_ns = bench_now_ns() - start_ns;
+  uint64_t cpu_ns = bench_thread_cpu_ns() - start_cpu_ns;
+  double frames_per_second = frame_count * 1e9 / wall_ns;
+
+  printf("%12.0f frames/s %12.0f signals/s %8.2f ns/frame %8.2f cpu ns/frame\n",
+         frames_per_second,
+         decoded * 1e9 / wall_ns,
+         (double) wall_ns / frame_count,
+         (double) cpu_ns / frame_count);
+  printf("%.0fx the frame rate of a saturated 1 Mbit/s bus\n",
+         frames_per_second / BUS_FRAMES_PER_SECOND);
+
+  free(frames);
+  free(values);
+  dbc_free(database);
+  free(database);
+
+  return mismatches == 0 ? 0 : 1;
+}
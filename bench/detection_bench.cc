@@ -0,0 +1,186 @@
+/**
+ * @file detection_bench.cc
+ * @brief Measures oscc_init() startup time, which is dominated by CAN channel
+ *        auto detection, across several vcan interfaces.
+ *
+ * Each interface is given a role. A traffic thread per interface publishes
+ * OSCC reports at the firmware rate (oscc), the vehicle header OBD frames at
+ * 100 Hz (vehicle), or nothing (idle). oscc_init() and oscc_close() are then
+ * run repeatedly and the time spent in oscc_init() is reported.
+ *
+ * Usage: detection_bench <vcan>:<oscc|vehicle|idle> ... [-n runs]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/src/internal/vehicle_profiles.h"
+
+#define MAX_INTERFACES 16
+#define DEFAULT_RUNS 5
+#define OSCC_REPORT_PERIOD_US ( 1000000 / OSCC_BRAKE_REPORT_PUBLISH_FREQ_IN_HZ )
+#define VEHICLE_FRAME_PERIOD_US 10000
+
+typedef enum
+{
+  ROLE_OSCC,
+  ROLE_VEHICLE,
+  ROLE_IDLE
+} interface_role_t;
+
+typedef struct
+{
+  char name[IFNAMSIZ];
+  interface_role_t role;
+  int sock;
+  pthread_t thread;
+} traffic_source_s;
+
+static volatile bool traffic_running = true;
+
+static void write_frame(int sock, canid_t can_id, bool oscc_magic)
+{
+  struct can_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = can_id;
+  frame.can_dlc = 8;
+  if (oscc_magic)
+  {
+    frame.data[0] = OSCC_MAGIC_BYTE_0;
+    frame.data[1] = OSCC_MAGIC_BYTE_1;
+  }
+  if (write(sock, &frame, sizeof(frame)) != sizeof(frame))
+    perror("Writing traffic frame failed:");
+}
+
+static void* traffic_thread(void* arg)
+{
+  traffic_source_s* source = (traffic_source_s*)arg;
+
+  while (traffic_running)
+  {
+    if (source->role == ROLE_OSCC)
+    {
+      write_frame(source->sock, OSCC_BRAKE_REPORT_CAN_ID, true);
+      write_frame(source->sock, OSCC_STEERING_REPORT_CAN_ID, true);
+      write_frame(source->sock, OSCC_THROTTLE_REPORT_CAN_ID, true);
+      usleep(OSCC_REPORT_PERIOD_US);
+    }
+    else
+    {
+      write_frame(source->sock, oscc_vehicle_profile()->steering_wheel_angle_can_id, false);
+      write_frame(source->sock, oscc_vehicle_profile()->wheel_speed_can_id, false);
+      write_frame(source->sock, oscc_vehicle_profile()->brake_pressure_can_id, false);
+      write_frame(source->sock, oscc_vehicle_profile()->speed_can_id, false);
+      usleep(VEHICLE_FRAME_PERIOD_US);
+    }
+  }
+
+  return NULL;
+}
+
+static int parse_source(const char* arg, traffic_source_s* source)
+{
+  const char* separator = strchr(arg, ':');
+  if (separator==NULL || (size_t)(separator-arg)>=IFNAMSIZ)
+    return -1;
+
+  memset(source, 0, sizeof(*source));
+  memcpy(source->name, arg, separator-arg);
+
+  if (strcmp(separator+1, "oscc") == 0)
+    source->role = ROLE_OSCC;
+  else if (strcmp(separator+1, "vehicle") == 0)
+    source->role = ROLE_VEHICLE;
+  else if (strcmp(separator+1, "idle") == 0)
+    source->role = ROLE_IDLE;
+  else
+    return -1;
+
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  traffic_source_s sources[MAX_INTERFACES];
+  size_t source_count = 0;
+  int runs = DEFAULT_RUNS;
+
+  for (int i=1; i<argc; ++i)
+  {
+    if (strcmp(argv[i], "-n")==0 && i+1<argc)
+      runs = atoi(argv[++i]);
+    else if (source_count<MAX_INTERFACES && parse_source(argv[i], &sources[source_count])==0)
+      ++source_count;
+    else
+    {
+      printf("usage %s <vcan>:<oscc|vehicle|idle> ... [-n runs]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (source_count==0 || runs<=0)
+  {
+    printf("usage %s <vcan>:<oscc|vehicle|idle> ... [-n runs]\n", argv[0]);
+    return 1;
+  }
+
+  for (size_t i=0; i<source_count; ++i)
+  {
+    sources[i].sock = -1;
+    if (sources[i].role == ROLE_IDLE)
+      continue;
+
+    sources[i].sock = bench_open_can_socket(sources[i].name);
+    if (sources[i].sock < 0)
+      return 1;
+    pthread_create(&sources[i].thread, NULL, traffic_thread, &sources[i]);
+  }
+
+  double min_ms = 0.0;
+  double max_ms = 0.0;
+  double total_ms = 0.0;
+  int failures = 0;
+
+  for (int run=0; run<runs; ++run)
+  {
+    uint64_t start = bench_now_ns();
+    oscc_result_t result = oscc_init();
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+
+    if (result != OSCC_OK)
+      ++failures;
+    oscc_close(0);
+
+    total_ms += elapsed_ms;
+    if (run==0 || elapsed_ms<min_ms)
+      min_ms = elapsed_ms;
+    if (run==0 || elapsed_ms>max_ms)
+      max_ms = elapsed_ms;
+  }
+
+  traffic_running = false;
+  for (size_t i=0; i<source_count; ++i)
+  {
+    if (sources[i].sock >= 0)
+    {
+      pthread_join(sources[i].thread, NULL);
+      close(sources[i].sock);
+    }
+  }
+
+  printf("interfaces=%zu runs=%d failures=%d oscc_init ms min=%.1f mean=%.1f max=%.1f\n",
+         source_count,
+         runs,
+         failures,
+         min_ms,
+         total_ms / runs,
+         max_ms);
+
+  return failures == 0 ? 0 : 1;
+}
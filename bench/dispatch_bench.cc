@@ -0,0 +1,216 @@
+/**
+ * @file dispatch_bench.cc
+ * @brief Compares CAN ID table dispatch with the magic check and if/else
+ *        chain it replaced.
+ *
+ * Both strategies route the same mix of OSCC reports and vehicle OBD frames
+ * to subscribers that count them. With the chain, OBD frames reach a single
+ * OBD subscriber that picks out the wanted IDs itself, as callers had to;
+ * with the table, each wanted ID has its own subscriber.
+ *
+ * Usage: dispatch_bench [frames] [wanted OBD IDs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/src/internal/dispatch.h"
+
+#define DEFAULT_FRAME_COUNT 20000000UL
+#define DEFAULT_WANTED_ID_COUNT 8
+#define MAX_WANTED_ID_COUNT 32
+#define REPORT_COUNT 4
+
+typedef struct
+{
+  unsigned long reports;
+  unsigned long obd[MAX_WANTED_ID_COUNT];
+} counts_s;
+
+typedef struct
+{
+  counts_s* counts;
+  size_t index;
+} id_counter_s;
+
+static counts_s global_counts;
+static canid_t global_wanted_ids[MAX_WANTED_ID_COUNT];
+static size_t global_wanted_id_count = DEFAULT_WANTED_ID_COUNT;
+
+static void count_brake(oscc_brake_report_s*, oscc_frame_meta_s const*, void* counts)
+{
+  ++((counts_s*) counts)->reports;
+}
+
+static void count_throttle(oscc_throttle_report_s*, oscc_frame_meta_s const*, void* counts)
+{
+  ++((counts_s*) counts)->reports;
+}
+
+static void count_steering(oscc_steering_report_s*, oscc_frame_meta_s const*, void* counts)
+{
+  ++((counts_s*) counts)->reports;
+}
+
+static void count_fault(oscc_fault_report_s*, oscc_frame_meta_s const*, void* counts)
+{
+  ++((counts_s*) counts)->reports;
+}
+
+// What an OBD subscriber had to do before per-ID subscriptions: compare the
+// frame against every ID it wants
+static void count_obd_by_id(struct canfd_frame* frame, oscc_frame_meta_s const*, void* counts)
+{
+  for (size_t i=0; i<global_wanted_id_count; ++i)
+  {
+    if (frame->can_id == global_wanted_ids[i])
+    {
+      ++((counts_s*) counts)->obd[i];
+      break;
+    }
+  }
+}
+
+static void count_obd(struct canfd_frame*, oscc_frame_meta_s const*, void* counter)
+{
+  id_counter_s* id_counter = (id_counter_s*) counter;
+  ++id_counter->counts->obd[id_counter->index];
+}
+
+// The dispatch used before the table, for a channel without vehicle CAN
+static void chain_dispatch(struct canfd_frame* rx_frame, oscc_frame_meta_s const* meta)
+{
+  if (rx_frame->data[0]==OSCC_MAGIC_BYTE_0 && rx_frame->data[1]==OSCC_MAGIC_BYTE_1)
+  {
+    if (rx_frame->can_id == OSCC_STEERING_REPORT_CAN_ID)
+      oscc_notify_steering_report((oscc_steering_report_s*) rx_frame->data, meta);
+    else if (rx_frame->can_id == OSCC_THROTTLE_REPORT_CAN_ID)
+      oscc_notify_throttle_report((oscc_throttle_report_s*) rx_frame->data, meta);
+    else if (rx_frame->can_id == OSCC_BRAKE_REPORT_CAN_ID)
+      oscc_notify_brake_report((oscc_brake_report_s*) rx_frame->data, meta);
+    else if (rx_frame->can_id == OSCC_FAULT_REPORT_CAN_ID)
+      oscc_notify_fault_report((oscc_fault_report_s*) rx_frame->data, meta);
+  }
+  else
+    oscc_notify_obd_frame(rx_frame, meta);
+}
+
+static void table_dispatch(struct canfd_frame* rx_frame, oscc_frame_meta_s const* meta)
+{
+  oscc_dispatch_frame(rx_frame, meta, OSCC_DISPATCH_REPORTS | OSCC_DISPATCH_OBD);
+}
+
+// One frame per report and per wanted OBD ID, so the mix is a quarter
+// reports at the default ID count
+static size_t build_frame_mix(struct canfd_frame* frames)
+{
+  const canid_t report_ids[REPORT_COUNT] =
+  {
+    OSCC_BRAKE_REPORT_CAN_ID,
+    OSCC_THROTTLE_REPORT_CAN_ID,
+    OSCC_STEERING_REPORT_CAN_ID,
+    OSCC_FAULT_REPORT_CAN_ID
+  };
+
+  size_t count = 0;
+
+  for (size_t i=0; i<REPORT_COUNT; ++i)
+  {
+    memset(&frames[count], 0, sizeof(frames[count]));
+    frames[count].can_id = report_ids[i];
+    frames[count].len = CAN_MAX_DLEN;
+    frames[count].data[0] = OSCC_MAGIC_BYTE_0;
+    frames[count].data[1] = OSCC_MAGIC_BYTE_1;
+    ++count;
+  }
+
+  for (size_t i=0; i<global_wanted_id_count; ++i)
+  {
+    memset(&frames[count], 0, sizeof(frames[count]));
+    frames[count].can_id = global_wanted_ids[i];
+    frames[count].len = CAN_MAX_DLEN;
+    ++count;
+  }
+
+  return count;
+}
+
+static void run(const char* name,
+                void(*dispatch)(struct canfd_frame*, oscc_frame_meta_s const*),
+                struct canfd_frame* frames,
+                size_t mix_size,
+                unsigned long frame_count)
+{
+  oscc_frame_meta_s meta;
+  memset(&meta, 0, sizeof(meta));
+  memset(&global_counts, 0, sizeof(global_counts));
+
+  uint64_t start_ns = bench_now_ns();
+  uint64_t start_cpu_ns = bench_thread_cpu_ns();
+
+  for (unsigned long i=0; i<frame_count; ++i)
+    dispatch(&frames[i % mix_size], &meta);
+
+  uint64_t wall_ns = bench_now_ns() - start_ns;
+  uint64_t cpu_ns = bench_thread_cpu_ns() - start_cpu_ns;
+
+  unsigned long obd = 0;
+  for (size_t i=0; i<global_wanted_id_count; ++i)
+    obd += global_counts.obd[i];
+
+  printf("%-6s %12.0f frames/s %8.2f ns/frame %8.2f cpu ns/frame  (reports %lu, obd %lu)\n",
+         name,
+         frame_count * 1e9 / wall_ns,
+         (double) wall_ns / frame_count,
+         (double) cpu_ns / frame_count,
+         global_counts.reports,
+         obd);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long frame_count = DEFAULT_FRAME_COUNT;
+  if (argc > 1)
+    frame_count = strtoul(argv[1], NULL, 10);
+  if (argc > 2)
+    global_wanted_id_count = strtoul(argv[2], NULL, 10);
+
+  if (frame_count==0 || global_wanted_id_count>MAX_WANTED_ID_COUNT)
+  {
+    printf("Usage: %s [frames] [wanted OBD IDs, max %d]\n", argv[0], MAX_WANTED_ID_COUNT);
+    return 1;
+  }
+
+  // Spread the wanted IDs over the OBD range above the OSCC IDs
+  for (size_t i=0; i<global_wanted_id_count; ++i)
+    global_wanted_ids[i] = 0x200 + 0x20*i;
+
+  struct canfd_frame frames[REPORT_COUNT + MAX_WANTED_ID_COUNT];
+  size_t mix_size = build_frame_mix(frames);
+  oscc_dispatch_init();
+
+  printf("%zu wanted OBD IDs\n", global_wanted_id_count);
+
+  oscc_add_brake_report_subscriber(count_brake, &global_counts);
+  oscc_add_throttle_report_subscriber(count_throttle, &global_counts);
+  oscc_add_steering_report_subscriber(count_steering, &global_counts);
+  oscc_add_fault_report_subscriber(count_fault, &global_counts);
+
+  oscc_subscription_t obd = oscc_add_obd_subscriber(count_obd_by_id, &global_counts);
+  run("chain", chain_dispatch, frames, mix_size, frame_count);
+  oscc_unsubscribe(obd);
+
+  id_counter_s counters[MAX_WANTED_ID_COUNT];
+  for (size_t i=0; i<global_wanted_id_count; ++i)
+  {
+    counters[i].counts = &global_counts;
+    counters[i].index = i;
+    oscc_add_can_id_subscriber(global_wanted_ids[i], count_obd, &counters[i]);
+  }
+  run("table", table_dispatch, frames, mix_size, frame_count);
+
+  return 0;
+}
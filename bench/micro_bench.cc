@@ -0,0 +1,507 @@
+/**
+ * @file micro_bench.cc
+ * @brief Microbenchmark suite for the encode, write, dispatch, decode and
+ *        startup paths, with machine-readable results for regression checks.
+ *
+ * Every benchmark runs enough iterations to fill the minimum time, a few
+ * times over, and the fastest repetition is reported. Benchmarks that need
+ * a socket run against the given vcan interface and are skipped without
+ * one. Results are printed as a table, and written as JSON in the layout
+ * of Google Benchmark's --benchmark_out, so its compare.py can diff two
+ * runs.
+ *
+ * Usage: micro_bench [-i vcan interface] [-o results.json] [-t min seconds]
+ *                    [-r repetitions] [-f name filter]
+ */
+
+#include <linux/can/raw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/src/internal/dispatch.h"
+#include "core/src/internal/oscc.h"
+#include "core/src/internal/vehicle_profiles.h"
+
+#define DEFAULT_MIN_TIME_S 0.2
+#define DEFAULT_REPETITIONS 3
+#define MAX_RESULTS 64
+#define MAX_ITERATIONS 1000000000ULL
+
+// Frames written per drain, well within the default receive buffer
+#define DRAIN_BURST_SIZE 64
+
+typedef struct
+{
+  uint64_t wall_ns;
+  uint64_t cpu_ns;
+  uint64_t items; /*!< Frames or calls processed, for items_per_second. */
+} bench_timing_s;
+
+/**
+ * @brief Runs a benchmark for the given number of iterations and reports
+ *        the time spent in the measured part only.
+ */
+typedef void (*bench_fn_t)(uint64_t iterations, bench_timing_s* timing);
+
+typedef struct
+{
+  const char* name;
+  bench_fn_t run;
+  bool needs_vcan;
+} bench_case_s;
+
+typedef struct
+{
+  const char* name;
+  uint64_t iterations;
+  double real_ns; /*!< Per iteration. */
+  double cpu_ns; /*!< Per iteration. */
+  double items_per_second;
+} bench_result_s;
+
+static const char* global_vcan = NULL;
+static int global_writer_socket = -1;
+static volatile double global_sink = 0.0;
+
+// Starts the timed part of a benchmark
+static void timing_start(bench_timing_s* timing)
+{
+  timing->wall_ns -= bench_now_ns();
+  timing->cpu_ns -= bench_thread_cpu_ns();
+}
+
+// Ends the timed part of a benchmark
+static void timing_stop(bench_timing_s* timing)
+{
+  timing->wall_ns += bench_now_ns();
+  timing->cpu_ns += bench_thread_cpu_ns();
+}
+
+static void fill_obd_frame(struct can_frame* frame, canid_t can_id, uint64_t i)
+{
+  memset(frame, 0, sizeof(*frame));
+  frame->can_id = can_id;
+  frame->can_dlc = CAN_MAX_DLEN;
+  for (int b=0; b<CAN_MAX_DLEN; ++b)
+    frame->data[b] = (uint8_t) (i*7 + b*31);
+}
+
+static void bench_encode_brake_command(uint64_t iterations, bench_timing_s* timing)
+{
+  bcm_tx_msg_s tx_msg;
+  oscc_brake_command_s brake_cmd;
+  size_t size = 0;
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    oscc_encode_brake_command(&brake_cmd, (double) (i & 1023) / 1023.0);
+    size += oscc_build_command_message(&tx_msg,
+                                       false,
+                                       0,
+                                       0,
+                                       OSCC_BRAKE_COMMAND_CAN_ID,
+                                       &brake_cmd,
+                                       sizeof(brake_cmd));
+  }
+  timing_stop(timing);
+
+  global_sink = size + tx_msg.raw[10];
+  timing->items = iterations;
+}
+
+static void bench_encode_packed_command(uint64_t iterations, bench_timing_s* timing)
+{
+  bcm_tx_msg_s tx_msg;
+  oscc_packed_command_s packed_cmd;
+  size_t size = 0;
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    double value = (double) (i & 1023) / 1023.0;
+    oscc_encode_packed_command(&packed_cmd, value, value, -value);
+    size += oscc_build_command_message(&tx_msg,
+                                       false,
+                                       0,
+                                       0,
+                                       OSCC_PACKED_COMMAND_CAN_ID,
+                                       &packed_cmd,
+                                       sizeof(packed_cmd));
+  }
+  timing_stop(timing);
+
+  global_sink = size + tx_msg.raw[10];
+  timing->items = iterations;
+}
+
+static void bench_oscc_can_write(uint64_t iterations, bench_timing_s* timing)
+{
+  oscc_brake_command_s brake_cmd;
+  unsigned long failures = 0;
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    oscc_encode_brake_command(&brake_cmd, (double) (i & 1023) / 1023.0);
+    if (oscc_can_write(OSCC_BRAKE_COMMAND_CAN_ID, &brake_cmd, sizeof(brake_cmd)) != OSCC_OK)
+      ++failures;
+  }
+  timing_stop(timing);
+
+  if (failures > 0)
+    printf("Warning: %lu writes failed\n", failures);
+  timing->items = iterations;
+}
+
+// Writes bursts of reports and vehicle frames to vcan and times only the
+// drain, as the SIGIO handler runs it
+static void bench_oscc_update_status(uint64_t iterations, bench_timing_s* timing)
+{
+  oscc_vehicle_profile_s const* profile = oscc_vehicle_profile();
+  canid_t obd_ids[3] =
+  {
+    profile->wheel_speed_can_id,
+    profile->steering_wheel_angle_can_id,
+    profile->brake_pressure_can_id
+  };
+
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    for (int f=0; f<DRAIN_BURST_SIZE; ++f)
+    {
+      struct can_frame frame;
+      if (f % 4 == 0)
+      {
+        fill_obd_frame(&frame, OSCC_BRAKE_REPORT_CAN_ID, f);
+        frame.data[0] = OSCC_MAGIC_BYTE_0;
+        frame.data[1] = OSCC_MAGIC_BYTE_1;
+      }
+      else
+        fill_obd_frame(&frame, obd_ids[f % 3], f);
+
+      if (write(global_writer_socket, &frame, CAN_MTU) != CAN_MTU)
+        perror("Writing frame failed:");
+    }
+
+    timing_start(timing);
+    oscc_update_status(SIGIO, NULL, NULL);
+    timing_stop(timing);
+  }
+
+  timing->items = iterations * DRAIN_BURST_SIZE;
+}
+
+static void bench_oscc_dispatch_frame(uint64_t iterations, bench_timing_s* timing)
+{
+  struct canfd_frame frames[4];
+  oscc_frame_meta_s meta;
+  canid_t ids[4] =
+  {
+    OSCC_BRAKE_REPORT_CAN_ID,
+    oscc_vehicle_profile()->wheel_speed_can_id,
+    oscc_vehicle_profile()->steering_wheel_angle_can_id,
+    oscc_vehicle_profile()->brake_pressure_can_id
+  };
+
+  memset(frames, 0, sizeof(frames));
+  memset(&meta, 0, sizeof(meta));
+  for (int f=0; f<4; ++f)
+  {
+    fill_obd_frame((struct can_frame*) &frames[f], ids[f], f);
+    frames[f].data[0] = OSCC_MAGIC_BYTE_0;
+    frames[f].data[1] = OSCC_MAGIC_BYTE_1;
+  }
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+    oscc_dispatch_frame(&frames[i & 3], &meta, OSCC_DISPATCH_REPORTS | OSCC_DISPATCH_OBD);
+  timing_stop(timing);
+
+  timing->items = iterations;
+}
+
+#define DECODE_BENCH(function, can_id_field)                                    \
+static void bench_##function(uint64_t iterations, bench_timing_s* timing)      \
+{                                                                               \
+  struct can_frame frames[256];                                                 \
+  double sum = 0.0;                                                             \
+  double value = 0.0;                                                           \
+                                                                                \
+  for (int f=0; f<256; ++f)                                                     \
+    fill_obd_frame(&frames[f], oscc_vehicle_profile()->can_id_field, f);        \
+                                                                                \
+  timing_start(timing);                                                         \
+  for (uint64_t i=0; i<iterations; ++i)                                         \
+  {                                                                             \
+    function(&frames[i & 255], &value);                                         \
+    sum += value;                                                               \
+  }                                                                             \
+  timing_stop(timing);                                                          \
+                                                                                \
+  global_sink = sum;                                                            \
+  timing->items = iterations;                                                   \
+}
+
+DECODE_BENCH(get_wheel_speed_left_front, wheel_speed_can_id)
+DECODE_BENCH(get_wheel_speed_right_front, wheel_speed_can_id)
+DECODE_BENCH(get_wheel_speed_left_rear, wheel_speed_can_id)
+DECODE_BENCH(get_wheel_speed_right_rear, wheel_speed_can_id)
+DECODE_BENCH(get_steering_wheel_angle, steering_wheel_angle_can_id)
+DECODE_BENCH(get_brake_pressure, brake_pressure_can_id)
+DECODE_BENCH(get_vehicle_speed, speed_can_id)
+
+static void bench_construct_interfaces_list(uint64_t iterations, bench_timing_s* timing)
+{
+  can_interface_list_s list;
+  size_t found = 0;
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    if (construct_interfaces_list(&list) == OSCC_OK)
+      found += list.size;
+  }
+  timing_stop(timing);
+
+  global_sink = found;
+  timing->items = iterations;
+}
+
+static void bench_oscc_channel_identity(uint64_t iterations, bench_timing_s* timing)
+{
+  can_channel_identity_s identity;
+  unsigned int ifindex = 0;
+
+  timing_start(timing);
+  for (uint64_t i=0; i<iterations; ++i)
+  {
+    if (oscc_channel_identity(global_vcan, &identity) == OSCC_OK)
+      ifindex += identity.ifindex;
+  }
+  timing_stop(timing);
+
+  global_sink = ifindex;
+  timing->items = iterations;
+}
+
+static const bench_case_s global_cases[] =
+{
+  { "encode/brake_command", bench_encode_brake_command, false },
+  { "encode/packed_command", bench_encode_packed_command, false },
+  { "write/oscc_can_write", bench_oscc_can_write, true },
+  { "dispatch/oscc_dispatch_frame", bench_oscc_dispatch_frame, false },
+  { "dispatch/oscc_update_status", bench_oscc_update_status, true },
+  { "decode/get_wheel_speed_left_front", bench_get_wheel_speed_left_front, false },
+  { "decode/get_wheel_speed_right_front", bench_get_wheel_speed_right_front, false },
+  { "decode/get_wheel_speed_left_rear", bench_get_wheel_speed_left_rear, false },
+  { "decode/get_wheel_speed_right_rear", bench_get_wheel_speed_right_rear, false },
+  { "decode/get_steering_wheel_angle", bench_get_steering_wheel_angle, false },
+  { "decode/get_brake_pressure", bench_get_brake_pressure, false },
+  { "decode/get_vehicle_speed", bench_get_vehicle_speed, false },
+  { "startup/construct_interfaces_list", bench_construct_interfaces_list, false },
+  { "startup/oscc_channel_identity", bench_oscc_channel_identity, true }
+};
+
+#define CASE_COUNT ( sizeof(global_cases) / sizeof(global_cases[0]) )
+
+static void run_case(bench_case_s const* bench_case,
+                     double min_time_s,
+                     unsigned int repetitions,
+                     bench_result_s* result)
+{
+  uint64_t min_time_ns = (uint64_t) (min_time_s * 1e9);
+  uint64_t iterations = 1;
+  bench_timing_s timing;
+
+  // Grow the iteration count until one run fills the minimum time
+  while (true)
+  {
+    memset(&timing, 0, sizeof(timing));
+    bench_case->run(iterations, &timing);
+
+    if (timing.wall_ns>=min_time_ns || iterations>=MAX_ITERATIONS)
+      break;
+
+    double scale = timing.wall_ns > 0 ? 1.4 * min_time_ns / timing.wall_ns : 100.0;
+    if (scale > 100.0)
+      scale = 100.0;
+    iterations = (uint64_t) (iterations * scale) + 1;
+  }
+
+  bench_timing_s best = timing;
+  for (unsigned int r=1; r<repetitions; ++r)
+  {
+    memset(&timing, 0, sizeof(timing));
+    bench_case->run(iterations, &timing);
+    if (timing.wall_ns < best.wall_ns)
+      best = timing;
+  }
+
+  result->name = bench_case->name;
+  result->iterations = iterations;
+  result->real_ns = (double) best.wall_ns / iterations;
+  result->cpu_ns = (double) best.cpu_ns / iterations;
+  result->items_per_second = best.wall_ns > 0 ? best.items * 1e9 / best.wall_ns : 0.0;
+}
+
+static bool write_json(const char* path, bench_result_s const* results, size_t count)
+{
+  FILE* file = strcmp(path, "-")==0 ? stdout : fopen(path, "w");
+  if (file == NULL)
+  {
+    printf("Error: Could not open %s\n", path);
+    return false;
+  }
+
+  char date[64];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+  char host[64];
+  if (gethostname(host, sizeof(host)) != 0)
+    strcpy(host, "unknown");
+  host[sizeof(host) - 1] = '\0';
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"context\": {\n");
+  fprintf(file, "    \"date\": \"%s\",\n", date);
+  fprintf(file, "    \"host_name\": \"%s\",\n", host);
+  fprintf(file, "    \"executable\": \"micro_bench\",\n");
+  fprintf(file, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+  fprintf(file, "    \"vcan\": \"%s\",\n", global_vcan != NULL ? global_vcan : "");
+  fprintf(file, "    \"vehicle\": \"%s\"\n", oscc_vehicle_profile()->name);
+  fprintf(file, "  },\n");
+  fprintf(file, "  \"benchmarks\": [\n");
+
+  for (size_t i=0; i<count; ++i)
+  {
+    fprintf(file, "    {\n");
+    fprintf(file, "      \"name\": \"%s\",\n", results[i].name);
+    fprintf(file, "      \"run_name\": \"%s\",\n", results[i].name);
+    fprintf(file, "      \"run_type\": \"iteration\",\n");
+    fprintf(file, "      \"iterations\": %llu,\n", (unsigned long long) results[i].iterations);
+    fprintf(file, "      \"real_time\": %.3f,\n", results[i].real_ns);
+    fprintf(file, "      \"cpu_time\": %.3f,\n", results[i].cpu_ns);
+    fprintf(file, "      \"time_unit\": \"ns\",\n");
+    fprintf(file, "      \"items_per_second\": %.1f\n", results[i].items_per_second);
+    fprintf(file, "    }%s\n", i + 1 < count ? "," : "");
+  }
+
+  fprintf(file, "  ]\n");
+  fprintf(file, "}\n");
+
+  if (file != stdout)
+    fclose(file);
+
+  return true;
+}
+
+static bool open_vcan()
+{
+  if (init_oscc_can(global_vcan) != OSCC_OK)
+    return false;
+
+  oscc_init_rx_batch();
+  oscc_dispatch_init();
+
+  global_writer_socket = bench_open_can_socket(global_vcan);
+  if (global_writer_socket < 0)
+    return false;
+
+  // Write only, so the commands written by the library do not queue up here
+  setsockopt(global_writer_socket, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0);
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  const char* json_path = NULL;
+  const char* filter = NULL;
+  double min_time_s = DEFAULT_MIN_TIME_S;
+  unsigned int repetitions = DEFAULT_REPETITIONS;
+  int option = 0;
+
+  while ((option = getopt(argc, argv, "i:o:t:r:f:")) != -1)
+  {
+    if (option == 'i')
+      global_vcan = optarg;
+    else if (option == 'o')
+      json_path = optarg;
+    else if (option == 't')
+      min_time_s = strtod(optarg, NULL);
+    else if (option == 'r')
+      repetitions = strtoul(optarg, NULL, 10);
+    else if (option == 'f')
+      filter = optarg;
+    else
+    {
+      printf("Usage: %s [-i vcan interface] [-o results.json] [-t min seconds] "
+             "[-r repetitions] [-f name filter]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (min_time_s<=0.0 || repetitions==0)
+  {
+    printf("Error: The minimum time and repetitions must be positive\n");
+    return 1;
+  }
+
+  if (global_vcan!=NULL && !open_vcan())
+  {
+    printf("Error: Could not open %s\n", global_vcan);
+    return 1;
+  }
+
+  // The dispatch benchmark needs the table even without an interface
+  if (global_vcan == NULL)
+    oscc_dispatch_init();
+
+  bench_result_s results[MAX_RESULTS];
+  size_t result_count = 0;
+
+  printf("%-40s %12s %12s %14s %14s\n", "benchmark", "real ns", "cpu ns", "iterations", "items/s");
+
+  for (size_t c=0; c<CASE_COUNT && result_count<MAX_RESULTS; ++c)
+  {
+    bench_case_s const* bench_case = &global_cases[c];
+
+    if (filter!=NULL && strstr(bench_case->name, filter)==NULL)
+      continue;
+
+    if (bench_case->needs_vcan && global_vcan==NULL)
+    {
+      printf("%-40s skipped, needs -i <vcan interface>\n", bench_case->name);
+      continue;
+    }
+
+    bench_result_s* result = &results[result_count++];
+    run_case(bench_case, min_time_s, repetitions, result);
+
+    printf("%-40s %12.2f %12.2f %14llu %14.0f\n",
+           result->name,
+           result->real_ns,
+           result->cpu_ns,
+           (unsigned long long) result->iterations,
+           result->items_per_second);
+  }
+
+  if (global_writer_socket >= 0)
+  {
+    close(global_writer_socket);
+    oscc_close(0);
+  }
+
+  if (json_path!=NULL && !write_json(json_path, results, result_count))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file recorder_bench.cc
+ * @brief Measures the cost of recording a frame and checks the ring file
+ *        written by two concurrent channels.
+ *
+ * One thread per channel role records frames as the RX path does, each
+ * carrying its own frame counter in the payload, into a ring smaller than
+ * the frame count so it wraps. The file is then read back: every slot must
+ * hold a complete record of the last lap, and each channel's counters must
+ * increase in sequence order. The single-core cost per frame is compared
+ * with two buses at 500 kbit/s carrying back to back frames of the shortest
+ * kind.
+ *
+ * Usage: recorder_bench [file] [frames per channel] [capacity]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/include/recorder.h"
+#include "core/src/internal/recorder.h"
+
+#define DEFAULT_PATH "/tmp/oscc_recorder_bench.rec"
+#define DEFAULT_FRAME_COUNT 10000000UL
+#define DEFAULT_CAPACITY 1000000UL
+
+// A data frame with no payload is 47 bits including the interframe space,
+// before bit stuffing
+#define BUS_BITRATE 500000.0
+#define SHORTEST_FRAME_BITS 47.0
+#define BUS_COUNT 2
+
+typedef struct
+{
+  pthread_t thread;
+  oscc_recorder_channel_t channel;
+  unsigned long frames;
+  uint64_t cpu_ns;
+} channel_writer_s;
+
+static void* channel_writer_thread(void* arg)
+{
+  channel_writer_s* writer = (channel_writer_s*) arg;
+
+  struct canfd_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = writer->channel==OSCC_RECORDER_CHANNEL_OSCC ? 0x73 : 0x2B0;
+  frame.len = CAN_MAX_DLEN;
+
+  uint64_t start_cpu_ns = bench_thread_cpu_ns();
+
+  for (unsigned long i=0; i<writer->frames; ++i)
+  {
+    memcpy(frame.data, &i, sizeof(i));
+    oscc_recorder_record(writer->channel, 0, &frame, bench_clock_ns(CLOCK_REALTIME));
+  }
+
+  writer->cpu_ns = bench_thread_cpu_ns() - start_cpu_ns;
+
+  return NULL;
+}
+
+static unsigned long check_file(const char* path, unsigned long frames_per_channel)
+{
+  unsigned long failures = 0;
+
+  int fd = open(path, O_RDONLY);
+  struct stat file_stat;
+  if (fd<0 || fstat(fd, &file_stat)!=0)
+  {
+    printf("Error: Could not open %s\n", path);
+    return 1;
+  }
+
+  void* mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    printf("Error: Could not map %s\n", path);
+    return 1;
+  }
+
+  oscc_recorder_header_s const* header = (oscc_recorder_header_s const*) mapping;
+  oscc_recorder_record_s const* records =
+    (oscc_recorder_record_s const*) ((char const*) mapping + header->header_size);
+  uint64_t capacity = header->record_capacity;
+  uint64_t written = header->records_written;
+
+  if (memcmp(header->magic, OSCC_RECORDER_MAGIC, sizeof(OSCC_RECORDER_MAGIC))!=0
+      || header->record_size!=sizeof(oscc_recorder_record_s)
+      || written!=BUS_COUNT*frames_per_channel)
+  {
+    printf("Error: Bad header, %lu records written\n", (unsigned long) written);
+    munmap(mapping, file_stat.st_size);
+    return 1;
+  }
+
+  uint64_t first = written > capacity ? written - capacity : 0;
+  uint64_t last_counter[OSCC_RECORDER_CHANNEL_COUNT];
+  bool seen[OSCC_RECORDER_CHANNEL_COUNT] = { false, false };
+
+  for (uint64_t n=first; n<written; ++n)
+  {
+    oscc_recorder_record_s const* record = &records[n % capacity];
+    uint64_t counter = 0;
+    memcpy(&counter, record->data, sizeof(counter));
+
+    if (record->sequence!=n+1 || record->channel>=OSCC_RECORDER_CHANNEL_COUNT)
+    {
+      ++failures;
+      continue;
+    }
+
+    if (seen[record->channel] && counter<=last_counter[record->channel])
+      ++failures;
+
+    seen[record->channel] = true;
+    last_counter[record->channel] = counter;
+  }
+
+  printf("file     %lu records in a ring of %lu, %lu bad\n",
+         (unsigned long) written, (unsigned long) capacity, failures);
+
+  munmap(mapping, file_stat.st_size);
+
+  return failures;
+}
+
+int main(int argc, char** argv)
+{
+  const char* path = argc > 1 ? argv[1] : DEFAULT_PATH;
+  unsigned long frame_count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_FRAME_COUNT;
+  unsigned long capacity = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_CAPACITY;
+
+  if (frame_count==0 || capacity==0)
+  {
+    printf("Usage: %s [file] [frames per channel] [capacity]\n", argv[0]);
+    return 1;
+  }
+
+  // Not recording
+  struct canfd_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  uint64_t start_ns = bench_thread_cpu_ns();
+  for (unsigned long i=0; i<frame_count; ++i)
+    oscc_recorder_record(OSCC_RECORDER_CHANNEL_OSCC, 0, &frame, i);
+  uint64_t idle_ns = bench_thread_cpu_ns() - start_ns;
+
+  if (oscc_recorder_start(path, capacity) != OSCC_OK)
+    return 1;
+
+  channel_writer_s writers[BUS_COUNT];
+  memset(writers, 0, sizeof(writers));
+
+  uint64_t wall_start_ns = bench_now_ns();
+  for (int w=0; w<BUS_COUNT; ++w)
+  {
+    writers[w].channel = (oscc_recorder_channel_t) w;
+    writers[w].frames = frame_count;
+    if (pthread_create(&writers[w].thread, NULL, channel_writer_thread, &writers[w]) != 0)
+    {
+      printf("Error: Could not start writer thread\n");
+      return 1;
+    }
+  }
+
+  uint64_t cpu_ns = 0;
+  for (int w=0; w<BUS_COUNT; ++w)
+  {
+    pthread_join(writers[w].thread, NULL);
+    cpu_ns += writers[w].cpu_ns;
+  }
+  uint64_t wall_ns = bench_now_ns() - wall_start_ns;
+
+  if (oscc_recorder_stop() != OSCC_OK)
+    return 1;
+
+  double ns_per_frame = (double) cpu_ns / (BUS_COUNT * frame_count);
+  double bus_frames_per_s = BUS_COUNT * BUS_BITRATE / SHORTEST_FRAME_BITS;
+
+  printf("idle     %8.2f cpu ns/frame\n", (double) idle_ns / frame_count);
+  printf("record   %8.2f cpu ns/frame %8.2f wall ns/frame, 2 writers\n",
+         ns_per_frame,
+         (double) wall_ns / (BUS_COUNT * frame_count));
+  printf("load     %8.0f frames/s on %d saturated buses, %.3f%% of one core\n",
+         bus_frames_per_s,
+         BUS_COUNT,
+         100.0 * bus_frames_per_s * ns_per_frame / 1e9);
+
+  unsigned long failures = check_file(path, frame_count);
+  unlink(path);
+
+  return failures == 0 ? 0 : 1;
+}
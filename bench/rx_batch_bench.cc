@@ -0,0 +1,190 @@
+/**
+ * @file rx_batch_bench.cc
+ * @brief Compares a per-frame read() drain loop with the library's recvmmsg
+ *        batch drain, oscc_drain_can_socket, on a vcan interface.
+ *
+ * Frames are written in bursts that fit in the receive buffer, then drained
+ * with each strategy. Only the drain is timed. The read() baseline counts
+ * every syscall it issues, including the terminal EAGAIN; the library drain
+ * issues one recvmmsg per OSCC_RX_BATCH_SIZE frames plus the short batch
+ * that ends it, and runs the same receive metadata parsing and recorder
+ * check as the OSCC socket before handing frames to a counting callback.
+ *
+ * Usage: rx_batch_bench <vcan interface> [frames] [burst]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/src/internal/oscc.h"
+
+#define DEFAULT_FRAME_COUNT 1000000
+#define DEFAULT_BURST_SIZE 128
+
+typedef struct
+{
+  const char* name;
+  unsigned long frames;
+  unsigned long syscalls;
+  uint64_t wall_ns;
+  uint64_t cpu_ns;
+} drain_stats_s;
+
+static unsigned long drain_with_read(int sock, unsigned long* syscalls)
+{
+  struct can_frame rx_frame;
+  unsigned long frames = 0;
+
+  ++(*syscalls);
+  while (read(sock, &rx_frame, CAN_MTU) == CAN_MTU)
+  {
+    ++frames;
+    ++(*syscalls);
+  }
+
+  return frames;
+}
+
+static unsigned long global_dispatched_frames;
+
+static void count_frame(struct canfd_frame*, oscc_frame_meta_s const*)
+{
+  ++global_dispatched_frames;
+}
+
+static unsigned long drain_with_library(int sock,
+                                        can_socket_stats_s* socket_stats,
+                                        unsigned long* syscalls)
+{
+  global_dispatched_frames = 0;
+
+  oscc_drain_can_socket(sock, OSCC_RECORDER_CHANNEL_OSCC, count_frame, socket_stats);
+
+  // The drain stops at the first batch shorter than OSCC_RX_BATCH_SIZE
+  *syscalls += global_dispatched_frames / OSCC_RX_BATCH_SIZE + 1;
+
+  return global_dispatched_frames;
+}
+
+static int write_burst(int sock, unsigned int burst, uint32_t* counter)
+{
+  struct can_frame tx_frame;
+  memset(&tx_frame, 0, sizeof(tx_frame));
+  tx_frame.can_id = 0x386;
+  tx_frame.can_dlc = 8;
+
+  for (unsigned int i=0; i<burst; ++i)
+  {
+    memcpy(tx_frame.data, counter, sizeof(*counter));
+    ++(*counter);
+    if (write(sock, &tx_frame, sizeof(tx_frame)) != sizeof(tx_frame))
+    {
+      perror("Writing burst failed:");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static void print_stats(const drain_stats_s* stats)
+{
+  double frames = stats->frames > 0 ? (double)stats->frames : 1.0;
+  printf("%-9s frames=%lu syscalls/frame=%.4f wall_ns/frame=%.1f cpu_ns/frame=%.1f\n",
+         stats->name,
+         stats->frames,
+         stats->syscalls / frames,
+         stats->wall_ns / frames,
+         stats->cpu_ns / frames);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    printf("usage %s vcan_interface [frames] [burst]\n", argv[0]);
+    return 1;
+  }
+
+  const char* interface = argv[1];
+  unsigned long frame_count = argc>2 ? strtoul(argv[2], NULL, 0) : DEFAULT_FRAME_COUNT;
+  unsigned int burst = argc>3 ? strtoul(argv[3], NULL, 0) : DEFAULT_BURST_SIZE;
+
+  if (burst == 0)
+  {
+    printf("burst must be positive\n");
+    return 1;
+  }
+
+  int tx_sock = bench_open_can_socket(interface);
+  int rx_sock = bench_open_can_socket(interface);
+  if (tx_sock<0 || rx_sock<0)
+    return 1;
+
+  // Same ancillary data as the library's own sockets, so the drain parses
+  // what it would in production
+  int enable = 1;
+  if (setsockopt(rx_sock, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0
+      || setsockopt(rx_sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0)
+  {
+    perror("Enabling receive metadata failed:");
+    return 1;
+  }
+
+  // read() relies on the socket being nonblocking to see EAGAIN
+  fcntl(rx_sock, F_SETFL, fcntl(rx_sock, F_GETFL) | O_NONBLOCK);
+
+  oscc_init_rx_batch();
+  static can_socket_stats_s socket_stats;
+
+  drain_stats_s results[2] = {
+    { .name = "read", .frames = 0, .syscalls = 0, .wall_ns = 0, .cpu_ns = 0 },
+    { .name = "drain", .frames = 0, .syscalls = 0, .wall_ns = 0, .cpu_ns = 0 },
+  };
+  uint32_t counter = 0;
+  unsigned long sent = 0;
+
+  for (int strategy=0; strategy<2; ++strategy)
+  {
+    drain_stats_s* stats = &results[strategy];
+    sent = 0;
+
+    while (sent < frame_count)
+    {
+      if (write_burst(tx_sock, burst, &counter) != 0)
+        return 1;
+      sent += burst;
+
+      uint64_t wall_start = bench_now_ns();
+      uint64_t cpu_start = bench_thread_cpu_ns();
+
+      if (strategy == 0)
+        stats->frames += drain_with_read(rx_sock, &stats->syscalls);
+      else
+        stats->frames += drain_with_library(rx_sock, &socket_stats, &stats->syscalls);
+
+      stats->cpu_ns += bench_thread_cpu_ns() - cpu_start;
+      stats->wall_ns += bench_now_ns() - wall_start;
+    }
+
+    if (stats->frames != sent)
+      printf("Warning: %s drained %lu of %lu frames, reduce the burst size\n",
+             stats->name, stats->frames, sent);
+  }
+
+  printf("interface=%s burst=%u batch=%d\n", interface, burst, OSCC_RX_BATCH_SIZE);
+  print_stats(&results[0]);
+  print_stats(&results[1]);
+
+  close(tx_sock);
+  close(rx_sock);
+
+  return 0;
+}
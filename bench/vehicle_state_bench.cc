@@ -0,0 +1,166 @@
+/**
+ * @file vehicle_state_bench.cc
+ * @brief Checks that vehicle state snapshots stay consistent while frames
+ *        are decoded into the store, and measures both sides.
+ *
+ * One thread dispatches wheel speed frames as the RX path does, with the
+ * same raw value in all four wheels, while reader threads take snapshots as
+ * fast as they can. A snapshot whose wheel speeds or wheel sequences differ
+ * was torn, and the store sequence must never go backwards.
+ *
+ * Usage: vehicle_state_bench [frames] [reader threads]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/include/vehicle_state.h"
+#include "core/src/internal/dispatch.h"
+#include "core/src/internal/vehicle_profiles.h"
+
+#define DEFAULT_FRAME_COUNT 20000000UL
+#define DEFAULT_READER_COUNT 2
+#define MAX_READER_COUNT 16
+#define RAW_VALUE_COUNT 4096
+
+typedef struct
+{
+  pthread_t thread;
+  unsigned long snapshots;
+  unsigned long torn;
+  unsigned long backwards;
+  uint64_t wall_ns;
+} reader_s;
+
+static std::atomic<bool> global_writing(true);
+
+static bool is_consistent(oscc_vehicle_state_s const* state)
+{
+  oscc_vehicle_signal_s const* wheels = &state->wheel_speed_front_left;
+
+  for (int w=1; w<4; ++w)
+  {
+    if (wheels[w].value != wheels[0].value
+        || wheels[w].sequence != wheels[0].sequence
+        || wheels[w].timestamp_ns != wheels[0].timestamp_ns)
+      return false;
+  }
+
+  return state->sequence == wheels[0].sequence;
+}
+
+static void* reader_thread(void* arg)
+{
+  reader_s* reader = (reader_s*) arg;
+  oscc_vehicle_state_s state;
+  uint64_t last_sequence = 0;
+
+  uint64_t start_ns = bench_now_ns();
+  while (global_writing.load(std::memory_order_relaxed))
+  {
+    oscc_get_vehicle_state(&state);
+    ++reader->snapshots;
+
+    if (!is_consistent(&state))
+      ++reader->torn;
+    if (state.sequence < last_sequence)
+      ++reader->backwards;
+    last_sequence = state.sequence;
+  }
+  reader->wall_ns = bench_now_ns() - start_ns;
+
+  return NULL;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long frame_count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_FRAME_COUNT;
+  unsigned long reader_count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_READER_COUNT;
+
+  if (frame_count==0 || reader_count>MAX_READER_COUNT)
+  {
+    printf("Usage: %s [frames] [reader threads, at most %d]\n", argv[0], MAX_READER_COUNT);
+    return 1;
+  }
+
+  reader_s readers[MAX_READER_COUNT];
+  memset(readers, 0, sizeof(readers));
+
+  for (unsigned long r=0; r<reader_count; ++r)
+  {
+    if (pthread_create(&readers[r].thread, NULL, reader_thread, &readers[r]) != 0)
+    {
+      printf("Error: Could not start reader thread\n");
+      return 1;
+    }
+  }
+
+  // Install the vehicle frame decoders as opening a channel does
+  oscc_dispatch_init();
+
+  struct canfd_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = oscc_vehicle_profile()->wheel_speed_can_id;
+  frame.len = CAN_MAX_DLEN;
+
+  oscc_frame_meta_s meta;
+  memset(&meta, 0, sizeof(meta));
+
+  uint64_t start_ns = bench_now_ns();
+  uint64_t start_cpu_ns = bench_thread_cpu_ns();
+
+  for (unsigned long i=0; i<frame_count; ++i)
+  {
+    uint16_t raw = i % RAW_VALUE_COUNT;
+    for (int w=0; w<4; ++w)
+    {
+      frame.data[2*w] = raw & 0xFF;
+      frame.data[2*w + 1] = raw >> 8;
+    }
+
+    meta.dispatch_time.tv_sec = i / 1000000000UL;
+    meta.dispatch_time.tv_nsec = i % 1000000000UL;
+    oscc_dispatch_frame(&frame, &meta, OSCC_DISPATCH_OBD);
+  }
+
+  uint64_t wall_ns = bench_now_ns() - start_ns;
+  uint64_t cpu_ns = bench_thread_cpu_ns() - start_cpu_ns;
+
+  global_writing.store(false, std::memory_order_relaxed);
+
+  unsigned long failures = 0;
+
+  printf("writer   %8.2f ns/frame %8.2f cpu ns/frame\n",
+         (double) wall_ns / frame_count,
+         (double) cpu_ns / frame_count);
+
+  for (unsigned long r=0; r<reader_count; ++r)
+  {
+    pthread_join(readers[r].thread, NULL);
+    failures += readers[r].torn + readers[r].backwards;
+
+    printf("reader %lu %8.2f ns/snapshot %12lu snapshots %lu torn %lu backwards\n",
+           r,
+           readers[r].snapshots ? (double) readers[r].wall_ns / readers[r].snapshots : 0.0,
+           readers[r].snapshots,
+           readers[r].torn,
+           readers[r].backwards);
+  }
+
+  oscc_vehicle_state_s state;
+  oscc_get_vehicle_state(&state);
+  if (state.sequence != frame_count || !is_consistent(&state))
+  {
+    printf("Error: Final state has sequence %lu, expected %lu\n",
+           (unsigned long) state.sequence, frame_count);
+    ++failures;
+  }
+
+  return failures == 0 ? 0 : 1;
+}
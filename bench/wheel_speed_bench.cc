@@ -0,0 +1,205 @@
+/**
+ * @file wheel_speed_bench.cc
+ * @brief Compares the single-wheel getters with the batch wheel speed
+ *        decoders on a recorded-log sized input.
+ *
+ * Every decoder runs over the same random wheel speed frames and its output
+ * is compared bit for bit with the getters. A second input covering every
+ * raw 12-bit value in every wheel position checks the full value range.
+ *
+ * Usage: wheel_speed_bench [frames] [repetitions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench/bench_util.h"
+#include "core/include/oscc.h"
+#include "core/src/internal/oscc.h"
+#include "core/src/internal/vehicle_profiles.h"
+
+#define DEFAULT_FRAME_COUNT 1000000UL
+#define DEFAULT_REPETITIONS 20
+#define RAW_VALUE_COUNT 4096
+#define WHEEL_COUNT 4
+
+typedef size_t (*batch_decoder_t)(struct can_frame const*, size_t, canid_t, oscc_wheel_speeds_s const*);
+
+typedef struct
+{
+  double* values;
+  oscc_wheel_speeds_s wheels;
+} speed_arrays_s;
+
+static bool alloc_speed_arrays(speed_arrays_s* arrays, size_t count)
+{
+  arrays->values = (double*) calloc(WHEEL_COUNT * count, sizeof(double));
+  arrays->wheels.front_left = arrays->values;
+  arrays->wheels.front_right = arrays->values + count;
+  arrays->wheels.rear_left = arrays->values + 2*count;
+  arrays->wheels.rear_right = arrays->values + 3*count;
+  return arrays->values != NULL;
+}
+
+static size_t getter_decode(struct can_frame const* frames,
+                            size_t count,
+                            canid_t wheel_speed_can_id,
+                            oscc_wheel_speeds_s const* speeds)
+{
+  (void) wheel_speed_can_id;
+
+  for (size_t i=0; i<count; ++i)
+  {
+    get_wheel_speed_left_front(&frames[i], &speeds->front_left[i]);
+    get_wheel_speed_right_front(&frames[i], &speeds->front_right[i]);
+    get_wheel_speed_left_rear(&frames[i], &speeds->rear_left[i]);
+    get_wheel_speed_right_rear(&frames[i], &speeds->rear_right[i]);
+  }
+  return count;
+}
+
+static size_t public_decode(struct can_frame const* frames,
+                            size_t count,
+                            canid_t wheel_speed_can_id,
+                            oscc_wheel_speeds_s const* speeds)
+{
+  (void) wheel_speed_can_id;
+
+  return get_wheel_speeds(frames, count, speeds) == OSCC_OK ? count : 0;
+}
+
+static void fill_frame(struct can_frame* frame, uint16_t const raw[WHEEL_COUNT])
+{
+  memset(frame, 0, sizeof(*frame));
+  frame->can_id = oscc_vehicle_profile()->wheel_speed_can_id;
+  frame->can_dlc = CAN_MAX_DLEN;
+
+  // The upper nibble of each wheel word is not part of the speed
+  for (int w=0; w<WHEEL_COUNT; ++w)
+  {
+    frame->data[2*w] = raw[w] & 0xFF;
+    frame->data[2*w + 1] = (raw[w] >> 8) | (rand() & 0xF0);
+  }
+}
+
+static bool run(const char* name,
+                batch_decoder_t decode,
+                struct can_frame const* frames,
+                size_t count,
+                unsigned int repetitions,
+                speed_arrays_s const* expected,
+                speed_arrays_s* out)
+{
+  memset(out->values, 0, WHEEL_COUNT * count * sizeof(double));
+
+  uint64_t start_ns = bench_now_ns();
+  for (unsigned int r=0; r<repetitions; ++r)
+    decode(frames, count, oscc_vehicle_profile()->wheel_speed_can_id, &out->wheels);
+  uint64_t wall_ns = bench_now_ns() - start_ns;
+
+  bool identical = memcmp(out->values, expected->values, WHEEL_COUNT * count * sizeof(double)) == 0;
+  double frames_decoded = (double) count * repetitions;
+
+  printf("%-8s %8.2f Mframes/s %8.3f ns/frame  %s\n",
+         name,
+         frames_decoded * 1e3 / wall_ns,
+         wall_ns / frames_decoded,
+         identical ? "bit-identical" : "MISMATCH");
+
+  return identical;
+}
+
+int main(int argc, char** argv)
+{
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_FRAME_COUNT;
+  unsigned int repetitions = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_REPETITIONS;
+
+  if (count==0 || repetitions==0)
+  {
+    printf("Usage: %s [frames] [repetitions]\n", argv[0]);
+    return 1;
+  }
+
+  struct
+  {
+    const char* name;
+    batch_decoder_t decode;
+  } decoders[] =
+  {
+    { "scalar", oscc_decode_wheel_speeds_scalar },
+#if defined(__x86_64__)
+    { "sse2", oscc_decode_wheel_speeds_sse2 },
+    { "avx", __builtin_cpu_supports("avx") ? oscc_decode_wheel_speeds_avx : NULL },
+#endif
+    { "batch", public_decode },
+  };
+  size_t decoder_count = sizeof(decoders) / sizeof(decoders[0]);
+  bool identical = true;
+
+  // Every raw value in every wheel, with a tail that is not a multiple of 4
+  size_t range_count = RAW_VALUE_COUNT + 3;
+  struct can_frame* range_frames = (struct can_frame*) calloc(range_count, sizeof(struct can_frame));
+  struct can_frame* frames = (struct can_frame*) calloc(count, sizeof(struct can_frame));
+  speed_arrays_s range_expected;
+  speed_arrays_s range_out;
+  speed_arrays_s expected;
+  speed_arrays_s out;
+
+  if (range_frames==NULL || frames==NULL
+      || !alloc_speed_arrays(&range_expected, range_count)
+      || !alloc_speed_arrays(&range_out, range_count)
+      || !alloc_speed_arrays(&expected, count)
+      || !alloc_speed_arrays(&out, count))
+  {
+    printf("Error: Out of memory\n");
+    return 1;
+  }
+
+  srand(1);
+
+  for (size_t i=0; i<range_count; ++i)
+  {
+    uint16_t raw[WHEEL_COUNT];
+    for (int w=0; w<WHEEL_COUNT; ++w)
+      raw[w] = (i + w*1024) % RAW_VALUE_COUNT;
+    fill_frame(&range_frames[i], raw);
+  }
+
+  for (size_t i=0; i<count; ++i)
+  {
+    uint16_t raw[WHEEL_COUNT];
+    for (int w=0; w<WHEEL_COUNT; ++w)
+      raw[w] = rand() % RAW_VALUE_COUNT;
+    fill_frame(&frames[i], raw);
+  }
+
+  getter_decode(range_frames, range_count, 0, &range_expected.wheels);
+  getter_decode(frames, count, 0, &expected.wheels);
+
+  printf("Full raw range, %zu frames:\n", range_count);
+  for (size_t d=0; d<decoder_count; ++d)
+  {
+    if (decoders[d].decode != NULL)
+      identical &= run(decoders[d].name, decoders[d].decode,
+                       range_frames, range_count, 1, &range_expected, &range_out);
+  }
+
+  printf("%zu frames x %u:\n", count, repetitions);
+  run("getters", getter_decode, frames, count, repetitions, &expected, &out);
+  for (size_t d=0; d<decoder_count; ++d)
+  {
+    if (decoders[d].decode != NULL)
+      identical &= run(decoders[d].name, decoders[d].decode,
+                       frames, count, repetitions, &expected, &out);
+  }
+
+  free(range_expected.values);
+  free(range_out.values);
+  free(expected.values);
+  free(out.values);
+  free(range_frames);
+  free(frames);
+
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file dbc_codec.h
+ * @brief Compile-time DBC signal codec.
+ *
+ * tools/dbc_codegen turns every signal of a DBC file into a struct of
+ * constants (see oscc_dbc.h). The functions here take such a struct as a
+ * template argument, so byte order, sign extension and scaling are resolved
+ * by the compiler and a decode reduces to a load, a shift and a mask.
+ *
+ * A signal struct provides:
+ *   raw_t, value_t        - integer type of the raw bits, type of the
+ *                           physical value
+ *   start_bit, length     - DBC start bit and length in bits
+ *   little_endian         - Intel (@1) or Motorola (@0) byte order
+ *   is_signed             - two's complement raw value
+ *   value_type            - \ref dbc_value_type_t
+ *   factor, offset        - physical = raw * factor + offset
+ */
+
+#ifndef _OSCC_DBC_CODEC_H_
+#define _OSCC_DBC_CODEC_H_
+
+
+#include <stdint.h>
+
+/**
+ * @brief How the raw bits of a signal are interpreted (DBC SIG_VALTYPE_).
+ */
+typedef enum
+{
+  DBC_VALUE_INTEGER = 0,
+  DBC_VALUE_FLOAT = 1,
+  DBC_VALUE_DOUBLE = 2
+} dbc_value_type_t;
+
+/**
+ * @brief Signal metadata, for code that walks the signals of a file at run
+ *        time instead of naming them.
+ */
+typedef struct
+{
+  const char* name;
+  const char* message;
+  uint32_t can_id;
+  uint8_t message_dlc;
+  uint16_t start_bit;
+  uint8_t length;
+  bool little_endian;
+  bool is_signed;
+  dbc_value_type_t value_type;
+  double factor;
+  double offset;
+  double minimum;
+  double maximum;
+  const char* unit;
+} dbc_signal_info_s;
+
+/*
+ * Motorola signals are numbered from their most significant bit, counting
+ * bit 7 of byte 0 as bit 0 of a big-endian bit stream.
+ */
+template <typename Signal>
+constexpr unsigned int dbc_msb_stream_bit()
+{
+  return (Signal::start_bit / 8) * 8 + 7 - (Signal::start_bit % 8);
+}
+
+/**
+ * @brief First payload byte holding bits of the signal.
+ */
+template <typename Signal>
+constexpr unsigned int dbc_first_byte()
+{
+  return Signal::start_bit / 8;
+}
+
+/**
+ * @brief Last payload byte holding bits of the signal.
+ */
+template <typename Signal>
+constexpr unsigned int dbc_last_byte()
+{
+  return Signal::little_endian
+         ? (Signal::start_bit + Signal::length - 1) / 8
+         : (dbc_msb_stream_bit<Signal>() + Signal::length - 1) / 8;
+}
+
+/**
+ * @brief Right shift bringing the signal's least significant bit to bit 0 of
+ *        the word assembled from its bytes.
+ */
+template <typename Signal>
+constexpr unsigned int dbc_shift()
+{
+  return Signal::little_endian
+         ? Signal::start_bit % 8
+         : 7 - (dbc_msb_stream_bit<Signal>() + Signal::length - 1) % 8;
+}
+
+template <typename Signal>
+constexpr uint64_t dbc_mask()
+{
+  return Signal::length >= 64 ? ~0ULL : (1ULL << Signal::length) - 1;
+}
+
+template <typename Signal>
+constexpr void dbc_check_signal()
+{
+  static_assert(Signal::length > 0 && Signal::length <= 64,
+                "DBC signal length must be 1 to 64 bits");
+  static_assert(dbc_last_byte<Signal>() - dbc_first_byte<Signal>() < 8,
+                "DBC signal must fit in 8 consecutive bytes");
+  static_assert(Signal::value_type != DBC_VALUE_FLOAT || Signal::length == 32,
+                "DBC float signal must be 32 bits");
+  static_assert(Signal::value_type != DBC_VALUE_DOUBLE || Signal::length == 64,
+                "DBC double signal must be 64 bits");
+}
+
+/**
+ * @brief Extracts the raw bits of a signal from a payload.
+ */
+template <typename Signal>
+constexpr uint64_t dbc_extract(uint8_t const* data)
+{
+  dbc_check_signal<Signal>();
+
+  uint64_t word = 0;
+
+  for (unsigned int i = dbc_first_byte<Signal>(); i <= dbc_last_byte<Signal>(); ++i)
+  {
+    if (Signal::little_endian)
+      word |= (uint64_t) data[i] << (8 * (i - dbc_first_byte<Signal>()));
+    else
+      word = (word << 8) | data[i];
+  }
+
+  return (word >> dbc_shift<Signal>()) & dbc_mask<Signal>();
+}
+
+/**
+ * @brief Writes the raw bits of a signal into a payload, leaving the other
+ *        bits of its bytes as they are.
+ */
+template <typename Signal>
+constexpr void dbc_insert(uint8_t* data, uint64_t raw)
+{
+  dbc_check_signal<Signal>();
+
+  uint64_t const bits = (raw & dbc_mask<Signal>()) << dbc_shift<Signal>();
+  uint64_t const mask = dbc_mask<Signal>() << dbc_shift<Signal>();
+
+  for (unsigned int i = dbc_first_byte<Signal>(); i <= dbc_last_byte<Signal>(); ++i)
+  {
+    unsigned int const byte_shift = Signal::little_endian
+                                    ? 8 * (i - dbc_first_byte<Signal>())
+                                    : 8 * (dbc_last_byte<Signal>() - i);
+    uint8_t const byte_mask = (uint8_t) (mask >> byte_shift);
+
+    data[i] = (uint8_t) ((data[i] & ~byte_mask) | ((bits >> byte_shift) & byte_mask));
+  }
+}
+
+template <typename Signal>
+constexpr bool dbc_is_scaled()
+{
+  return Signal::factor != 1.0 || Signal::offset != 0.0;
+}
+
+/**
+ * @brief Applies factor and offset, skipping whichever is the identity.
+ */
+template <typename Signal, typename T>
+constexpr double dbc_scale(T value)
+{
+  if constexpr (Signal::offset == 0.0)
+    return value * Signal::factor;
+  else if constexpr (Signal::factor == 1.0)
+    return value + Signal::offset;
+  else
+    return value * Signal::factor + Signal::offset;
+}
+
+/**
+ * @brief Decodes the physical value of a signal from a payload.
+ */
+template <typename Signal>
+constexpr typename Signal::value_t dbc_decode(uint8_t const* data)
+{
+  uint64_t const raw = dbc_extract<Signal>(data);
+
+  if constexpr (Signal::value_type == DBC_VALUE_FLOAT)
+  {
+    float const value = __builtin_bit_cast(float, (uint32_t) raw);
+    if constexpr (dbc_is_scaled<Signal>())
+      return dbc_scale<Signal>(value);
+    else
+      return value;
+  }
+  else if constexpr (Signal::value_type == DBC_VALUE_DOUBLE)
+  {
+    double const value = __builtin_bit_cast(double, raw);
+    if constexpr (dbc_is_scaled<Signal>())
+      return dbc_scale<Signal>(value);
+    else
+      return value;
+  }
+  else
+  {
+    typename Signal::raw_t value = (typename Signal::raw_t) raw;
+
+    if constexpr (Signal::is_signed && Signal::length < 64)
+    {
+      uint64_t const sign_bit = 1ULL << (Signal::length - 1);
+      value = (typename Signal::raw_t) (int64_t) ((raw ^ sign_bit) - sign_bit);
+    }
+
+    if constexpr (dbc_is_scaled<Signal>())
+      return dbc_scale<Signal>(value);
+    else
+      return value;
+  }
+}
+
+/**
+ * @brief Encodes the physical value of a signal into a payload. Scaled
+ *        integer signals round to the nearest raw value.
+ */
+template <typename Signal>
+constexpr void dbc_encode(uint8_t* data, typename Signal::value_t value)
+{
+  uint64_t raw = 0;
+
+  if constexpr (Signal::value_type == DBC_VALUE_FLOAT)
+  {
+    float physical = value;
+    if constexpr (dbc_is_scaled<Signal>())
+      physical = (float) ((value - Signal::offset) / Signal::factor);
+    raw = __builtin_bit_cast(uint32_t, physical);
+  }
+  else if constexpr (Signal::value_type == DBC_VALUE_DOUBLE)
+  {
+    double physical = value;
+    if constexpr (dbc_is_scaled<Signal>())
+      physical = (value - Signal::offset) / Signal::factor;
+    raw = __builtin_bit_cast(uint64_t, physical);
+  }
+  else if constexpr (dbc_is_scaled<Signal>())
+  {
+    double const scaled = (value - Signal::offset) / Signal::factor;
+    raw = (uint64_t) (int64_t) (scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  }
+  else
+  {
+    raw = (uint64_t) value;
+  }
+
+  dbc_insert<Signal>(data, raw);
+}
+
+
+#endif // _OSCC_DBC_CODEC_H_
@@ -0,0 +1,64 @@
+/**
+ * @file packed_command_can_protocol.h
+ * @brief Packed Command CAN Protocol.
+ *
+ * Carries the brake, throttle and steering commands in a single CAN FD frame.
+ */
+
+#ifndef _OSCC_PACKED_COMMAND_CAN_PROTOCOL_H_
+#define _OSCC_PACKED_COMMAND_CAN_PROTOCOL_H_
+
+
+#include <stdint.h>
+#include "magic.h"
+
+/**
+ * @brief CAN ID representing the range of packed command messages.
+ */
+#define OSCC_PACKED_COMMAND_CAN_ID_INDEX (0xB0)
+
+/**
+ * @brief Packed command message (CAN FD frame) ID.
+ */
+#define OSCC_PACKED_COMMAND_CAN_ID (0xB0)
+
+/**
+ * @brief Packed command message (CAN FD frame) length. A valid CAN FD
+ *        payload length.
+ */
+#define OSCC_PACKED_COMMAND_CAN_DLC (16)
+
+
+#pragma pack(push)
+#pragma pack(1)
+
+/**
+ * @brief Packed command message data.
+ *
+ * CAN frame ID: \ref OSCC_PACKED_COMMAND_CAN_ID
+ *
+ * Message size (CAN FD frame length): \ref OSCC_PACKED_COMMAND_CAN_DLC
+ *
+ */
+typedef struct
+{
+  /**
+   * Magic number identifying CAN frame as from OSCC.
+   *   Byte 0 should be \ref OSCC_MAGIC_BYTE_0.
+   *   Byte 1 should be \ref OSCC_MAGIC_BYTE_1.
+   */
+  uint8_t magic[2];
+
+  uint8_t reserved[2]; /*!< Reserved. */
+
+  float brake_command; /*!< Brake Request 0.0 to 1.0 where 1.0 is 100% */
+
+  float throttle_command; /*!< Throttle Request 0.0 to 1.0 where 1.0 is 100% */
+
+  float steering_command; /*!< Steering Torque Request -1.0 to 1.0 */
+} oscc_packed_command_s;
+
+#pragma pack(pop)
+
+
+#endif // _OSCC_PACKED_COMMAND_CAN_PROTOCOL_H_
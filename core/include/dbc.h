@@ -0,0 +1,141 @@
+/**
+ * @file dbc.h
+ * @brief Runtime DBC decoder - Loads a vehicle DBC file and decodes CAN
+ *        frames into a vector of physical signal values.
+ *
+ * Loading compiles every signal into a small extraction program (load
+ * offset, shift, mask, sign and scale), so decoding a frame is one lookup by
+ * CAN ID and a handful of shifts per signal, with no parsing and no
+ * allocation. Vehicle DBC files live next to their header, e.g.
+ * core/include/vehicles/kia_niro.dbc.
+ */
+
+#ifndef _OSCC_DBC_H_
+#define _OSCC_DBC_H_
+
+
+#include <linux/can.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oscc.h"
+#include "can_protocols/dbc_codec.h"
+
+/**
+ * @brief Returned by \ref dbc_find_signal for an unknown signal name.
+ */
+#define DBC_SIGNAL_NOT_FOUND ( -1 )
+
+/**
+ * @brief Extraction program of one signal. Treat as opaque.
+ */
+typedef struct
+{
+  uint64_t mask;
+  uint64_t sign_bit; /*!< 0 for unsigned signals. */
+  double factor;
+  double offset;
+  uint8_t load_byte; /*!< First of the 8 payload bytes loaded. */
+  uint8_t end_byte; /*!< Frame length needed to hold the signal. */
+  uint8_t shift;
+  uint8_t flags;
+} dbc_signal_program_s;
+
+/**
+ * @brief Signals of one message, a contiguous range of the signal vector.
+ *        Treat as opaque.
+ */
+typedef struct
+{
+  uint32_t can_id;
+  uint16_t first_signal;
+  uint16_t signal_count;
+} dbc_message_program_s;
+
+/**
+ * @brief A loaded DBC file. Treat as opaque.
+ */
+typedef struct
+{
+  dbc_signal_info_s* signals;
+  dbc_signal_program_s* programs;
+  size_t signal_count;
+
+  dbc_message_program_s* messages;
+  size_t message_count;
+
+  /* Message index plus one for every standard CAN ID, 0 if not in the file */
+  uint16_t standard_ids[CAN_SFF_MASK + 1];
+
+  /* Messages with extended IDs, sorted by ID */
+  uint16_t* extended_ids;
+  size_t extended_count;
+} dbc_database_s;
+
+/**
+ * @brief Load a DBC file and compile the extraction programs of its signals.
+ *        Multiplexed signals are skipped with a warning.
+ *
+ * @param [out] database - Database to fill. Release with \ref dbc_free.
+ *
+ * @param [in] path - DBC file to load.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t dbc_load( dbc_database_s* database, const char* path );
+
+/**
+ * @brief Release everything \ref dbc_load allocated.
+ */
+void dbc_free( dbc_database_s* database );
+
+/**
+ * @brief Number of signals in the database, the size of the signal vector
+ *        \ref dbc_decode_frame writes to.
+ */
+size_t dbc_signal_count( dbc_database_s const* database );
+
+/**
+ * @brief Index of a signal in the signal vector.
+ *
+ * @return signal index or \ref DBC_SIGNAL_NOT_FOUND
+ */
+int dbc_find_signal( dbc_database_s const* database, const char* name );
+
+/**
+ * @brief Name, message, layout and scaling of a signal.
+ *
+ * @return signal info, or NULL if the index is out of range
+ */
+dbc_signal_info_s const* dbc_get_signal_info( dbc_database_s const* database,
+                                              size_t index );
+
+/**
+ * @brief Decode the signals of a frame into the signal vector.
+ *
+ * Only the entries of the frame's signals are written; the rest of the
+ * vector keeps the last value decoded. Signals that lie beyond the frame
+ * length are skipped. Classic CAN frames must be passed in a canfd_frame,
+ * as received with CAN_RAW_FD_FRAMES or by the OSCC RX path, since
+ * extraction reads whole 8-byte words of the 64-byte payload.
+ *
+ * Safe to call from the RX path: it does not allocate, lock or block.
+ *
+ * @param [in] database - Loaded database.
+ *
+ * @param [in] frame - Received frame.
+ *
+ * @param [out] values - Signal vector of \ref dbc_signal_count entries,
+ *                       indexed like \ref dbc_find_signal.
+ *
+ * @param [in] value_count - Number of entries in values.
+ *
+ * @return number of signals decoded, 0 if the frame is not in the database
+ */
+size_t dbc_decode_frame( dbc_database_s const* database,
+                         struct canfd_frame const* frame,
+                         double* values,
+                         size_t value_count );
+
+
+#endif // _OSCC_DBC_H_
@@ -9,9 +9,13 @@
 
 
 #include <linux/can.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "can_protocols/brake_can_protocol.h"
 #include "can_protocols/fault_can_protocol.h"
+#include "can_protocols/packed_command_can_protocol.h"
 #include "can_protocols/steering_can_protocol.h"
 #include "can_protocols/throttle_can_protocol.h"
 #include "vehicles.h"
@@ -21,8 +25,6 @@
  * @brief Global variables
  */
 extern int g_channel;
-extern double g_steering_angle;
-extern double g_brake_pressure;
 
 /**
  * @brief MAX_CAN_IDS is the maximum number unique CAN IDs on the CAN bus used
@@ -39,6 +41,13 @@ extern double g_brake_pressure;
  */
 #define CAN_MESSAGE_TIMEOUT ( 100 )
 
+/**
+ * @brief CAN_DETECTION_DEADLINE is the overall time in milliseconds that auto
+ * detection may spend sniffing the CAN channels, which are all sniffed at
+ * once.
+ */
+#define CAN_DETECTION_DEADLINE ( 1000 )
+
 typedef enum
 {
   OSCC_OK,
@@ -46,6 +55,92 @@ typedef enum
   OSCC_WARNING
 } oscc_result_t;
 
+/**
+ * @brief Receive metadata delivered with each report and OBD frame to the
+ *        *_with_meta subscribers.
+ */
+typedef struct
+{
+  struct timespec rx_timestamp; /*!< Kernel receive time (CLOCK_REALTIME,
+                                 *   from SO_TIMESTAMPNS). */
+
+  struct timespec dispatch_time; /*!< CLOCK_MONOTONIC time at which the frame
+                                  *   was handed to the callbacks. */
+
+  int64_t age_ns; /*!< Time between kernel receive and dispatch. [ns] */
+
+  int ifindex; /*!< Index of the interface the frame arrived on. */
+} oscc_frame_meta_s;
+
+/**
+ * @brief Frame counters for one CAN socket.
+ */
+typedef struct
+{
+  unsigned long frames_received; /*!< Frames delivered to the library. */
+
+  unsigned long frames_dropped; /*!< Frames the kernel dropped because the
+                                 *   socket receive queue was full. */
+
+  unsigned long frames_filtered; /*!< Frames seen on the interface that the
+                                  *   kernel filter kept from waking us. An
+                                  *   estimate: the frames the library wrote
+                                  *   are subtracted, since interfaces with
+                                  *   loopback count their echoes as
+                                  *   received, but the frames of the
+                                  *   oscc_start_cyclic_commands jobs are
+                                  *   still included. */
+} oscc_can_channel_stats_s;
+
+/**
+ * @brief Frame counters for the OSCC and vehicle CAN sockets.
+ */
+typedef struct
+{
+  oscc_can_channel_stats_s oscc;
+
+  oscc_can_channel_stats_s vehicle;
+} oscc_can_stats_s;
+
+/**
+ * @brief Selects how incoming CAN frames are received and dispatched.
+ *
+ * \li \ref OSCC_RX_MODE_SIGNAL (default) decodes frames and runs callbacks
+ *     inside a SIGIO handler.
+ * \li \ref OSCC_RX_MODE_THREAD decodes frames and runs callbacks on a
+ *     dedicated thread that waits on both CAN sockets with epoll. Callbacks
+ *     are no longer restricted to async-signal-safe work, but they run
+ *     concurrently with the caller's threads.
+ */
+typedef enum
+{
+  OSCC_RX_MODE_SIGNAL,
+  OSCC_RX_MODE_THREAD
+} oscc_rx_mode_t;
+
+/**
+ * @brief Vehicles whose OBD frames the library decodes. Selected at run
+ *        time with \ref oscc_select_vehicle.
+ */
+typedef enum
+{
+  OSCC_VEHICLE_KIA_SOUL_PETROL,
+  OSCC_VEHICLE_KIA_SOUL_EV,
+  OSCC_VEHICLE_KIA_NIRO,
+  OSCC_VEHICLE_COUNT
+} oscc_vehicle_t;
+
+/**
+ * @brief Handle identifying one subscriber added with an oscc_add_*
+ *        function, used to remove it with \ref oscc_unsubscribe.
+ */
+typedef uint32_t oscc_subscription_t;
+
+/**
+ * @brief Subscription handle returned when a subscriber could not be added.
+ */
+#define OSCC_INVALID_SUBSCRIPTION ( 0 )
+
 /**
  * @brief Looks for available CAN channels and automatically detects which
  *        channel is OSCC control and which channel is vehicle CAN for feedback.
@@ -75,6 +170,109 @@ oscc_result_t oscc_open( unsigned int channel );
  */
 oscc_result_t oscc_close( unsigned int channel );
 
+/**
+ * @brief Select the frame reception mode. Must be called before
+ *        \ref oscc_init or \ref oscc_open.
+ *
+ * @param [in] mode - Reception mode to use once a channel is opened.
+ *
+ * @return OSCC_ERROR if a channel is already open or the mode is unknown,
+ *         otherwise OSCC_OK
+ */
+oscc_result_t oscc_set_rx_mode( oscc_rx_mode_t mode );
+
+/**
+ * @brief Select the vehicle whose OBD frames are detected, filtered and
+ *        decoded. Must be called before \ref oscc_init or \ref oscc_open.
+ *
+ * @param [in] vehicle - Vehicle to use. Defaults to
+ *        \ref OSCC_VEHICLE_KIA_NIRO.
+ *
+ * @return OSCC_ERROR if a channel is already open or the vehicle is unknown,
+ *         otherwise OSCC_OK
+ */
+oscc_result_t oscc_select_vehicle( oscc_vehicle_t vehicle );
+
+/**
+ * @brief Select the vehicle by name, see \ref oscc_select_vehicle.
+ *
+ * @param [in] name - "kia_soul_petrol", "kia_soul_ev" or "kia_niro".
+ *
+ * @return OSCC_ERROR if a channel is already open or the name is unknown,
+ *         otherwise OSCC_OK
+ */
+oscc_result_t oscc_select_vehicle_by_name( const char* name );
+
+/**
+ * @brief Get the selected vehicle.
+ */
+oscc_vehicle_t oscc_get_vehicle( void );
+
+/**
+ * @brief Enable CAN FD mode. Must be called before \ref oscc_init or
+ *        \ref oscc_open.
+ *
+ * In FD mode the sockets receive and send struct canfd_frame: commands go
+ * out as FD frames, \ref oscc_subscribe_to_obd_fd_messages subscribers get
+ * payloads of up to 64 bytes, and the classic OBD subscribers keep getting
+ * every frame whose payload fits in 8 bytes.
+ *
+ * @param [in] enable - true for FD mode, false for classic CAN (default).
+ *        Disabling FD mode also disables packed commands.
+ *
+ * @return OSCC_ERROR if a channel is already open, otherwise OSCC_OK
+ */
+oscc_result_t oscc_set_can_fd( bool enable );
+
+/**
+ * @brief Send the brake, throttle and steering commands of
+ *        \ref oscc_publish_commands as one \ref oscc_packed_command_s FD
+ *        frame instead of three classic ones. Requires FD mode, see
+ *        \ref oscc_set_can_fd, and firmware that accepts
+ *        \ref OSCC_PACKED_COMMAND_CAN_ID.
+ *
+ * @param [in] enable - true to pack the commands, false (default) to send
+ *        one frame per module.
+ *
+ * @return OSCC_ERROR if enabling without FD mode or while cyclic commands are
+ *         active, otherwise OSCC_OK
+ */
+oscc_result_t oscc_set_packed_commands( bool enable );
+
+/**
+ * @brief Configure CAN channel auto detection. Must be called before
+ *        \ref oscc_init or \ref oscc_open.
+ *
+ * Detection returns as soon as the required OSCC reports and vehicle OBD IDs
+ * have each been seen `confidence` times, or when the deadline expires.
+ *
+ * @param [in] confidence - Number of times each required CAN ID must be seen
+ *        before a channel is considered to carry it. Defaults to 1.
+ *
+ * @param [in] deadline_ms - Overall time detection may take. [ms] Defaults
+ *        to \ref CAN_DETECTION_DEADLINE.
+ *
+ * @return OSCC_ERROR if either value is zero, otherwise OSCC_OK
+ */
+oscc_result_t oscc_set_detection_config( unsigned int confidence,
+                                         unsigned int deadline_ms );
+
+/**
+ * @brief Enable the CAN channel detection cache. Must be called before
+ *        \ref oscc_init.
+ *
+ * After a successful scan \ref oscc_init saves the OSCC and vehicle channel
+ * assignment, keyed by interface name, ifindex and driver, to this file. On
+ * the next start the cached assignment is validated with one quick passive
+ * check, and the full scan is skipped if it still holds.
+ *
+ * @param [in] path - Cache file location, or NULL to disable the cache.
+ *        Disabled by default.
+ *
+ * @return OSCC_ERROR if the path is too long, otherwise OSCC_OK
+ */
+oscc_result_t oscc_set_detection_cache( const char* path );
+
 /**
  * @brief Send enable commands to all OSCC modules.
  *
@@ -126,6 +324,58 @@ oscc_result_t oscc_publish_throttle_position( double throttle_position );
  */
 oscc_result_t oscc_publish_steering_torque( double torque );
 
+/**
+ * @brief Publish brake, throttle and steering commands together. The three
+ *        frames are encoded into one buffer and handed to the kernel with a
+ *        single sendmmsg call, so they go out back-to-back on the bus.
+ *
+ * @param [in] brake_position - Normalized requested brake pedal
+ *        position in the range [0, 1].
+ *
+ * @param [in] throttle_position - Normalized requested throttle pedal
+ *        position in the range [0, 1].
+ *
+ * @param [in] steering_torque - Normalized requested steering wheel
+ *        torque in the range [-1, 1].
+ *
+ * @param [out] frames_sent - Optional. Set to the number of commands the
+ *        kernel accepted, in brake, throttle, steering order. With packed
+ *        commands all three travel in one frame, so this is 0 or 3.
+ *
+ * @return:
+ * \li \ref OSCC_OK if all three frames were accepted.
+ * \li \ref OSCC_WARNING if only some of the frames were accepted.
+ * \li \ref OSCC_ERROR if no frame was accepted.
+ */
+oscc_result_t oscc_publish_commands( double brake_position,
+                                     double throttle_position,
+                                     double steering_torque,
+                                     unsigned int* frames_sent );
+
+/**
+ * @brief Hand the brake, throttle and steering command frames to the kernel
+ *        CAN Broadcast Manager (CAN_BCM) as cyclic TX jobs. The kernel then
+ *        transmits all three every period, starting from zero commands, and
+ *        the oscc_publish_* functions only update the payload of the running
+ *        jobs. Must be called after \ref oscc_init or \ref oscc_open.
+ *        With packed commands a single job carries all three commands, so
+ *        update it with \ref oscc_publish_commands.
+ *
+ * @param [in] period_us - Transmit period of each command frame. [us]
+ *
+ * @return OSCC_ERROR if no OSCC channel is open, cyclic mode is already
+ *         active or the jobs could not be set up, otherwise OSCC_OK
+ */
+oscc_result_t oscc_start_cyclic_commands( unsigned int period_us );
+
+/**
+ * @brief Stop the cyclic command TX jobs. Subsequent oscc_publish_* calls
+ *        write each frame once. Called by \ref oscc_close.
+ *
+ * @return OSCC_ERROR if cyclic mode was not active, otherwise OSCC_OK
+ */
+oscc_result_t oscc_stop_cyclic_commands( void );
+
 /**
  * @brief Register callback function to be called when brake report
  *        received from brake module.
@@ -181,19 +431,222 @@ oscc_result_t oscc_subscribe_to_fault_reports( void( *callback )( oscc_fault_rep
  */
 oscc_result_t oscc_subscribe_to_obd_messages( void( *callback )( struct can_frame *frame ) );
 
+/**
+ * @brief Register callback function to be called with the receive metadata
+ *        when brake report received from brake module. Called in addition
+ *        to the callback registered with \ref oscc_subscribe_to_brake_reports.
+ *
+ * @param [in] callback - Pointer to callback function.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_brake_reports_with_meta(
+  void( *callback )( oscc_brake_report_s *report, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Register callback function to be called with the receive metadata
+ *        when throttle report received from throttle module. Called in
+ *        addition to the callback registered with
+ *        \ref oscc_subscribe_to_throttle_reports.
+ *
+ * @param [in] callback - Pointer to callback function.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_throttle_reports_with_meta(
+  void( *callback )( oscc_throttle_report_s *report, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Register callback function to be called with the receive metadata
+ *        when steering report received from steering module. Called in
+ *        addition to the callback registered with
+ *        \ref oscc_subscribe_to_steering_reports.
+ *
+ * @param [in] callback - Pointer to callback function.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_steering_reports_with_meta(
+  void( *callback )( oscc_steering_report_s *report, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Register callback function to be called with the receive metadata
+ *        when fault report received from any module. Called in addition to
+ *        the callback registered with \ref oscc_subscribe_to_fault_reports.
+ *
+ * @param [in] callback - Pointer to callback function.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_fault_reports_with_meta(
+  void( *callback )( oscc_fault_report_s *report, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Register callback function to be called with the receive metadata
+ *        when OBD message received from vehicle. Called in addition to the
+ *        callback registered with \ref oscc_subscribe_to_obd_messages.
+ *
+ * @param [in] callback - Pointer to callback function.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_obd_messages_with_meta(
+  void( *callback )( struct can_frame *frame, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Register callback function to be called when OBD message received
+ *        from the vehicle, with the frame as a struct canfd_frame. In FD mode
+ *        this carries payloads of up to 64 bytes, classic frames are passed
+ *        with their 8 byte payload.
+ *
+ * @param [in] callback - Pointer to callback function to be called when
+ *                        OBD message received from the vehicle.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t oscc_subscribe_to_obd_fd_messages(
+  void( *callback )( struct canfd_frame *frame, oscc_frame_meta_s const* meta ) );
+
+/**
+ * @brief Add a brake report subscriber. Unlike
+ *        \ref oscc_subscribe_to_brake_reports, any number of subscribers up
+ *        to a fixed limit can listen at once, each with its own user data.
+ *
+ *        Handlers run on the receive path (see \ref oscc_rx_mode_t) and
+ *        subscribers may be added or removed while frames are dispatched.
+ *
+ * @param [in] handler - Function called with each brake report, its receive
+ *        metadata and user_data.
+ *
+ * @param [in] user_data - Passed unchanged to the handler.
+ *
+ * @return Handle for \ref oscc_unsubscribe, or
+ *         \ref OSCC_INVALID_SUBSCRIPTION if the handler is NULL or there
+ *         is no free subscriber slot.
+ */
+oscc_subscription_t oscc_add_brake_report_subscriber(
+  void( *handler )( oscc_brake_report_s *report,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Add a throttle report subscriber. See
+ *        \ref oscc_add_brake_report_subscriber.
+ *
+ * @return Handle for \ref oscc_unsubscribe or \ref OSCC_INVALID_SUBSCRIPTION
+ */
+oscc_subscription_t oscc_add_throttle_report_subscriber(
+  void( *handler )( oscc_throttle_report_s *report,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Add a steering report subscriber. See
+ *        \ref oscc_add_brake_report_subscriber.
+ *
+ * @return Handle for \ref oscc_unsubscribe or \ref OSCC_INVALID_SUBSCRIPTION
+ */
+oscc_subscription_t oscc_add_steering_report_subscriber(
+  void( *handler )( oscc_steering_report_s *report,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Add a fault report subscriber. See
+ *        \ref oscc_add_brake_report_subscriber.
+ *
+ * @return Handle for \ref oscc_unsubscribe or \ref OSCC_INVALID_SUBSCRIPTION
+ */
+oscc_subscription_t oscc_add_fault_report_subscriber(
+  void( *handler )( oscc_fault_report_s *report,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Add a vehicle OBD frame subscriber. Frames are passed as a struct
+ *        canfd_frame, so in FD mode they carry up to 64 bytes. See
+ *        \ref oscc_add_brake_report_subscriber.
+ *
+ * @return Handle for \ref oscc_unsubscribe or \ref OSCC_INVALID_SUBSCRIPTION
+ */
+oscc_subscription_t oscc_add_obd_subscriber(
+  void( *handler )( struct canfd_frame *frame,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Add a subscriber to every frame with one standard CAN ID, looked up
+ *        in constant time however many IDs are subscribed to. OSCC report IDs
+ *        are delivered when they decode as reports, other IDs whenever OBD
+ *        frames are. The ID is added to the kernel filter with
+ *        \ref oscc_add_obd_can_filter. See
+ *        \ref oscc_add_brake_report_subscriber.
+ *
+ * @param [in] can_id - Standard (11-bit) CAN ID to subscribe to.
+ *
+ * @return Handle for \ref oscc_unsubscribe or \ref OSCC_INVALID_SUBSCRIPTION
+ */
+oscc_subscription_t oscc_add_can_id_subscriber(
+  unsigned int can_id,
+  void( *handler )( struct canfd_frame *frame,
+                    oscc_frame_meta_s const* meta,
+                    void* user_data ),
+  void* user_data );
+
+/**
+ * @brief Remove a subscriber added with an oscc_add_* function. A handler
+ *        already running on the receive path may still complete.
+ *
+ * @param [in] subscription - Handle returned when the subscriber was added.
+ *
+ * @return OSCC_ERROR if the handle is invalid or was already removed,
+ *         otherwise OSCC_OK
+ */
+oscc_result_t oscc_unsubscribe( oscc_subscription_t subscription );
+
+/**
+ * @brief Extend the kernel filter so OBD frames matching the ID and mask
+ *        reach \ref oscc_subscribe_to_obd_messages subscribers. By default
+ *        only the OBD IDs of the selected vehicle are accepted. The filter is applied
+ *        to the socket carrying vehicle CAN, immediately if it is open.
+ *
+ * @param [in] can_id - CAN ID to accept.
+ *
+ * @param [in] can_mask - Bits of the ID that must match, see CAN_RAW_FILTER.
+ *
+ * @return OSCC_ERROR if the filter table is full, otherwise OSCC_OK
+ */
+oscc_result_t oscc_add_obd_can_filter( unsigned int can_id, unsigned int can_mask );
+
+/**
+ * @brief Get the frame counters of the OSCC and vehicle CAN sockets,
+ *        including frames the kernel dropped or filtered out for us.
+ *
+ * @param [out] stats - Counters since the channels were opened. Counters of a
+ *        channel that is not open are zero.
+ *
+ * @return OSCC_ERROR if stats is NULL, otherwise OSCC_OK
+ */
+oscc_result_t oscc_get_can_stats( oscc_can_stats_s* stats );
+
 /**
  * @brief Set vehicle right rear wheel speed in kph from CAN frame. (kph)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with wheel speed (CAN ID: \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID)
+ * with wheel speed (the wheel speed CAN ID of the selected vehicle)
  *
  * @param [out] wheel_speed_right_rear - A pointer to double. Set to the unpacked and scaled rear
  * right wheel speed reported by the vehicle (kph).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * wheel speed CAN ID of the selected vehicle
  */
 oscc_result_t get_wheel_speed_right_rear(
   struct can_frame const * const frame,
@@ -204,15 +657,15 @@ oscc_result_t get_wheel_speed_right_rear(
  * @brief Get vehicle left rear wheel speed in kph from CAN frame. (kph)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with wheel speed (CAN ID: \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID)
+ * with wheel speed (the wheel speed CAN ID of the selected vehicle)
  *
  * @param [out] wheel_speed_left_rear - A pointer to double. Set to the unpacked and scaled front
  * left wheel speed reported by the vehicle (kph).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * wheel speed CAN ID of the selected vehicle
  */
 oscc_result_t get_wheel_speed_left_rear(
   struct can_frame const * const frame,
@@ -223,15 +676,15 @@ oscc_result_t get_wheel_speed_left_rear(
  * @brief Get vehicle right front wheel speed in kph from CAN frame. (kph)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with wheel speed (CAN ID: \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID)
+ * with wheel speed (the wheel speed CAN ID of the selected vehicle)
  *
  * @param [out] wheel_speed_right_front - A pointer to double. Set to the unpacked and scaled front
  * right wheel speed reported by the vehicle (kph).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * wheel speed CAN ID of the selected vehicle
  */
 oscc_result_t get_wheel_speed_right_front(
   struct can_frame const * const frame,
@@ -242,34 +695,71 @@ oscc_result_t get_wheel_speed_right_front(
  * @brief Get vehicle left front wheel speed in kph from CAN frame. (kph)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with wheel speed (CAN ID: \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID)
+ * with wheel speed (the wheel speed CAN ID of the selected vehicle)
  *
  * @param [out] wheel_speed_left_front - A pointer to double. Set to the unpacked and scaled rear
  * left wheel speed reported by the vehicle (kph).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * wheel speed CAN ID of the selected vehicle
  */
 oscc_result_t get_wheel_speed_left_front(
   struct can_frame const * const frame,
   double * wheel_speed_left_front
 );
 
+/**
+ * @brief Wheel speeds of a batch of frames, one array per wheel. Each array
+ *        has one entry per frame. (kph)
+ */
+typedef struct
+{
+  double* front_left;
+  double* front_right;
+  double* rear_left;
+  double* rear_right;
+} oscc_wheel_speeds_s;
+
+/**
+ * @brief Get all four wheel speeds from an array of wheel speed frames. (kph)
+ *
+ * Decodes four frames at a time with AVX, or SSE2 on CPUs without it. The
+ * results are bit-identical to the single-wheel getters.
+ *
+ * @param [in] frames - Array of frames with the wheel speed CAN ID of the
+ * selected vehicle
+ *
+ * @param [in] count - Number of frames.
+ *
+ * @param [out] speeds - Arrays of at least count entries per wheel.
+ *
+ * @return:
+ * \li \ref OSCC_OK on successful unpacking.
+ * \li \ref OSCC_ERROR if a parameter is NULL or any CAN frame ID is not the
+ * wheel speed CAN ID of the selected vehicle. The speeds of the frames before
+ * the first such frame are still written.
+ */
+oscc_result_t get_wheel_speeds(
+  struct can_frame const * frames,
+  size_t count,
+  oscc_wheel_speeds_s const * speeds
+);
+
 /**
  * @brief Get vehicle steering wheel angle from CAN frame. (degrees)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with steering wheel angle (CAN ID: \ref KIA_SOUL_OBD_STEERING_WHEEL_ANGLE_CAN_ID)
+ * with steering wheel angle (the steering wheel angle CAN ID of the selected vehicle)
  *
  * @param [out] steering_wheel_angle - A pointer to double. Value is set to the unpacked and scaled
  * steering wheel angle reported by the vehicle (degrees).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_STEERING_WHEEL_ANGLE_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * steering wheel angle CAN ID of the selected vehicle
  */
 oscc_result_t get_steering_wheel_angle(
   struct can_frame const * const frame,
@@ -280,20 +770,40 @@ oscc_result_t get_steering_wheel_angle(
  * @brief Get vehicle brake pressure from CAN frame. (bar)
  *
  * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
- * with brake pressure (CAN ID: \ref KIA_SOUL_OBD_BRAKE_PRESSURE_CAN_ID)
+ * with brake pressure (the brake pressure CAN ID of the selected vehicle)
  *
  * @param [out] brake_pressure - A pointer to double. Set to the unpacked and scaled brake pressure
  * reported by the vehicle (bar).
  *
  * @return:
  * \li \ref OSCC_OK on successful unpacking.
- * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not
- * \ref KIA_SOUL_OBD_BRAKE_PRESSURE_CAN_ID
+ * \li \ref OSCC_ERROR if a parameter is NULL or the CAN frame ID is not the
+ * brake pressure CAN ID of the selected vehicle
  */
 oscc_result_t get_brake_pressure(
   struct can_frame const * const frame,
   double * brake_pressure
 );
 
+/**
+ * @brief Get vehicle speed from CAN frame, as reported by the vehicle rather
+ * than derived from the wheel speeds. (kph)
+ *
+ * @param [in] frame - A pointer to \ref struct can_frame that contains the raw CAN data associated
+ * with vehicle speed (the speed CAN ID of the selected vehicle)
+ *
+ * @param [out] vehicle_speed - A pointer to double. Set to the unpacked and scaled vehicle speed
+ * reported by the vehicle (kph).
+ *
+ * @return:
+ * \li \ref OSCC_OK on successful unpacking.
+ * \li \ref OSCC_ERROR if a parameter is NULL, the selected vehicle does not send a speed
+ * frame or the CAN frame ID is not its speed CAN ID
+ */
+oscc_result_t get_vehicle_speed(
+  struct can_frame const * const frame,
+  double * vehicle_speed
+);
+
 
 #endif // _OSCC_H_ 
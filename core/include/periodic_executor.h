@@ -0,0 +1,122 @@
+/**
+ * @file periodic_executor.h
+ * @brief Periodic executor - Runs a task once per period on absolute
+ *        CLOCK_MONOTONIC deadlines and measures how regular the period is.
+ */
+
+#ifndef _OSCC_PERIODIC_EXECUTOR_H_
+#define _OSCC_PERIODIC_EXECUTOR_H_
+
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "oscc.h"
+
+/**
+ * @brief Period statistics of a \ref periodic_executor_s.
+ */
+typedef struct
+{
+  unsigned long long cycles; /*!< Number of wakeups measured. */
+
+  unsigned long long overruns; /*!< Number of deadlines that expired
+                                *   without a wakeup. */
+
+  double period_min_us; /*!< Shortest measured period. [us] */
+
+  double period_max_us; /*!< Longest measured period. [us] */
+
+  double period_mean_us; /*!< Mean measured period. [us] */
+
+  double jitter_stddev_us; /*!< Standard deviation of the period. [us] */
+
+  double jitter_max_us; /*!< Largest deviation from the nominal period. [us] */
+} periodic_executor_stats_s;
+
+/**
+ * @brief Periodic executor state. Treat as opaque.
+ */
+typedef struct
+{
+  int timer_fd;
+  uint64_t period_ns;
+  uint64_t last_wakeup_ns;
+  unsigned long long cycles;
+  unsigned long long overruns;
+  double period_mean_ns;
+  double period_m2_ns;
+  double period_min_ns;
+  double period_max_ns;
+  double jitter_max_ns;
+} periodic_executor_s;
+
+/**
+ * @brief Create the timerfd and arm it so the first deadline is one period
+ *        from now. Later deadlines are absolute multiples of the period, so
+ *        the time spent in the task does not make the schedule drift.
+ *
+ * @param [out] executor - Executor to initialize.
+ *
+ * @param [in] period_us - Period of the task. [us]
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t periodic_executor_init( periodic_executor_s* executor,
+                                      unsigned long period_us );
+
+/**
+ * @brief Block until the next deadline, then update the period statistics.
+ *
+ * @param [in] executor - Initialized executor.
+ *
+ * @return:
+ * \li \ref OSCC_OK on a wakeup at the next deadline.
+ * \li \ref OSCC_WARNING if one or more deadlines were missed (overrun).
+ * \li \ref OSCC_ERROR if the wait failed or was interrupted by a signal.
+ */
+oscc_result_t periodic_executor_wait( periodic_executor_s* executor );
+
+/**
+ * @brief Run a task once per period until it returns something other than
+ *        OSCC_OK, the wait fails, or the stop flag is set.
+ *
+ * @param [in] executor - Initialized executor.
+ *
+ * @param [in] task - Task to run every period.
+ *
+ * @param [in] user_data - Passed to the task.
+ *
+ * @param [in] stop - Optional. Checked before every wait, typically set from
+ *                    a signal handler.
+ *
+ * @return Result of the last task run, or OSCC_ERROR if the wait failed
+ */
+oscc_result_t periodic_executor_run( periodic_executor_s* executor,
+                                     oscc_result_t( *task )( void* user_data ),
+                                     void* user_data,
+                                     volatile sig_atomic_t const* stop );
+
+/**
+ * @brief Get the period and jitter statistics measured so far.
+ *
+ * @param [in] executor - Initialized executor.
+ *
+ * @param [out] stats - Statistics since \ref periodic_executor_init.
+ */
+void periodic_executor_get_stats( periodic_executor_s const* executor,
+                                  periodic_executor_stats_s* stats );
+
+/**
+ * @brief Print the statistics in one line, prefixed with a label.
+ */
+void periodic_executor_print_stats( periodic_executor_s const* executor,
+                                    const char* label );
+
+/**
+ * @brief Disarm and close the timer.
+ */
+void periodic_executor_close( periodic_executor_s* executor );
+
+
+#endif // _OSCC_PERIODIC_EXECUTOR_H_
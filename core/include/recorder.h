@@ -0,0 +1,176 @@
+/**
+ * @file recorder.h
+ * @brief CAN flight recorder - Appends every frame the library receives or
+ *        writes to a preallocated, memory-mapped ring file.
+ *
+ * The file is sized and mapped when recording starts. Recording a frame is a
+ * copy into the mapping, with no syscalls or allocations, so the page cache
+ * keeps the last records even if the process dies. When the ring is full the
+ * oldest records are overwritten. Frames the kernel sends for the cyclic
+ * command jobs of oscc_start_cyclic_commands are not recorded.
+ *
+ * The file is a \ref oscc_recorder_header_s, padded to
+ * \ref OSCC_RECORDER_HEADER_SIZE bytes, followed by record_capacity
+ * \ref oscc_recorder_record_s. All fields are in host byte order.
+ */
+
+#ifndef _OSCC_RECORDER_H_
+#define _OSCC_RECORDER_H_
+
+
+#include <net/if.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oscc.h"
+
+/**
+ * @brief First bytes of a recorder file.
+ */
+#define OSCC_RECORDER_MAGIC "OSCCREC"
+
+/**
+ * @brief Version of the recorder file format.
+ */
+#define OSCC_RECORDER_VERSION 1
+
+/**
+ * @brief Size of the file header, so the records start on a page boundary.
+ */
+#define OSCC_RECORDER_HEADER_SIZE 4096
+
+/**
+ * @brief Largest vehicle profile name stored in the header.
+ */
+#define OSCC_RECORDER_VEHICLE_NAME_SIZE 32
+
+/**
+ * @brief Record flag set on frames the library wrote.
+ */
+#define OSCC_RECORDER_FLAG_TX ( 1 << 0 )
+
+/**
+ * @brief Record flag set on CAN FD frames.
+ */
+#define OSCC_RECORDER_FLAG_FD ( 1 << 1 )
+
+/**
+ * @brief Role of the channel a frame was recorded on.
+ */
+typedef enum
+{
+  OSCC_RECORDER_CHANNEL_OSCC,
+  OSCC_RECORDER_CHANNEL_VEHICLE,
+  OSCC_RECORDER_CHANNEL_COUNT
+} oscc_recorder_channel_t;
+
+/**
+ * @brief Interface that had a channel role while recording.
+ */
+typedef struct
+{
+  char name[IFNAMSIZ]; /*!< Empty if the role had no channel. */
+} oscc_recorder_channel_s;
+
+/**
+ * @brief Recorder file header.
+ */
+typedef struct
+{
+  char magic[8]; /*!< \ref OSCC_RECORDER_MAGIC */
+
+  uint32_t version; /*!< \ref OSCC_RECORDER_VERSION */
+
+  uint32_t header_size; /*!< Offset of the first record. [bytes] */
+
+  uint32_t record_size; /*!< sizeof(\ref oscc_recorder_record_s) [bytes] */
+
+  uint32_t vehicle; /*!< \ref oscc_vehicle_t selected while recording. */
+
+  uint64_t record_capacity; /*!< Number of records in the ring. */
+
+  uint64_t records_written; /*!< Number of records written, set when
+                             *   recording stops; 0 while recording. */
+
+  uint64_t start_time_ns; /*!< CLOCK_REALTIME when recording started. [ns] */
+
+  char vehicle_name[OSCC_RECORDER_VEHICLE_NAME_SIZE]; /*!< Profile name, as
+                                                       *   accepted by
+                                                       *   oscc_select_vehicle_by_name. */
+
+  oscc_recorder_channel_s channels[OSCC_RECORDER_CHANNEL_COUNT]; /*!< Indexed
+                                                                  *   by \ref oscc_recorder_channel_t. */
+} oscc_recorder_header_s;
+
+/**
+ * @brief One recorded frame.
+ *
+ * Record n (counting from 0) is stored in slot n % record_capacity, and its
+ * sequence is written last, so a slot holds a complete record if its
+ * sequence is not 0 and maps back to the slot.
+ */
+typedef struct
+{
+  uint64_t timestamp_ns; /*!< Kernel receive time of received frames, write
+                          *   time of written frames. CLOCK_REALTIME [ns] */
+
+  uint64_t sequence; /*!< n + 1 for record n; 0 for an empty slot. */
+
+  uint32_t can_id; /*!< CAN ID with the EFF/RTR/ERR flags of the frame. */
+
+  uint8_t len; /*!< Payload length. [bytes] */
+
+  uint8_t flags; /*!< \ref OSCC_RECORDER_FLAG_TX, \ref OSCC_RECORDER_FLAG_FD */
+
+  uint8_t channel; /*!< \ref oscc_recorder_channel_t */
+
+  uint8_t reserved;
+
+  uint8_t data[64]; /*!< Payload, CANFD_MAX_DLEN bytes. */
+} oscc_recorder_record_s;
+
+/**
+ * @brief Recorder counters.
+ */
+typedef struct
+{
+  unsigned long long records_written; /*!< Records written since start. */
+
+  unsigned long long record_capacity; /*!< Size of the ring. [records] */
+} oscc_recorder_stats_s;
+
+/**
+ * @brief Create or truncate the file, preallocate and map the ring, and start
+ *        recording the frames of both channels.
+ *
+ * The header takes the selected vehicle and the channels that are open, and
+ * is updated when a channel is opened later.
+ *
+ * @param [in] path - Recorder file.
+ *
+ * @param [in] record_capacity - Number of records in the ring.
+ *
+ * @return OSCC_ERROR if already recording or the file could not be created
+ *         and mapped, otherwise OSCC_OK
+ */
+oscc_result_t oscc_recorder_start( const char* path, size_t record_capacity );
+
+/**
+ * @brief Stop recording, store the record count in the header, flush and
+ *        unmap the file.
+ *
+ * @return OSCC_ERROR if not recording, otherwise OSCC_OK
+ */
+oscc_result_t oscc_recorder_stop( void );
+
+/**
+ * @brief Get the recorder counters.
+ *
+ * @param [out] stats - Counters, all 0 while not recording.
+ *
+ * @return OSCC_ERROR if stats is NULL, otherwise OSCC_OK
+ */
+oscc_result_t oscc_recorder_get_stats( oscc_recorder_stats_s* stats );
+
+
+#endif // _OSCC_RECORDER_H_
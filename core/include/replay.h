@@ -0,0 +1,172 @@
+/**
+ * @file replay.h
+ * @brief CAN log replay - Loads a recorder file or a candump log and writes
+ *        its frames to CAN interfaces with their original spacing, scaled
+ *        or as fast as possible.
+ *
+ * Frames are sent on absolute CLOCK_MONOTONIC deadlines measured from the
+ * first frame, so time spent writing does not accumulate. The replay sleeps
+ * until shortly before each deadline and spins for the rest, because a
+ * sleep alone wakes up tens of microseconds late.
+ */
+
+#ifndef _OSCC_REPLAY_H_
+#define _OSCC_REPLAY_H_
+
+
+#include <linux/can.h>
+#include <net/if.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oscc.h"
+
+/**
+ * @brief Largest number of channels in a log.
+ */
+#define REPLAY_MAX_CHANNELS 8
+
+/**
+ * @brief Default time spent spinning before each deadline. [us]
+ */
+#define REPLAY_DEFAULT_SPIN_US 200
+
+/**
+ * @brief Timing error above which a frame counts as late. [us]
+ */
+#define REPLAY_LATE_THRESHOLD_US 100
+
+/**
+ * @brief Frame flag of CAN FD frames.
+ */
+#define REPLAY_FRAME_FD ( 1 << 0 )
+
+/**
+ * @brief Frame flag of frames the recording library wrote itself.
+ */
+#define REPLAY_FRAME_TX ( 1 << 1 )
+
+/**
+ * @brief One logged frame.
+ */
+typedef struct
+{
+  uint64_t timestamp_ns; /*!< Time of the frame in the log. [ns] */
+
+  uint8_t channel; /*!< Index into \ref replay_log_s channels. */
+
+  uint8_t flags; /*!< \ref REPLAY_FRAME_FD, \ref REPLAY_FRAME_TX */
+
+  struct canfd_frame frame;
+} replay_frame_s;
+
+/**
+ * @brief A loaded log, frames in time order.
+ */
+typedef struct
+{
+  replay_frame_s* frames;
+  size_t frame_count;
+  size_t frame_capacity;
+
+  char channels[REPLAY_MAX_CHANNELS][IFNAMSIZ]; /*!< Interface names in the
+                                                 *   log, or the recorder
+                                                 *   role if it had none. */
+  size_t channel_count;
+} replay_log_s;
+
+/**
+ * @brief How to replay a log.
+ */
+typedef struct
+{
+  double speed; /*!< 1 for the original timing, 10 for ten times faster, 0
+                 *   to send as fast as the interfaces accept frames. */
+
+  unsigned int spin_us; /*!< Time spent spinning before each deadline. [us] */
+
+  bool include_tx; /*!< Also send the frames the recording library wrote. */
+
+  const char* targets[REPLAY_MAX_CHANNELS]; /*!< Interface to send each log
+                                             *   channel on. NULL sends on the
+                                             *   interface named in the log. */
+} replay_config_s;
+
+/**
+ * @brief What a replay achieved. The timing error of a frame is the time it
+ *        was written minus its deadline.
+ */
+typedef struct
+{
+  unsigned long long frames_sent;
+
+  unsigned long long frames_skipped; /*!< TX frames left out. */
+
+  unsigned long long frames_late; /*!< Frames written more than
+                                   *   \ref REPLAY_LATE_THRESHOLD_US late. */
+
+  double duration_s; /*!< Time from the first to the last frame. [s] */
+
+  double error_mean_us; /*!< Mean timing error. [us] */
+
+  double error_stddev_us; /*!< Standard deviation of the timing error. [us] */
+
+  double error_max_us; /*!< Largest timing error. [us] */
+} replay_stats_s;
+
+/**
+ * @brief Fill a config with the original timing, the default spin and
+ *        every channel sent on the interface named in the log.
+ */
+void replay_default_config( replay_config_s* config );
+
+/**
+ * @brief Load a log, detecting its format.
+ *
+ * Recorder files (see recorder.h) are read from their oldest complete record,
+ * so a file left behind by a crash loads too. Any other file is read as a
+ * candump log, "(seconds.micros) interface id#data" per line, as written by
+ * candump -l, with "id##flags data" for CAN FD frames.
+ *
+ * @param [out] log - Log to fill. Release with \ref replay_free.
+ *
+ * @param [in] path - Log file.
+ *
+ * @return OSCC_ERROR or OSCC_OK
+ */
+oscc_result_t replay_load( replay_log_s* log, const char* path );
+
+/**
+ * @brief Release everything \ref replay_load allocated.
+ */
+void replay_free( replay_log_s* log );
+
+/**
+ * @brief Send the frames of a log.
+ *
+ * @param [in] log - Loaded log.
+ *
+ * @param [in] config - How to replay it.
+ *
+ * @param [out] stats - What the replay achieved. May be NULL.
+ *
+ * @param [in] stop - Replay stops when the flag is set, e.g. by a signal
+ *        handler. May be NULL.
+ *
+ * @return OSCC_ERROR if an interface could not be opened or a write failed,
+ *         otherwise OSCC_OK
+ */
+oscc_result_t replay_run( replay_log_s const* log,
+                          replay_config_s const* config,
+                          replay_stats_s* stats,
+                          volatile sig_atomic_t const* stop );
+
+/**
+ * @brief Print replay stats on one line.
+ */
+void replay_print_stats( replay_stats_s const* stats );
+
+
+#endif // _OSCC_REPLAY_H_
@@ -0,0 +1,98 @@
+/**
+ * @file vehicle_state.h
+ * @brief Vehicle state - The latest decoded vehicle feedback and OSCC module
+ *        state, readable from any thread as one consistent snapshot.
+ *
+ * The receive path decodes every wheel speed, steering wheel angle, brake
+ * pressure and vehicle speed frame, and every OSCC report, into one state
+ * store before the subscribers of the frame run. The store is published
+ * under a sequence lock: the single writer never waits, and readers copy the
+ * state without locks, retrying only if a frame was decoded during the copy.
+ */
+
+#ifndef _OSCC_VEHICLE_STATE_H_
+#define _OSCC_VEHICLE_STATE_H_
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "oscc.h"
+
+/**
+ * @brief One decoded vehicle signal.
+ */
+typedef struct
+{
+  double value; /*!< Last decoded value, in the unit of its getter. */
+
+  uint64_t timestamp_ns; /*!< CLOCK_MONOTONIC time the frame carrying the
+                          *   value was dispatched. [ns] */
+
+  uint32_t sequence; /*!< Number of times the value was received; 0 if it
+                      *   never was and the other fields are not valid. */
+} oscc_vehicle_signal_s;
+
+/**
+ * @brief State of one OSCC module, from its reports and fault reports.
+ */
+typedef struct
+{
+  bool enabled; /*!< Controls enabled, false after a fault report. */
+
+  bool operator_override; /*!< Operator override reported. */
+
+  uint8_t dtcs; /*!< DTC bitfield of the last report or fault report. */
+
+  uint64_t timestamp_ns; /*!< CLOCK_MONOTONIC time the last report or fault
+                          *   report was dispatched. [ns] */
+
+  uint32_t sequence; /*!< Number of reports and fault reports received; 0 if
+                      *   none was and the other fields are not valid. */
+} oscc_module_state_s;
+
+/**
+ * @brief Snapshot of the vehicle state.
+ */
+typedef struct
+{
+  oscc_vehicle_signal_s wheel_speed_front_left; /*!< [kph] */
+
+  oscc_vehicle_signal_s wheel_speed_front_right; /*!< [kph] */
+
+  oscc_vehicle_signal_s wheel_speed_rear_left; /*!< [kph] */
+
+  oscc_vehicle_signal_s wheel_speed_rear_right; /*!< [kph] */
+
+  oscc_vehicle_signal_s steering_wheel_angle; /*!< [degrees] */
+
+  oscc_vehicle_signal_s brake_pressure; /*!< [bar] */
+
+  oscc_vehicle_signal_s vehicle_speed; /*!< [kph] Sequence stays 0 on
+                                        *   vehicles without a speed frame. */
+
+  oscc_module_state_s brake;
+
+  oscc_module_state_s throttle;
+
+  oscc_module_state_s steering;
+
+  uint64_t sequence; /*!< Number of frames decoded into the store. */
+} oscc_vehicle_state_s;
+
+/**
+ * @brief Get a consistent snapshot of the latest vehicle state.
+ *
+ * Lock-free and safe to call from any thread, including subscriber
+ * callbacks, which already see the state of the frame they are called for.
+ * The copy is only repeated if a frame was decoded while it was taken.
+ *
+ * @param [out] state - Snapshot. Signals and modules that were never
+ *        received have a sequence of 0.
+ *
+ * @return OSCC_ERROR if state is NULL, otherwise OSCC_OK
+ */
+oscc_result_t oscc_get_vehicle_state( oscc_vehicle_state_s* state );
+
+
+#endif // _OSCC_VEHICLE_STATE_H_
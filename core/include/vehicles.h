@@ -2,6 +2,9 @@
  * @file vehicles.h
  * @brief List of vehicle headers.
  *
+ * The library itself selects the vehicle at run time, see
+ * oscc_select_vehicle(). Define KIA_SOUL, KIA_SOUL_EV or KIA_NIRO to get the
+ * platform macros of one vehicle.
  */
 
 
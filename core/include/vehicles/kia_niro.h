@@ -31,6 +31,13 @@
 // OBD MESSAGES
 // ****************************************************************************
 
+// The signals of these frames are also described in kia_niro.dbc, next to
+// this file, for decoding with dbc_load() and dbc_decode_frame().
+//
+// The library decodes these frames with the vehicle profile in
+// core/src/internal/vehicle_profiles.h, which must be kept in step with the
+// IDs and scalars below.
+
 /*
  * @brief ID of the Kia Niro's OBD steering wheel angle CAN frame.
  *
@@ -29,6 +29,10 @@
 // OBD MESSAGES
 // ****************************************************************************
 
+// The library decodes these frames with the vehicle profile in
+// core/src/internal/vehicle_profiles.h, which must be kept in step with the
+// IDs and scalars below.
+
 /*
  * @brief ID of the Kia Soul's OBD steering wheel angle CAN frame.
  *
@@ -0,0 +1,526 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/include/dbc.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "DBC extraction assumes a little-endian host"
+#endif
+
+#define DBC_LINE_SIZE 4096
+#define DBC_PAYLOAD_SIZE CANFD_MAX_DLEN
+#define DBC_WORD_SIZE 8
+#define DBC_LAST_LOAD_BYTE ( DBC_PAYLOAD_SIZE - DBC_WORD_SIZE )
+#define DBC_INDEPENDENT_SIGNALS "VECTOR__INDEPENDENT_SIG_MSG"
+#define DBC_MAX_SIGNALS UINT16_MAX
+#define DBC_MAX_MESSAGES ( UINT16_MAX - 1 )
+
+enum
+{
+  DBC_PROGRAM_LITTLE_ENDIAN = 1 << 0,
+  DBC_PROGRAM_FLOAT = 1 << 1,
+  DBC_PROGRAM_DOUBLE = 1 << 2
+};
+
+static const char* skip_space(const char* text)
+{
+  while (*text!='\0' && isspace((unsigned char) *text))
+    ++text;
+  return text;
+}
+
+static bool starts_with(const char* text, const char* prefix)
+{
+  return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+static size_t count_quotes(const char* text)
+{
+  size_t count = 0;
+  for (; *text!='\0'; ++text)
+  {
+    if (*text == '"')
+      ++count;
+  }
+  return count;
+}
+
+static char* copy_string(const char* text, size_t length)
+{
+  char* copy = (char*) malloc(length + 1);
+  if (copy != NULL)
+  {
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+  }
+  return copy;
+}
+
+// Grows an array to hold at least one more element
+static bool reserve(void** array, size_t* capacity, size_t count, size_t element_size)
+{
+  if (count < *capacity)
+    return true;
+
+  size_t new_capacity = *capacity==0 ? 16 : *capacity*2;
+  void* grown = realloc(*array, new_capacity * element_size);
+  if (grown == NULL)
+    return false;
+
+  *array = grown;
+  *capacity = new_capacity;
+  return true;
+}
+
+static dbc_signal_info_s* find_signal_info(dbc_database_s* database,
+                                           uint32_t can_id,
+                                           const char* name)
+{
+  for (size_t i=0; i<database->signal_count; ++i)
+  {
+    if (database->signals[i].can_id==can_id && strcmp(database->signals[i].name, name)==0)
+      return &database->signals[i];
+  }
+  return NULL;
+}
+
+//  SG_ name [M|mN] : start|length@order sign (factor,offset) [min|max] "unit" receivers
+static oscc_result_t parse_signal(const char* text,
+                                  dbc_message_program_s const* message,
+                                  const char* message_name,
+                                  unsigned int message_dlc,
+                                  dbc_signal_info_s* signal,
+                                  bool* multiplexed)
+{
+  char name[DBC_LINE_SIZE];
+  char multiplexer[DBC_LINE_SIZE];
+
+  const char* layout = strchr(text, ':');
+  if (layout == NULL)
+    return OSCC_ERROR;
+
+  int fields = sscanf(text, "SG_ %s %[^: ]", name, multiplexer);
+  if (fields < 1)
+    return OSCC_ERROR;
+
+  *multiplexed = fields==2 && multiplexer[0]=='m';
+
+  unsigned int start_bit = 0;
+  unsigned int length = 0;
+  char order = 0;
+  char sign = 0;
+
+  if (sscanf(layout + 1,
+             " %u|%u@%c%c (%lf,%lf) [%lf|%lf]",
+             &start_bit, &length, &order, &sign,
+             &signal->factor, &signal->offset,
+             &signal->minimum, &signal->maximum) != 8
+      || (order!='0' && order!='1')
+      || (sign!='+' && sign!='-'))
+    return OSCC_ERROR;
+
+  signal->can_id = message->can_id;
+  signal->message_dlc = message_dlc;
+  signal->start_bit = start_bit;
+  signal->length = length;
+  signal->little_endian = order == '1';
+  signal->is_signed = sign == '-';
+  signal->value_type = DBC_VALUE_INTEGER;
+  signal->name = copy_string(name, strlen(name));
+  signal->message = copy_string(message_name, strlen(message_name));
+
+  const char* unit = strchr(layout, '"');
+  const char* unit_end = unit != NULL ? strchr(unit + 1, '"') : NULL;
+  if (unit_end != NULL)
+    signal->unit = copy_string(unit + 1, unit_end - unit - 1);
+  else
+    signal->unit = copy_string("", 0);
+
+  if (signal->name==NULL || signal->message==NULL || signal->unit==NULL
+      || start_bit>UINT16_MAX || length>UINT8_MAX)
+    return OSCC_ERROR;
+
+  return OSCC_OK;
+}
+
+// Compiles a signal into a single 8-byte load, shift and mask
+static oscc_result_t compile_signal(dbc_signal_info_s const* signal,
+                                    dbc_signal_program_s* program)
+{
+  unsigned int first_byte = signal->start_bit / 8;
+  unsigned int last_byte = 0;
+  unsigned int bit_shift = 0;
+
+  if (signal->little_endian)
+  {
+    last_byte = (signal->start_bit + signal->length - 1) / 8;
+    bit_shift = signal->start_bit % 8;
+  }
+  else
+  {
+    // Motorola start bits count from the MSB; walk it as a big-endian stream
+    unsigned int msb = first_byte*8 + 7 - signal->start_bit%8;
+    last_byte = (msb + signal->length - 1) / 8;
+    bit_shift = 7 - (msb + signal->length - 1) % 8;
+  }
+
+  if (signal->length==0 || signal->length>64
+      || last_byte>=DBC_PAYLOAD_SIZE
+      || last_byte-first_byte>=DBC_WORD_SIZE
+      || (signal->value_type==DBC_VALUE_FLOAT && signal->length!=32)
+      || (signal->value_type==DBC_VALUE_DOUBLE && signal->length!=64))
+  {
+    printf("Error: Signal %s has an unsupported layout\n", signal->name);
+    return OSCC_ERROR;
+  }
+
+  // Load from where a whole word still fits in the payload; a big-endian
+  // load puts the signal's last byte above the bytes that follow it
+  unsigned int load_byte = first_byte < DBC_LAST_LOAD_BYTE ? first_byte : DBC_LAST_LOAD_BYTE;
+
+  memset(program, 0, sizeof(*program));
+  program->load_byte = load_byte;
+  program->end_byte = last_byte + 1;
+  program->mask = signal->length==64 ? ~0ULL : (1ULL << signal->length) - 1;
+  program->factor = signal->factor;
+  program->offset = signal->offset;
+
+  if (signal->little_endian)
+  {
+    program->flags |= DBC_PROGRAM_LITTLE_ENDIAN;
+    program->shift = 8*(first_byte - load_byte) + bit_shift;
+  }
+  else
+    program->shift = 8*(load_byte + DBC_WORD_SIZE - 1 - last_byte) + bit_shift;
+
+  if (signal->value_type == DBC_VALUE_FLOAT)
+    program->flags |= DBC_PROGRAM_FLOAT;
+  else if (signal->value_type == DBC_VALUE_DOUBLE)
+    program->flags |= DBC_PROGRAM_DOUBLE;
+  else if (signal->is_signed && signal->length<64)
+    program->sign_bit = 1ULL << (signal->length - 1);
+
+  return OSCC_OK;
+}
+
+static int compare_extended_ids(const void* left, const void* right, void* messages)
+{
+  uint32_t left_id = ((dbc_message_program_s*) messages)[*(uint16_t const*) left].can_id;
+  uint32_t right_id = ((dbc_message_program_s*) messages)[*(uint16_t const*) right].can_id;
+  return left_id < right_id ? -1 : left_id > right_id;
+}
+
+static oscc_result_t index_messages(dbc_database_s* database)
+{
+  for (size_t i=0; i<database->message_count; ++i)
+  {
+    uint32_t can_id = database->messages[i].can_id;
+
+    if (can_id & CAN_EFF_FLAG)
+      ++database->extended_count;
+    else if (can_id <= CAN_SFF_MASK)
+      database->standard_ids[can_id] = i + 1;
+  }
+
+  if (database->extended_count > 0)
+  {
+    database->extended_ids = (uint16_t*) calloc(database->extended_count, sizeof(uint16_t));
+    if (database->extended_ids == NULL)
+      return OSCC_ERROR;
+
+    size_t extended = 0;
+    for (size_t i=0; i<database->message_count; ++i)
+    {
+      if (database->messages[i].can_id & CAN_EFF_FLAG)
+        database->extended_ids[extended++] = i;
+    }
+
+    qsort_r(database->extended_ids,
+            database->extended_count,
+            sizeof(uint16_t),
+            compare_extended_ids,
+            database->messages);
+  }
+
+  return OSCC_OK;
+}
+
+static oscc_result_t parse_dbc(dbc_database_s* database, FILE* file, const char* path)
+{
+  oscc_result_t result = OSCC_OK;
+  size_t signal_capacity = 0;
+  size_t message_capacity = 0;
+  dbc_message_program_s* message = NULL;
+  char message_name[DBC_LINE_SIZE] = "";
+  unsigned int message_dlc = 0;
+  bool in_string = false;
+  int line_number = 0;
+  char line[DBC_LINE_SIZE];
+
+  while (result==OSCC_OK && fgets(line, sizeof(line), file)!=NULL)
+  {
+    ++line_number;
+    const char* text = skip_space(line);
+    bool odd_quotes = count_quotes(text) % 2 != 0;
+
+    // Skip the continuation lines of multi-line comments and attributes
+    if (in_string)
+    {
+      in_string = !odd_quotes;
+      continue;
+    }
+
+    if (starts_with(text, "BO_ "))
+    {
+      unsigned long can_id = 0;
+      message = NULL;
+
+      if (sscanf(text, "BO_ %lu %[^: ] : %u", &can_id, message_name, &message_dlc) != 3)
+      {
+        printf("Error: %s:%d: malformed message\n", path, line_number);
+        result = OSCC_ERROR;
+      }
+      else if (strcmp(message_name, DBC_INDEPENDENT_SIGNALS) != 0)
+      {
+        if (database->message_count >= DBC_MAX_MESSAGES
+            || !reserve((void**) &database->messages, &message_capacity,
+                        database->message_count, sizeof(dbc_message_program_s)))
+          result = OSCC_ERROR;
+        else
+        {
+          message = &database->messages[database->message_count++];
+          message->can_id = can_id;
+          message->first_signal = database->signal_count;
+          message->signal_count = 0;
+        }
+      }
+    }
+    else if (starts_with(text, "SG_ ") && message!=NULL)
+    {
+      dbc_signal_info_s signal;
+      bool multiplexed = false;
+      memset(&signal, 0, sizeof(signal));
+
+      if (parse_signal(text, message, message_name, message_dlc,
+                       &signal, &multiplexed) != OSCC_OK)
+      {
+        printf("Error: %s:%d: malformed signal\n", path, line_number);
+        result = OSCC_ERROR;
+      }
+      else if (multiplexed)
+        printf("Warning: %s:%d: skipping multiplexed signal %s\n", path, line_number, signal.name);
+      else if (database->signal_count >= DBC_MAX_SIGNALS
+               || !reserve((void**) &database->signals, &signal_capacity,
+                           database->signal_count, sizeof(dbc_signal_info_s)))
+        result = OSCC_ERROR;
+      else
+      {
+        database->signals[database->signal_count++] = signal;
+        ++message->signal_count;
+        memset(&signal, 0, sizeof(signal));
+      }
+
+      free((void*) signal.name);
+      free((void*) signal.message);
+      free((void*) signal.unit);
+    }
+    else if (starts_with(text, "SIG_VALTYPE_ "))
+    {
+      unsigned long can_id = 0;
+      char name[DBC_LINE_SIZE];
+      int value_type = 0;
+
+      if (sscanf(text, "SIG_VALTYPE_ %lu %s : %d", &can_id, name, &value_type) != 3)
+      {
+        printf("Error: %s:%d: malformed signal value type\n", path, line_number);
+        result = OSCC_ERROR;
+      }
+      else
+      {
+        dbc_signal_info_s* signal = find_signal_info(database, can_id, name);
+        if (signal != NULL)
+          signal->value_type = (dbc_value_type_t) value_type;
+      }
+    }
+    else
+      in_string = odd_quotes;
+  }
+
+  return result;
+}
+
+oscc_result_t dbc_load(dbc_database_s* database, const char* path)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (database==NULL || path==NULL)
+    return result;
+
+  memset(database, 0, sizeof(*database));
+
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    printf("Error: Could not open DBC file %s\n", path);
+    return result;
+  }
+
+  result = parse_dbc(database, file, path);
+  fclose(file);
+
+  if (result==OSCC_OK && database->signal_count>0)
+  {
+    database->programs = (dbc_signal_program_s*) calloc(database->signal_count,
+                                                         sizeof(dbc_signal_program_s));
+    if (database->programs == NULL)
+      result = OSCC_ERROR;
+  }
+
+  for (size_t i=0; result==OSCC_OK && i<database->signal_count; ++i)
+    result = compile_signal(&database->signals[i], &database->programs[i]);
+
+  if (result == OSCC_OK)
+    result = index_messages(database);
+
+  if (result != OSCC_OK)
+  {
+    printf("Error: Loading DBC file %s failed\n", path);
+    dbc_free(database);
+  }
+
+  return result;
+}
+
+void dbc_free(dbc_database_s* database)
+{
+  if (database == NULL)
+    return;
+
+  for (size_t i=0; i<database->signal_count; ++i)
+  {
+    free((void*) database->signals[i].name);
+    free((void*) database->signals[i].message);
+    free((void*) database->signals[i].unit);
+  }
+
+  free(database->signals);
+  free(database->programs);
+  free(database->messages);
+  free(database->extended_ids);
+  memset(database, 0, sizeof(*database));
+}
+
+size_t dbc_signal_count(dbc_database_s const* database)
+{
+  return database != NULL ? database->signal_count : 0;
+}
+
+int dbc_find_signal(dbc_database_s const* database, const char* name)
+{
+  if (database==NULL || name==NULL)
+    return DBC_SIGNAL_NOT_FOUND;
+
+  for (size_t i=0; i<database->signal_count; ++i)
+  {
+    if (strcmp(database->signals[i].name, name) == 0)
+      return i;
+  }
+
+  return DBC_SIGNAL_NOT_FOUND;
+}
+
+dbc_signal_info_s const* dbc_get_signal_info(dbc_database_s const* database, size_t index)
+{
+  if (database==NULL || index>=database->signal_count)
+    return NULL;
+
+  return &database->signals[index];
+}
+
+static dbc_message_program_s const* find_message(dbc_database_s const* database,
+                                                 canid_t can_id)
+{
+  if ((can_id & CAN_EFF_FLAG) == 0)
+  {
+    uint16_t index = database->standard_ids[can_id & CAN_SFF_MASK];
+    return index != 0 ? &database->messages[index-1] : NULL;
+  }
+
+  can_id &= CAN_EFF_FLAG | CAN_EFF_MASK;
+
+  size_t low = 0;
+  size_t high = database->extended_count;
+
+  while (low < high)
+  {
+    size_t middle = (low + high) / 2;
+    dbc_message_program_s const* message = &database->messages[database->extended_ids[middle]];
+
+    if (message->can_id == can_id)
+      return message;
+    else if (message->can_id < can_id)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  return NULL;
+}
+
+static inline double run_program(dbc_signal_program_s const* program, uint8_t const* data)
+{
+  uint64_t word;
+  memcpy(&word, data + program->load_byte, sizeof(word));
+
+  if ((program->flags & DBC_PROGRAM_LITTLE_ENDIAN) == 0)
+    word = __builtin_bswap64(word);
+
+  uint64_t raw = (word >> program->shift) & program->mask;
+  double value = 0;
+
+  if (program->flags & DBC_PROGRAM_FLOAT)
+  {
+    uint32_t bits = raw;
+    float single;
+    memcpy(&single, &bits, sizeof(single));
+    value = single;
+  }
+  else if (program->flags & DBC_PROGRAM_DOUBLE)
+    memcpy(&value, &raw, sizeof(value));
+  else if (program->sign_bit != 0)
+    value = (double) (int64_t) ((raw ^ program->sign_bit) - program->sign_bit);
+  else
+    value = (double) raw;
+
+  return value*program->factor + program->offset;
+}
+
+size_t dbc_decode_frame(dbc_database_s const* database,
+                        struct canfd_frame const* frame,
+                        double* values,
+                        size_t value_count)
+{
+  if (database==NULL || frame==NULL || values==NULL)
+    return 0;
+
+  dbc_message_program_s const* message = find_message(database, frame->can_id);
+  if (message==NULL || (size_t) message->first_signal+message->signal_count > value_count)
+    return 0;
+
+  size_t decoded = 0;
+  dbc_signal_program_s const* program = &database->programs[message->first_signal];
+  double* value = &values[message->first_signal];
+
+  for (uint16_t i=0; i<message->signal_count; ++i, ++program, ++value)
+  {
+    if (program->end_byte <= frame->len)
+    {
+      *value = run_program(program, frame->data);
+      ++decoded;
+    }
+  }
+
+  return decoded;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file dbc_checks.cc
+ * @brief Compile-time checks of the generated oscc.dbc codec against the
+ *        hand-written CAN protocol structs.
+ *
+ * Nothing here runs: a codec or struct that drifts from the other fails the
+ * build of oscc_lib.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include "core/include/can_protocols/brake_can_protocol.h"
+#include "core/include/can_protocols/fault_can_protocol.h"
+#include "core/include/can_protocols/oscc_dbc.h"
+#include "core/include/can_protocols/packed_command_can_protocol.h"
+#include "core/include/can_protocols/steering_can_protocol.h"
+#include "core/include/can_protocols/throttle_can_protocol.h"
+
+// The signal occupies exactly the bytes of the struct field
+#define CHECK_FIELD(signal, type, field)                                        \
+  static_assert(signal::start_bit % 8 == 0                                      \
+                && signal::start_bit / 8 == offsetof(type, field)               \
+                && signal::length == 8 * sizeof(((type*) 0)->field),            \
+                #signal " does not match " #type "." #field)
+
+#define CHECK_MESSAGE(dbc_name, can_id, type)                                   \
+  static_assert(OSCC_DBC_##dbc_name##_CAN_ID == (can_id)                        \
+                && OSCC_DBC_##dbc_name##_DLC == sizeof(type),                   \
+                #dbc_name " does not match " #type)
+
+#define CHECK_FLOAT(signal, type, field)                                        \
+  CHECK_FIELD(signal, type, field);                                             \
+  static_assert(std::is_same<signal::value_t,                                   \
+                             decltype(((type*) 0)->field)>::value,              \
+                #signal " is not a float")
+
+CHECK_MESSAGE(BRAKE_ENABLE, OSCC_BRAKE_ENABLE_CAN_ID, oscc_brake_enable_s);
+CHECK_FIELD(oscc_dbc_brake_enable_magic_s, oscc_brake_enable_s, magic);
+CHECK_FIELD(oscc_dbc_brake_enable_reserved_s, oscc_brake_enable_s, reserved);
+CHECK_MESSAGE(BRAKE_DISABLE, OSCC_BRAKE_DISABLE_CAN_ID, oscc_brake_disable_s);
+CHECK_FIELD(oscc_dbc_brake_disable_magic_s, oscc_brake_disable_s, magic);
+CHECK_FIELD(oscc_dbc_brake_disable_reserved_s, oscc_brake_disable_s, reserved);
+CHECK_MESSAGE(BRAKE_COMMAND, OSCC_BRAKE_COMMAND_CAN_ID, oscc_brake_command_s);
+CHECK_FIELD(oscc_dbc_brake_command_magic_s, oscc_brake_command_s, magic);
+CHECK_FLOAT(oscc_dbc_brake_command_pedal_request_s, oscc_brake_command_s, pedal_command);
+CHECK_FIELD(oscc_dbc_brake_command_reserved_s, oscc_brake_command_s, reserved);
+CHECK_MESSAGE(BRAKE_REPORT, OSCC_BRAKE_REPORT_CAN_ID, oscc_brake_report_s);
+CHECK_FIELD(oscc_dbc_brake_report_magic_s, oscc_brake_report_s, magic);
+CHECK_FIELD(oscc_dbc_brake_report_enabled_s, oscc_brake_report_s, enabled);
+CHECK_FIELD(oscc_dbc_brake_report_operator_override_s, oscc_brake_report_s, operator_override);
+CHECK_FIELD(oscc_dbc_brake_report_dtcs_s, oscc_brake_report_s, dtcs);
+CHECK_FIELD(oscc_dbc_brake_report_reserved_s, oscc_brake_report_s, reserved);
+
+CHECK_MESSAGE(STEERING_ENABLE, OSCC_STEERING_ENABLE_CAN_ID, oscc_steering_enable_s);
+CHECK_FIELD(oscc_dbc_steering_enable_magic_s, oscc_steering_enable_s, magic);
+CHECK_FIELD(oscc_dbc_steering_enable_reserved_s, oscc_steering_enable_s, reserved);
+CHECK_MESSAGE(STEERING_DISABLE, OSCC_STEERING_DISABLE_CAN_ID, oscc_steering_disable_s);
+CHECK_FIELD(oscc_dbc_steering_disable_magic_s, oscc_steering_disable_s, magic);
+CHECK_FIELD(oscc_dbc_steering_disable_reserved_s, oscc_steering_disable_s, reserved);
+CHECK_MESSAGE(STEERING_COMMAND, OSCC_STEERING_COMMAND_CAN_ID, oscc_steering_command_s);
+CHECK_FIELD(oscc_dbc_steering_command_magic_s, oscc_steering_command_s, magic);
+CHECK_FLOAT(oscc_dbc_steering_command_torque_request_s, oscc_steering_command_s, torque_command);
+CHECK_FIELD(oscc_dbc_steering_command_reserved_s, oscc_steering_command_s, reserved);
+CHECK_MESSAGE(STEERING_REPORT, OSCC_STEERING_REPORT_CAN_ID, oscc_steering_report_s);
+CHECK_FIELD(oscc_dbc_steering_report_magic_s, oscc_steering_report_s, magic);
+CHECK_FIELD(oscc_dbc_steering_report_enabled_s, oscc_steering_report_s, enabled);
+CHECK_FIELD(oscc_dbc_steering_report_operator_override_s, oscc_steering_report_s, operator_override);
+CHECK_FIELD(oscc_dbc_steering_report_dtcs_s, oscc_steering_report_s, dtcs);
+CHECK_FIELD(oscc_dbc_steering_report_reserved_s, oscc_steering_report_s, reserved);
+
+CHECK_MESSAGE(THROTTLE_ENABLE, OSCC_THROTTLE_ENABLE_CAN_ID, oscc_throttle_enable_s);
+CHECK_FIELD(oscc_dbc_throttle_enable_magic_s, oscc_throttle_enable_s, magic);
+CHECK_FIELD(oscc_dbc_throttle_enable_reserved_s, oscc_throttle_enable_s, reserved);
+CHECK_MESSAGE(THROTTLE_DISABLE, OSCC_THROTTLE_DISABLE_CAN_ID, oscc_throttle_disable_s);
+CHECK_FIELD(oscc_dbc_throttle_disable_magic_s, oscc_throttle_disable_s, magic);
+CHECK_FIELD(oscc_dbc_throttle_disable_reserved_s, oscc_throttle_disable_s, reserved);
+CHECK_MESSAGE(THROTTLE_COMMAND, OSCC_THROTTLE_COMMAND_CAN_ID, oscc_throttle_command_s);
+CHECK_FIELD(oscc_dbc_throttle_command_magic_s, oscc_throttle_command_s, magic);
+CHECK_FLOAT(oscc_dbc_throttle_command_pedal_request_s, oscc_throttle_command_s, torque_request);
+CHECK_FIELD(oscc_dbc_throttle_command_reserved_s, oscc_throttle_command_s, reserved);
+CHECK_MESSAGE(THROTTLE_REPORT, OSCC_THROTTLE_REPORT_CAN_ID, oscc_throttle_report_s);
+CHECK_FIELD(oscc_dbc_throttle_report_magic_s, oscc_throttle_report_s, magic);
+CHECK_FIELD(oscc_dbc_throttle_report_enabled_s, oscc_throttle_report_s, enabled);
+CHECK_FIELD(oscc_dbc_throttle_report_operator_override_s, oscc_throttle_report_s, operator_override);
+CHECK_FIELD(oscc_dbc_throttle_report_dtcs_s, oscc_throttle_report_s, dtcs);
+CHECK_FIELD(oscc_dbc_throttle_report_reserved_s, oscc_throttle_report_s, reserved);
+
+CHECK_MESSAGE(FAULT_REPORT, OSCC_FAULT_REPORT_CAN_ID, oscc_fault_report_s);
+CHECK_FIELD(oscc_dbc_fault_report_magic_s, oscc_fault_report_s, magic);
+CHECK_FIELD(oscc_dbc_fault_report_fault_origin_id_s, oscc_fault_report_s, fault_origin_id);
+CHECK_FIELD(oscc_dbc_fault_report_dtcs_s, oscc_fault_report_s, dtcs);
+CHECK_FIELD(oscc_dbc_fault_report_reserved_s, oscc_fault_report_s, reserved);
+
+CHECK_MESSAGE(PACKED_COMMAND, OSCC_PACKED_COMMAND_CAN_ID, oscc_packed_command_s);
+CHECK_FIELD(oscc_dbc_packed_command_magic_s, oscc_packed_command_s, magic);
+CHECK_FIELD(oscc_dbc_packed_command_reserved_s, oscc_packed_command_s, reserved);
+CHECK_FLOAT(oscc_dbc_packed_command_brake_request_s, oscc_packed_command_s, brake_command);
+CHECK_FLOAT(oscc_dbc_packed_command_throttle_request_s, oscc_packed_command_s, throttle_command);
+CHECK_FLOAT(oscc_dbc_packed_command_torque_request_s, oscc_packed_command_s, steering_command);
+
+
+// Decoding a report reads the values the firmware puts in the struct fields
+static constexpr uint8_t brake_report[OSCC_BRAKE_REPORT_CAN_DLC] =
+{
+  OSCC_MAGIC_BYTE_0, OSCC_MAGIC_BYTE_1, 1, 0, 0x03, 0, 0, 0
+};
+
+static_assert(dbc_decode<oscc_dbc_brake_report_magic_s>(brake_report)
+              == (OSCC_MAGIC_BYTE_1 << 8 | OSCC_MAGIC_BYTE_0),
+              "brake report magic decodes wrong");
+static_assert(dbc_decode<oscc_dbc_brake_report_enabled_s>(brake_report) == 1,
+              "brake report enabled decodes wrong");
+static_assert(dbc_decode<oscc_dbc_brake_report_operator_override_s>(brake_report) == 0,
+              "brake report override decodes wrong");
+static_assert(dbc_decode<oscc_dbc_brake_report_dtcs_s>(brake_report) == 0x03,
+              "brake report DTCs decode wrong");
+
+// Encoding a command writes the float bits where the struct keeps them
+static constexpr bool packed_command_round_trips()
+{
+  uint8_t data[OSCC_PACKED_COMMAND_CAN_DLC] = { 0 };
+
+  dbc_encode<oscc_dbc_packed_command_torque_request_s>(data, -0.25f);
+
+  uint32_t const bits = __builtin_bit_cast(uint32_t, -0.25f);
+  bool const placed = data[12] == (uint8_t) bits
+                      && data[13] == (uint8_t) (bits >> 8)
+                      && data[14] == (uint8_t) (bits >> 16)
+                      && data[15] == (uint8_t) (bits >> 24);
+
+  return placed
+         && dbc_decode<oscc_dbc_packed_command_torque_request_s>(data) == -0.25f
+         && dbc_decode<oscc_dbc_packed_command_brake_request_s>(data) == 0.0f;
+}
+
+static_assert(packed_command_round_trips(), "packed command does not round trip");
+
+
+// oscc.dbc has no Motorola, scaled or sub-byte signals, so the codec is
+// checked with hand-written signals of the shapes vehicle DBCs use
+struct check_motorola_12_s
+{
+  typedef uint16_t raw_t;
+  typedef uint16_t value_t;
+  static constexpr uint16_t start_bit = 7;
+  static constexpr uint8_t length = 12;
+  static constexpr bool little_endian = false;
+  static constexpr bool is_signed = false;
+  static constexpr dbc_value_type_t value_type = DBC_VALUE_INTEGER;
+  static constexpr double factor = 1.0;
+  static constexpr double offset = 0.0;
+};
+
+struct check_intel_signed_scaled_s
+{
+  typedef int16_t raw_t;
+  typedef double value_t;
+  static constexpr uint16_t start_bit = 20;
+  static constexpr uint8_t length = 12;
+  static constexpr bool little_endian = true;
+  static constexpr bool is_signed = true;
+  static constexpr dbc_value_type_t value_type = DBC_VALUE_INTEGER;
+  static constexpr double factor = 0.5;
+  static constexpr double offset = 10.0;
+};
+
+static constexpr uint8_t mixed_payload[8] = { 0xAB, 0xCF, 0xF0, 0xFF, 0, 0, 0, 0 };
+
+static_assert(dbc_decode<check_motorola_12_s>(mixed_payload) == 0xABC,
+              "Motorola signal decodes wrong");
+static_assert(dbc_decode<check_intel_signed_scaled_s>(mixed_payload) == 9.5,
+              "signed scaled signal decodes wrong");
+
+static constexpr bool codec_preserves_neighbours()
+{
+  uint8_t data[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0 };
+
+  dbc_encode<check_motorola_12_s>(data, 0x123);
+  dbc_encode<check_intel_signed_scaled_s>(data, -20.0);
+
+  return data[0] == 0x12
+         && data[1] == 0x3F
+         && data[2] == 0x4F
+         && data[3] == 0xFC
+         && data[4] == 0xFF
+         && dbc_decode<check_motorola_12_s>(data) == 0x123
+         && dbc_decode<check_intel_signed_scaled_s>(data) == -20.0;
+}
+
+static_assert(codec_preserves_neighbours(), "encoding clobbers neighbouring bits");
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "core/include/oscc.h"
+#include "internal/dispatch.h"
+#include "internal/oscc.h"
+#include "internal/subscribers.h"
+#include "internal/vehicle_state.h"
+
+typedef void (*can_id_handler_t)(struct canfd_frame*, oscc_frame_meta_s const*, void*);
+
+static dispatch_entry_s global_dispatch_table[OSCC_DISPATCH_TABLE_SIZE];
+
+// Per-ID subscriber nodes are handed out in order and never returned; empty
+// nodes are reused by later subscribers to the same ID instead.
+static can_id_subscriber_node_s global_subscriber_nodes[OSCC_MAX_CAN_ID_SUBSCRIBERS];
+static std::atomic<int> global_subscriber_node_count(0);
+
+static bool oscc_has_magic(struct canfd_frame const* frame)
+{
+  return frame->data[0]==OSCC_MAGIC_BYTE_0 && frame->data[1]==OSCC_MAGIC_BYTE_1;
+}
+
+static bool decode_brake_report(struct canfd_frame* frame, oscc_frame_meta_s const* meta)
+{
+  bool decoded = oscc_has_magic(frame);
+  if (decoded)
+  {
+    oscc_brake_report_s* report = (oscc_brake_report_s*) frame->data;
+    oscc_vehicle_state_update_brake(report, meta);
+    oscc_notify_brake_report(report, meta);
+  }
+  return decoded;
+}
+
+static bool decode_throttle_report(struct canfd_frame* frame, oscc_frame_meta_s const* meta)
+{
+  bool decoded = oscc_has_magic(frame);
+  if (decoded)
+  {
+    oscc_throttle_report_s* report = (oscc_throttle_report_s*) frame->data;
+    oscc_vehicle_state_update_throttle(report, meta);
+    oscc_notify_throttle_report(report, meta);
+  }
+  return decoded;
+}
+
+static bool decode_steering_report(struct canfd_frame* frame, oscc_frame_meta_s const* meta)
+{
+  bool decoded = oscc_has_magic(frame);
+  if (decoded)
+  {
+    oscc_steering_report_s* report = (oscc_steering_report_s*) frame->data;
+    oscc_vehicle_state_update_steering(report, meta);
+    oscc_notify_steering_report(report, meta);
+  }
+  return decoded;
+}
+
+static bool decode_fault_report(struct canfd_frame* frame, oscc_frame_meta_s const* meta)
+{
+  bool decoded = oscc_has_magic(frame);
+  if (decoded)
+  {
+    oscc_fault_report_s* report = (oscc_fault_report_s*) frame->data;
+    oscc_vehicle_state_update_fault(report, meta);
+    oscc_notify_fault_report(report, meta);
+  }
+  return decoded;
+}
+
+void oscc_dispatch_init()
+{
+  // The vehicle may have changed since the channels were last opened
+  for (size_t i=0; i<OSCC_DISPATCH_TABLE_SIZE; ++i)
+    global_dispatch_table[i].vehicle_decoder = NULL;
+
+  oscc_vehicle_state_init(oscc_get_vehicle());
+
+  global_dispatch_table[OSCC_BRAKE_REPORT_CAN_ID].decoder = decode_brake_report;
+  global_dispatch_table[OSCC_THROTTLE_REPORT_CAN_ID].decoder = decode_throttle_report;
+  global_dispatch_table[OSCC_STEERING_REPORT_CAN_ID].decoder = decode_steering_report;
+  global_dispatch_table[OSCC_FAULT_REPORT_CAN_ID].decoder = decode_fault_report;
+}
+
+void oscc_dispatch_set_vehicle_decoder(canid_t can_id, vehicle_frame_decoder_t decoder)
+{
+  if (can_id <= CAN_SFF_MASK)
+    global_dispatch_table[can_id].vehicle_decoder = decoder;
+}
+
+static void notify_can_id_subscribers(dispatch_entry_s* entry,
+                                      struct canfd_frame* frame,
+                                      oscc_frame_meta_s const* meta)
+{
+  int link = entry->subscribers.load(std::memory_order_acquire);
+
+  while (link != OSCC_DISPATCH_END_OF_LIST)
+  {
+    can_id_subscriber_node_s* node = &global_subscriber_nodes[link-1];
+    oscc_subscriber_fn_t handler = NULL;
+    void* user_data = NULL;
+
+    if (oscc_subscriber_slot_read(&node->slot, &handler, &user_data))
+      reinterpret_cast<can_id_handler_t>(handler)(frame, meta, user_data);
+
+    link = node->next;
+  }
+}
+
+void oscc_dispatch_frame(struct canfd_frame* frame,
+                         oscc_frame_meta_s const* meta,
+                         unsigned int flags)
+{
+  bool is_report = false;
+
+  // Extended IDs have no table entry and can only be OBD frames
+  if ((frame->can_id & CAN_EFF_FLAG) == 0)
+  {
+    dispatch_entry_s* entry = &global_dispatch_table[frame->can_id & CAN_SFF_MASK];
+
+    if ((flags & OSCC_DISPATCH_REPORTS) && entry->decoder != NULL)
+      is_report = entry->decoder(frame, meta);
+
+    // Subscribers read the state the frame has already updated
+    if (!is_report && (flags & OSCC_DISPATCH_OBD) && entry->vehicle_decoder != NULL)
+      entry->vehicle_decoder(frame, meta);
+
+    if (is_report || (flags & OSCC_DISPATCH_OBD))
+      notify_can_id_subscribers(entry, frame, meta);
+  }
+
+  if (!is_report && (flags & OSCC_DISPATCH_OBD))
+    oscc_notify_obd_frame(frame, meta);
+}
+
+oscc_subscription_t oscc_add_can_id_subscriber(
+  unsigned int can_id,
+  void(*handler)(struct canfd_frame* frame, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  if (handler==NULL || can_id>CAN_SFF_MASK)
+    return OSCC_INVALID_SUBSCRIPTION;
+
+  dispatch_entry_s* entry = &global_dispatch_table[can_id];
+  oscc_subscriber_fn_t generic_handler = reinterpret_cast<oscc_subscriber_fn_t>(handler);
+
+  // Reuse a node left empty by an earlier subscriber to this ID
+  for (int link = entry->subscribers.load(std::memory_order_acquire);
+       link != OSCC_DISPATCH_END_OF_LIST;
+       link = global_subscriber_nodes[link-1].next)
+  {
+    uint32_t generation = oscc_subscriber_slot_claim(&global_subscriber_nodes[link-1].slot,
+                                                     generic_handler,
+                                                     user_data);
+    if (generation != 0)
+      return oscc_make_subscription(OSCC_SUBSCRIBER_CAN_ID, link-1, generation);
+  }
+
+  int node = global_subscriber_node_count.fetch_add(1, std::memory_order_acq_rel);
+  if (node >= OSCC_MAX_CAN_ID_SUBSCRIBERS)
+  {
+    global_subscriber_node_count.store(OSCC_MAX_CAN_ID_SUBSCRIBERS, std::memory_order_release);
+    printf("Error: No free CAN ID subscriber left\n");
+    return OSCC_INVALID_SUBSCRIPTION;
+  }
+
+  uint32_t generation = oscc_subscriber_slot_claim(&global_subscriber_nodes[node].slot,
+                                                   generic_handler,
+                                                   user_data);
+
+  // Push the filled node onto the entry's list; dispatch sees it complete
+  int head = entry->subscribers.load(std::memory_order_relaxed);
+  do
+  {
+    global_subscriber_nodes[node].next = head;
+  } while (!entry->subscribers.compare_exchange_weak(head,
+                                                     node+1,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed));
+
+  // Make sure the kernel filter lets the ID through
+  oscc_add_obd_can_filter(can_id, OSCC_CAN_ID_EXACT_MASK);
+
+  return oscc_make_subscription(OSCC_SUBSCRIBER_CAN_ID, node, generation);
+}
+
+oscc_result_t oscc_dispatch_remove_subscriber(size_t node_index, uint32_t generation)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (node_index < OSCC_MAX_CAN_ID_SUBSCRIBERS)
+    result = oscc_subscriber_slot_remove(&global_subscriber_nodes[node_index].slot,
+                                         generation);
+
+  return result;
+}
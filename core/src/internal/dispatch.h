@@ -0,0 +1,105 @@
+/**
+ * @file internal/dispatch.h
+ * @brief Internal CAN ID dispatch table.
+ *
+ * Received frames are routed through a table indexed by 11-bit CAN ID. An
+ * entry holds the decoder of an OSCC report, if the ID is one, and the list
+ * of subscribers to that ID, so routing a frame is a single lookup however
+ * many IDs are subscribed to.
+ */
+
+#ifndef _OSCC_INTERNAL_DISPATCH_H_
+#define _OSCC_INTERNAL_DISPATCH_H_
+
+
+#include <atomic>
+#include <linux/can.h>
+#include <stdint.h>
+
+#include "core/include/oscc.h"
+#include "subscribers.h"
+
+/**
+ * @brief Number of dispatch table entries, one per standard (11-bit) CAN ID.
+ */
+#define OSCC_DISPATCH_TABLE_SIZE ( CAN_SFF_MASK + 1 )
+
+/**
+ * @brief Number of per-ID subscriber nodes shared by all table entries.
+ */
+#define OSCC_MAX_CAN_ID_SUBSCRIBERS 64
+
+/**
+ * @brief Marks the end of a per-ID subscriber list. Lists link nodes by pool
+ *        index plus one, so a zeroed table entry is an empty list.
+ */
+#define OSCC_DISPATCH_END_OF_LIST ( 0 )
+
+/**
+ * @brief Dispatch flags describing what a frame may be delivered as.
+ */
+enum
+{
+  OSCC_DISPATCH_REPORTS = 1 << 0, /*!< Decode OSCC reports. */
+  OSCC_DISPATCH_OBD = 1 << 1 /*!< Deliver frames that are not reports as OBD. */
+};
+
+/**
+ * @brief Decodes a frame and notifies its subscribers. Returns false if the
+ *        frame is not what the ID is registered for, e.g. lacks OSCC magic.
+ */
+typedef bool (*can_frame_decoder_t)(struct canfd_frame* frame, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Decodes a vehicle OBD frame of the selected vehicle into the
+ *        vehicle state before its subscribers run.
+ */
+typedef void (*vehicle_frame_decoder_t)(struct canfd_frame const* frame, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Per-ID subscriber, taken from the node pool and linked into the list
+ *        of its table entry. Nodes are never unlinked; a removed subscriber
+ *        leaves an empty slot that the next subscriber to the same ID reuses.
+ */
+typedef struct
+{
+  subscriber_slot_s slot;
+  int next; /*!< Link to the next node of the list. */
+} can_id_subscriber_node_s;
+
+typedef struct
+{
+  can_frame_decoder_t decoder;
+  vehicle_frame_decoder_t vehicle_decoder;
+  std::atomic<int> subscribers; /*!< Link to the first node of the list. */
+} dispatch_entry_s;
+
+/**
+ * @brief Installs the OSCC report decoders and the vehicle frame decoders of
+ *        the selected vehicle. Safe to call more than once, but not while
+ *        frames are dispatched.
+ */
+void oscc_dispatch_init();
+
+/**
+ * @brief Sets the vehicle frame decoder of a standard CAN ID. IDs outside
+ *        the table are ignored.
+ */
+void oscc_dispatch_set_vehicle_decoder(canid_t can_id, vehicle_frame_decoder_t decoder);
+
+/**
+ * @brief Routes a received frame to its decoder and subscribers.
+ *
+ * @param [in] flags - \ref OSCC_DISPATCH_REPORTS and/or \ref OSCC_DISPATCH_OBD
+ */
+void oscc_dispatch_frame(struct canfd_frame* frame,
+                         oscc_frame_meta_s const* meta,
+                         unsigned int flags);
+
+/**
+ * @brief Removes a per-ID subscriber if its node still holds the generation.
+ */
+oscc_result_t oscc_dispatch_remove_subscriber(size_t node_index, uint32_t generation);
+
+
+#endif // _OSCC_INTERNAL_DISPATCH_H_
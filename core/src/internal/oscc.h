@@ -7,11 +7,76 @@
 #define _OSCC_INTERNAL_H_
 
 
+#include <atomic>
+#include <linux/can/bcm.h>
+#include <linux/can/netlink.h>
 #include <net/if.h>
+#include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "core/include/recorder.h"
 
 #define UNINITIALIZED_SOCKET -1
 
+/**
+ * @brief Maximum number of CAN frames pulled from a socket per recvmmsg call.
+ */
+#define OSCC_RX_BATCH_SIZE 32
+
+/**
+ * @brief Size of the ancillary data buffer attached to each received frame.
+ */
+#define OSCC_RX_CONTROL_SIZE ( CMSG_SPACE(sizeof(uint32_t)) \
+                               + CMSG_SPACE(sizeof(struct timespec)) )
+
+/**
+ * @brief Maximum number of kernel CAN filters installed on one socket.
+ */
+#define OSCC_MAX_CAN_FILTERS 32
+
+/**
+ * @brief Maximum number of CAN channels sniffed at once during detection.
+ */
+#define OSCC_MAX_DETECTION_CHANNELS 16
+
+/**
+ * @brief Maximum number of CAN links returned by \ref construct_interfaces_list.
+ */
+#define OSCC_MAX_CAN_INTERFACES 32
+
+/**
+ * @brief CAN controller state of links that do not report one, such as vcan.
+ */
+#define OSCC_CAN_STATE_UNKNOWN CAN_STATE_MAX
+
+/**
+ * @brief Maximum number of OBD filters added with \ref oscc_add_obd_can_filter.
+ */
+#define OSCC_MAX_EXTRA_CAN_FILTERS 16
+
+/**
+ * @brief Filter mask matching a single standard frame ID exactly.
+ */
+#define OSCC_CAN_ID_EXACT_MASK ( CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG )
+
+/**
+ * @brief Maximum length of the detection cache file path.
+ */
+#define OSCC_DETECTION_CACHE_PATH_SIZE 256
+
+/**
+ * @brief Maximum length of a CAN interface driver name.
+ */
+#define OSCC_DRIVER_NAME_SIZE 64
+
+/**
+ * @brief Driver name recorded for interfaces without a backing device.
+ */
+#define OSCC_VIRTUAL_DRIVER_NAME "virtual"
+
 #define CONSTRAIN(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
 
 typedef struct {
@@ -23,6 +88,7 @@ typedef struct {
   bool has_steering_angle;
   bool has_brake_pressure;
   bool has_wheel_speed;
+  bool has_vehicle_speed;
 } vehicle_can_desc_s;
 
 typedef struct {
@@ -32,19 +98,116 @@ typedef struct {
 } oscc_can_desc_s;
 
 typedef struct {
-  char** name;
+  char name[IFNAMSIZ];
+  unsigned int ifindex;
+  char driver[OSCC_DRIVER_NAME_SIZE];
+} can_channel_identity_s;
+
+// A BCM message is a bcm_msg_head followed by its frames. The head ends in a
+// flexible array, so the single-frame message is laid out as a union. The
+// same buffer holds a bare (FD) frame for raw socket writes.
+typedef union {
+  struct bcm_msg_head head;
+  uint8_t raw[sizeof(struct bcm_msg_head) + sizeof(struct canfd_frame)];
+} bcm_tx_msg_s;
+
+// Updated by whichever context drains the socket and read by
+// oscc_get_can_stats from the caller's thread
+typedef struct {
+  std::atomic<unsigned long> frames_received;
+  std::atomic<unsigned long> frames_dropped;
+  std::atomic<unsigned long> frames_sent; /*!< Written by this process, whose
+                                           *   echoes the interface counts
+                                           *   as received. */
+  std::atomic<unsigned long long> interface_rx_base;
+} can_socket_stats_s;
+
+typedef struct {
+  unsigned int brake_report;
+  unsigned int steer_report;
+  unsigned int accel_report;
+  unsigned int brake_pressure;
+  unsigned int steering_angle;
+  unsigned int wheel_speed;
+  unsigned int vehicle_speed;
+} can_detection_counts_s;
+
+typedef struct {
+  unsigned int confidence;
+  unsigned int deadline_ms;
+} oscc_detection_config_s;
+
+typedef struct {
+  can_detection_counts_s counts;
+  unsigned int frames_checked;
+  uint64_t last_activity_ns;
+} can_detection_state_s;
+
+typedef struct {
+  char name[IFNAMSIZ];
+  unsigned int ifindex;
+  bool is_up;
+  uint32_t can_state;
+  uint32_t bitrate;
+} can_interface_s;
+
+typedef struct {
+  can_interface_s interfaces[OSCC_MAX_CAN_INTERFACES];
   size_t size;
-} device_names_s;
+} can_interface_list_s;
 
-void (*brake_report_callback) (oscc_brake_report_s* report);
+/**
+ * @brief Number of frames sent by \ref oscc_publish_commands.
+ */
+#define OSCC_COMMAND_FRAME_COUNT 3
 
-void (*steering_report_callback) (oscc_steering_report_s* report);
+void oscc_encode_brake_command(oscc_brake_command_s* brake_cmd, double brake_position);
 
-void (*throttle_report_callback) (oscc_throttle_report_s* report);
+void oscc_encode_throttle_command(oscc_throttle_command_s* throttle_cmd, double throttle_position);
+
+void oscc_encode_steering_command(oscc_steering_command_s* steering_cmd, double torque);
+
+void oscc_encode_packed_command(
+  oscc_packed_command_s* packed_cmd,
+  double brake_position,
+  double throttle_position,
+  double steering_torque
+);
 
-void (*fault_report_callback) (oscc_fault_report_s* report);
+/**
+ * @brief Fill a classic CAN frame with an ID and payload
+ */
+void oscc_build_can_frame(struct can_frame* tx_frame, long id, void* msg, unsigned int dlc);
 
-void (*obd_frame_callback) (struct can_frame* frame);
+/**
+ * @brief Fill a CAN FD frame with an ID and payload, sent with bit rate switch
+ */
+void oscc_build_canfd_frame(struct canfd_frame* tx_frame, long id, void* msg, unsigned int len);
+
+/**
+ * @brief Build a command as a bare frame, or as a BCM TX_SETUP message when
+ * cyclic, using FD frames in FD mode. Returns the number of bytes to write.
+ */
+size_t oscc_build_command_message(
+  bcm_tx_msg_s* tx_msg,
+  bool cyclic,
+  uint32_t bcm_flags,
+  unsigned int period_us,
+  long id,
+  void* msg,
+  unsigned int dlc
+);
+
+/**
+ * @brief Fill a single-frame BCM TX_SETUP header
+ */
+void oscc_build_bcm_tx_head(struct bcm_msg_head* head, uint32_t flags, unsigned int period_us);
+
+/**
+ * @brief Send a command frame, or update the payload of its cyclic BCM job
+ * when \ref oscc_start_cyclic_commands is active
+ */
+oscc_result_t oscc_command_write(long id, void* msg, unsigned int dlc);
 
 /**
  * @brief Write a CAN frame
@@ -55,6 +218,12 @@ oscc_result_t oscc_can_write(
   unsigned int dlc 
 );
 
+/**
+ * @brief Record a frame written to the OSCC CAN, built by
+ * \ref oscc_build_command_message without a BCM head
+ */
+void oscc_record_tx_frame(void const* frame);
+
 oscc_result_t oscc_enable_brakes();
 
 oscc_result_t oscc_enable_steering();
@@ -67,31 +236,86 @@ oscc_result_t oscc_disable_steering();
 
 oscc_result_t oscc_disable_throttle();
 
-void oscc_update_status();
+void oscc_update_status(int sig, siginfo_t* siginfo, void* context);
+
+/**
+ * @brief Points each entry of the preallocated receive batch at its frame.
+ */
+void oscc_init_rx_batch();
+
+/**
+ * @brief Pulls pending frames from a socket in batches of up to
+ * \ref OSCC_RX_BATCH_SIZE per recvmmsg call, records each frame under the
+ * channel role and dispatches it along with the frame's receive metadata.
+ */
+void oscc_drain_can_socket(
+  int socket,
+  oscc_recorder_channel_t channel,
+  void(*dispatch)(struct canfd_frame*, oscc_frame_meta_s const*),
+  can_socket_stats_s* stats
+);
+
+/**
+ * @brief Installs the kernel CAN_RAW_FILTER lists on the open sockets.
+ *
+ * The OSCC socket accepts the module reports, plus the vehicle OBD IDs when
+ * the gateway forwards vehicle CAN. The vehicle socket accepts the vehicle
+ * OBD IDs. Both include any IDs added by \ref oscc_add_obd_can_filter.
+ */
+oscc_result_t oscc_apply_can_filters();
+
+/**
+ * @brief Reads and dispatches every pending frame on the OSCC CAN socket.
+ */
+void oscc_drain_oscc_can();
+
+/**
+ * @brief Reads and dispatches every pending frame on the vehicle CAN socket.
+ */
+void oscc_drain_vehicle_can();
 
 oscc_result_t register_can_signal();
 
+/**
+ * @brief Starts frame reception on the open sockets using the configured
+ * \ref oscc_rx_mode_t.
+ */
+oscc_result_t oscc_start_rx();
+
+/**
+ * @brief Starts the RX thread that waits on both CAN sockets with epoll.
+ */
+oscc_result_t oscc_start_rx_thread();
+
+/**
+ * @brief Stops the RX thread, if running, and releases its descriptors.
+ */
+void oscc_stop_rx_thread();
+
+oscc_result_t oscc_set_nonblocking(int socket);
+
 /**
  * @brief Enables asynchronous callback to each socket and should only be called after
  * all connections are made to prevent interrupts while making new connections.
  */
 oscc_result_t oscc_async_enable(int socket);
 
-// Runs a calback function through all available socketcan signals
+// Detects the contents of all available socketcan channels in parallel, then
+// runs a callback function with each channel and its detected contents
 oscc_result_t oscc_search_can(
-  can_contains_s (*search_callback)(const char*),
+  can_contains_s (*search_callback)(const char*, can_contains_s),
   bool search_oscc 
 );
 
 /**
- * @brief Auto detects OSCC CAN and Vehicle CAN depending on OSCC CAN returned IDs
+ * @brief Initializes OSCC CAN or Vehicle CAN depending on the detected contents
  */
-can_contains_s auto_init_all_can(const char* can_channel);
+can_contains_s auto_init_all_can(const char* can_channel, can_contains_s contents);
 
 /**
- * @brief Auto detects Vehicle CAN based on vehicle header CAN IDs
+ * @brief Initializes Vehicle CAN if the selected vehicle's CAN IDs were detected
  */
-can_contains_s auto_init_vehicle_can(const char* can_channel);
+can_contains_s auto_init_vehicle_can(const char* can_channel, can_contains_s contents);
 
 /**
  * @brief Initializes the OSCC CAN
@@ -99,7 +323,7 @@ can_contains_s auto_init_vehicle_can(const char* can_channel);
 oscc_result_t init_oscc_can(const char* can_channel);
 
 /**
- * @brief Initializes the vehicle can with vehicle header CAN IDs
+ * @brief Initializes the vehicle can with the selected vehicle's CAN IDs
  */
 oscc_result_t init_vehicle_can(const char * can_channel);
 
@@ -118,16 +342,76 @@ int init_can_socket(const char* can_channel, struct timeval* tv);
 can_contains_s can_detection(const char* can_channel);
 
 /**
- * @brief Constructs a list of all can and vcan devices
+ * @brief Looks up the ifindex and driver of a CAN interface by name.
+ */
+oscc_result_t oscc_channel_identity(
+  const char* can_channel,
+  can_channel_identity_s* identity
+);
+
+/**
+ * @brief Opens the channels saved in the detection cache if they still exist
+ * with the same ifindex and driver and still carry the expected traffic.
  */
-oscc_result_t construct_interfaces_list(device_names_s* const list_ptr);
+oscc_result_t oscc_load_detection_cache();
 
 /**
- * @brief Gets the device name from a line of /proc/net/dev data
+ * @brief Saves the currently open OSCC and vehicle channels to the detection
+ * cache.
  */
-oscc_result_t get_device_name(char* string, char* const name);
+oscc_result_t oscc_save_detection_cache();
 
-oscc_result_t clear_device_names(device_names_s* const names_ptr);
+/**
+ * @brief Determines the contents of several CAN channels at once by sniffing
+ * all of them in a single poll loop, bounded by the configured deadline.
+ *
+ * An ID counts as present once it has been seen `confidence` times. A channel
+ * stops being sniffed once it shows both OSCC and vehicle IDs, and the search
+ * returns as soon as the channels found so far satisfy the optional goal.
+ */
+void can_detection_all(
+  const char* const* can_channels,
+  size_t count,
+  can_contains_s* detections,
+  can_contains_s const* goal,
+  oscc_detection_config_s const* config
+);
+
+/**
+ * @brief Wheel speed batch decoders behind \ref get_wheel_speeds. They stop
+ *        at the first frame whose ID is not the wheel speed CAN ID.
+ *
+ * @return number of frames decoded
+ */
+size_t oscc_decode_wheel_speeds_scalar(
+  struct can_frame const* frames,
+  size_t count,
+  canid_t wheel_speed_can_id,
+  oscc_wheel_speeds_s const* speeds
+);
+
+#if defined(__x86_64__)
+size_t oscc_decode_wheel_speeds_sse2(
+  struct can_frame const* frames,
+  size_t count,
+  canid_t wheel_speed_can_id,
+  oscc_wheel_speeds_s const* speeds
+);
+
+size_t oscc_decode_wheel_speeds_avx(
+  struct can_frame const* frames,
+  size_t count,
+  canid_t wheel_speed_can_id,
+  oscc_wheel_speeds_s const* speeds
+);
+#endif
+
+/**
+ * @brief Lists all CAN links (link type ARPHRD_CAN, which includes vcan) with
+ * an rtnetlink link dump. The bitrate is 0 and the state
+ * \ref OSCC_CAN_STATE_UNKNOWN for links that do not report them.
+ */
+oscc_result_t construct_interfaces_list(can_interface_list_s* const list);
 
 
 #endif // _OSCC_INTERNAL_H_
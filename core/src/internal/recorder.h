@@ -0,0 +1,40 @@
+/**
+ * @file internal/recorder.h
+ * @brief Internal flight recorder hooks.
+ *
+ * The RX path (signal handler or RX thread) records received frames and
+ * oscc_can_write records written frames, possibly at the same time, so
+ * writers reserve their slot atomically. Stopping waits for writers that
+ * are still copying into the mapping before it is unmapped.
+ */
+
+#ifndef _OSCC_INTERNAL_RECORDER_H_
+#define _OSCC_INTERNAL_RECORDER_H_
+
+
+#include <linux/can.h>
+#include <stdint.h>
+
+#include "core/include/recorder.h"
+
+/**
+ * @brief Notes the interface a channel role was opened on, for the header of
+ *        the current and later recordings.
+ */
+void oscc_recorder_set_channel(oscc_recorder_channel_t channel, const char* name);
+
+/**
+ * @brief Appends a frame to the ring if recording. Only reads a flag when not
+ *        recording.
+ *
+ * @param [in] flags - \ref OSCC_RECORDER_FLAG_TX, \ref OSCC_RECORDER_FLAG_FD
+ *
+ * @param [in] timestamp_ns - CLOCK_REALTIME [ns]
+ */
+void oscc_recorder_record(oscc_recorder_channel_t channel,
+                          uint8_t flags,
+                          struct canfd_frame const* frame,
+                          uint64_t timestamp_ns);
+
+
+#endif // _OSCC_INTERNAL_RECORDER_H_
@@ -0,0 +1,148 @@
+/**
+ * @file internal/subscribers.h
+ * @brief Internal subscriber registry.
+ *
+ * Every report type owns a fixed array of subscriber slots. Subscribing and
+ * unsubscribing rewrite a slot under a per-slot sequence counter, so the RX
+ * path (signal handler or RX thread) reads slots without locks and without
+ * allocating, and skips a slot that is being rewritten.
+ */
+
+#ifndef _OSCC_INTERNAL_SUBSCRIBERS_H_
+#define _OSCC_INTERNAL_SUBSCRIBERS_H_
+
+
+#include <atomic>
+#include <stdint.h>
+
+#include "core/include/oscc.h"
+
+/**
+ * @brief Number of subscriber slots per report type, reserved slots included.
+ */
+#define OSCC_MAX_SUBSCRIBERS 16
+
+/**
+ * @brief Slots kept for the single-callback oscc_subscribe_to_* functions,
+ *        which replace their previous callback instead of adding one.
+ */
+enum
+{
+  OSCC_LEGACY_SLOT = 0,
+  OSCC_LEGACY_META_SLOT,
+  OSCC_LEGACY_FD_SLOT,
+  OSCC_RESERVED_SLOT_COUNT
+};
+
+/**
+ * @brief Report types with their own subscriber list.
+ */
+typedef enum
+{
+  OSCC_SUBSCRIBER_BRAKE_REPORT,
+  OSCC_SUBSCRIBER_THROTTLE_REPORT,
+  OSCC_SUBSCRIBER_STEERING_REPORT,
+  OSCC_SUBSCRIBER_FAULT_REPORT,
+  OSCC_SUBSCRIBER_OBD_FRAME,
+  OSCC_SUBSCRIBER_TYPE_COUNT,
+  /* Per-ID subscribers live in the dispatch table, not in a list */
+  OSCC_SUBSCRIBER_CAN_ID = OSCC_SUBSCRIBER_TYPE_COUNT
+} oscc_subscriber_type_t;
+
+/**
+ * @brief Type-erased handler; cast back to the list's handler type to call.
+ */
+typedef void (*oscc_subscriber_fn_t)(void);
+
+/**
+ * @brief One subscriber. The sequence is odd while the slot is rewritten and
+ *        half of it is the slot generation encoded in subscription handles.
+ */
+typedef struct
+{
+  std::atomic<uint32_t> sequence;
+  std::atomic<oscc_subscriber_fn_t> handler;
+  std::atomic<void*> user_data;
+} subscriber_slot_s;
+
+typedef struct
+{
+  subscriber_slot_s slots[OSCC_MAX_SUBSCRIBERS];
+  std::atomic<uint32_t> slots_used; /*!< One past the highest slot ever
+                                     *   filled; dispatch stops there. */
+} subscriber_list_s;
+
+/**
+ * @brief Packs a list or pool index and slot generation into a handle.
+ */
+oscc_subscription_t oscc_make_subscription(
+  oscc_subscriber_type_t type,
+  size_t slot_index,
+  uint32_t generation
+);
+
+/**
+ * @brief Stores the handler in the slot if it is empty. Returns the new slot
+ *        generation, or 0 if the slot is taken.
+ */
+uint32_t oscc_subscriber_slot_claim(
+  subscriber_slot_s* slot,
+  oscc_subscriber_fn_t handler,
+  void* user_data
+);
+
+/**
+ * @brief Replaces the handler of a slot, or clears it when handler is NULL.
+ *        Returns the new slot generation, or 0 if another writer kept the
+ *        slot for every retry.
+ */
+uint32_t oscc_subscriber_slot_set(
+  subscriber_slot_s* slot,
+  oscc_subscriber_fn_t handler,
+  void* user_data
+);
+
+/**
+ * @brief Clears a slot if it still holds the given generation.
+ */
+oscc_result_t oscc_subscriber_slot_remove(subscriber_slot_s* slot, uint32_t generation);
+
+/**
+ * @brief Reads a consistent handler and user data pair from a slot, retrying
+ *        a few times if it is being rewritten. Returns false if the slot is
+ *        empty or the rewrite outlasted the retries, in which case that
+ *        subscriber misses the frame being dispatched.
+ */
+bool oscc_subscriber_slot_read(
+  subscriber_slot_s* slot,
+  oscc_subscriber_fn_t* handler,
+  void** user_data
+);
+
+/**
+ * @brief Calls every brake report subscriber.
+ */
+void oscc_notify_brake_report(oscc_brake_report_s* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Calls every throttle report subscriber.
+ */
+void oscc_notify_throttle_report(oscc_throttle_report_s* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Calls every steering report subscriber.
+ */
+void oscc_notify_steering_report(oscc_steering_report_s* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Calls every fault report subscriber.
+ */
+void oscc_notify_fault_report(oscc_fault_report_s* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Calls every OBD frame subscriber.
+ */
+void oscc_notify_obd_frame(struct canfd_frame* frame, oscc_frame_meta_s const* meta);
+
+
+#endif // _OSCC_INTERNAL_SUBSCRIBERS_H_
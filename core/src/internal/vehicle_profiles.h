@@ -0,0 +1,212 @@
+/**
+ * @file internal/vehicle_profiles.h
+ * @brief Internal vehicle profiles.
+ *
+ * Every supported vehicle has a constexpr profile with the CAN IDs, payload
+ * offsets and scalars of its OBD frames, mirroring the vehicle headers in
+ * core/include/vehicles. The decoders are templates on the vehicle, so each
+ * instantiation folds its profile into constants, and the selected vehicle
+ * picks one instantiation through a function table.
+ */
+
+#ifndef _OSCC_INTERNAL_VEHICLE_PROFILES_H_
+#define _OSCC_INTERNAL_VEHICLE_PROFILES_H_
+
+
+#include <linux/can.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/include/oscc.h"
+
+/**
+ * @brief CAN ID of a frame the vehicle does not send. No received data frame
+ *        carries the error flag.
+ */
+#define OSCC_VEHICLE_NO_CAN_ID ( CAN_ERR_FLAG )
+
+typedef struct
+{
+  const char* name; /*!< Name accepted by oscc_select_vehicle_by_name. */
+
+  canid_t steering_wheel_angle_can_id;
+  canid_t wheel_speed_can_id;
+  canid_t brake_pressure_can_id;
+  canid_t speed_can_id; /*!< \ref OSCC_VEHICLE_NO_CAN_ID if not sent. */
+  canid_t throttle_pressure_can_id; /*!< \ref OSCC_VEHICLE_NO_CAN_ID if not sent. */
+
+  double steering_angle_scalar; /*!< Raw steering wheel angle to degrees. */
+
+  size_t brake_pressure_offset; /*!< First byte of the 12-bit brake pressure. */
+  double brake_pressure_scale; /*!< Raw brake pressure per bar. */
+
+  size_t speed_offset; /*!< First byte of the signed 16-bit vehicle speed. */
+  double speed_scalar; /*!< Raw vehicle speed to kph. */
+} oscc_vehicle_profile_s;
+
+constexpr oscc_vehicle_profile_s oscc_vehicle_profiles[OSCC_VEHICLE_COUNT] =
+{
+  // vehicles/kia_soul_petrol.h
+  {
+    .name = "kia_soul_petrol",
+    .steering_wheel_angle_can_id = 0x2B0,
+    .wheel_speed_can_id = 0x4B0,
+    .brake_pressure_can_id = 0x220,
+    .speed_can_id = OSCC_VEHICLE_NO_CAN_ID,
+    .throttle_pressure_can_id = OSCC_VEHICLE_NO_CAN_ID,
+    .steering_angle_scalar = 0.1,
+    .brake_pressure_offset = 4,
+    .brake_pressure_scale = 10.0,
+    .speed_offset = 0,
+    .speed_scalar = 0.0
+  },
+
+  // vehicles/kia_soul_ev.h
+  {
+    .name = "kia_soul_ev",
+    .steering_wheel_angle_can_id = 0x2B0,
+    .wheel_speed_can_id = 0x4B0,
+    .brake_pressure_can_id = 0x220,
+    .speed_can_id = 0x524,
+    .throttle_pressure_can_id = 0x200,
+    .steering_angle_scalar = 0.1,
+    .brake_pressure_offset = 4,
+    .brake_pressure_scale = 10.0,
+    // The header defines no speed payload of its own; the ID was added
+    // alongside the Niro's and uses the layout of kia_soul_obd_speed_data_s
+    .speed_offset = 3,
+    .speed_scalar = 1.0
+  },
+
+  // vehicles/kia_niro.h
+  {
+    .name = "kia_niro",
+    .steering_wheel_angle_can_id = 0x2B0,
+    .wheel_speed_can_id = 0x386,
+    .brake_pressure_can_id = 0x220,
+    .speed_can_id = 0x371,
+    .throttle_pressure_can_id = OSCC_VEHICLE_NO_CAN_ID,
+    .steering_angle_scalar = 0.1,
+    .brake_pressure_offset = 3,
+    .brake_pressure_scale = 40.0,
+    // kia_soul_obd_speed_data_s
+    .speed_offset = 3,
+    .speed_scalar = 1.0
+  }
+};
+
+/**
+ * @brief Scales a raw 12-bit wheel speed to kph with 0.1 kph precision.
+ *        Every wheel speed decoder must produce exactly this value.
+ */
+static inline double oscc_wheel_speed_from_raw(uint16_t raw)
+{
+  return (double)((int)((double)raw / 3.2) / 10.0);
+}
+
+/**
+ * @brief OBD decoders of one vehicle, with its profile as constants.
+ */
+template <oscc_vehicle_t vehicle>
+struct oscc_vehicle_decoder
+{
+  static constexpr oscc_vehicle_profile_s const& profile = oscc_vehicle_profiles[vehicle];
+
+  static oscc_result_t wheel_speed(struct can_frame const* frame, double* wheel_speed, size_t offset)
+  {
+    if (frame==NULL || wheel_speed==NULL || frame->can_id!=profile.wheel_speed_can_id)
+      return OSCC_ERROR;
+
+    uint16_t raw = ((frame->data[offset + 1] & 0x0F) << 8) | frame->data[offset];
+
+    // 10^-1 precision, raw / 32.0
+    *wheel_speed = oscc_wheel_speed_from_raw(raw);
+
+    return OSCC_OK;
+  }
+
+  static oscc_result_t steering_wheel_angle(struct can_frame const* frame, double* steering_wheel_angle)
+  {
+    if (frame==NULL || steering_wheel_angle==NULL
+        || frame->can_id!=profile.steering_wheel_angle_can_id)
+      return OSCC_ERROR;
+
+    int16_t raw = (frame->data[1] << 8) | frame->data[0];
+
+    *steering_wheel_angle = -((double)raw * profile.steering_angle_scalar);
+
+    return OSCC_OK;
+  }
+
+  static oscc_result_t brake_pressure(struct can_frame const* frame, double* brake_pressure)
+  {
+    if (frame==NULL || brake_pressure==NULL || frame->can_id!=profile.brake_pressure_can_id)
+      return OSCC_ERROR;
+
+    constexpr size_t offset = profile.brake_pressure_offset;
+    uint16_t raw = ((frame->data[offset + 1] & 0x0F) << 8) | frame->data[offset];
+
+    *brake_pressure = (double)raw / profile.brake_pressure_scale;
+
+    return OSCC_OK;
+  }
+
+  static oscc_result_t vehicle_speed(struct can_frame const* frame, double* vehicle_speed)
+  {
+    if (profile.speed_can_id==OSCC_VEHICLE_NO_CAN_ID
+        || frame==NULL || vehicle_speed==NULL || frame->can_id!=profile.speed_can_id)
+      return OSCC_ERROR;
+
+    // Assembled byte by byte, so it does not depend on host byte order or
+    // on the alignment of the unaligned payload word
+    constexpr size_t offset = profile.speed_offset;
+    int16_t raw = (frame->data[offset + 1] << 8) | frame->data[offset];
+
+    *vehicle_speed = (double)raw * profile.speed_scalar;
+
+    return OSCC_OK;
+  }
+};
+
+/**
+ * @brief Decoder instantiations of one vehicle.
+ */
+typedef struct
+{
+  oscc_result_t (*wheel_speed)(struct can_frame const*, double*, size_t);
+  oscc_result_t (*steering_wheel_angle)(struct can_frame const*, double*);
+  oscc_result_t (*brake_pressure)(struct can_frame const*, double*);
+  oscc_result_t (*vehicle_speed)(struct can_frame const*, double*);
+} oscc_vehicle_decoders_s;
+
+template <oscc_vehicle_t vehicle>
+constexpr oscc_vehicle_decoders_s oscc_make_vehicle_decoders()
+{
+  return
+  {
+    oscc_vehicle_decoder<vehicle>::wheel_speed,
+    oscc_vehicle_decoder<vehicle>::steering_wheel_angle,
+    oscc_vehicle_decoder<vehicle>::brake_pressure,
+    oscc_vehicle_decoder<vehicle>::vehicle_speed
+  };
+}
+
+constexpr oscc_vehicle_decoders_s oscc_vehicle_decoders[OSCC_VEHICLE_COUNT] =
+{
+  oscc_make_vehicle_decoders<OSCC_VEHICLE_KIA_SOUL_PETROL>(),
+  oscc_make_vehicle_decoders<OSCC_VEHICLE_KIA_SOUL_EV>(),
+  oscc_make_vehicle_decoders<OSCC_VEHICLE_KIA_NIRO>()
+};
+
+/**
+ * @brief Profile of the vehicle selected with \ref oscc_select_vehicle.
+ */
+oscc_vehicle_profile_s const* oscc_vehicle_profile();
+
+/**
+ * @brief Decoders of the vehicle selected with \ref oscc_select_vehicle.
+ */
+oscc_vehicle_decoders_s const* oscc_selected_vehicle_decoders();
+
+
+#endif // _OSCC_INTERNAL_VEHICLE_PROFILES_H_
@@ -0,0 +1,46 @@
+/**
+ * @file internal/vehicle_state.h
+ * @brief Internal vehicle state store updates.
+ *
+ * Only the receive path updates the store, from the signal handler or the RX
+ * thread, which never run at the same time, so there is a single writer.
+ */
+
+#ifndef _OSCC_INTERNAL_VEHICLE_STATE_H_
+#define _OSCC_INTERNAL_VEHICLE_STATE_H_
+
+
+#include <linux/can.h>
+
+#include "core/include/oscc.h"
+#include "core/include/vehicle_state.h"
+
+/**
+ * @brief Installs the decoders of the vehicle's OBD frames, which update the
+ *        store, in the dispatch table.
+ */
+void oscc_vehicle_state_init(oscc_vehicle_t vehicle);
+
+/**
+ * @brief Stores the module state of a brake report.
+ */
+void oscc_vehicle_state_update_brake(oscc_brake_report_s const* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Stores the module state of a throttle report.
+ */
+void oscc_vehicle_state_update_throttle(oscc_throttle_report_s const* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Stores the module state of a steering report.
+ */
+void oscc_vehicle_state_update_steering(oscc_steering_report_s const* report, oscc_frame_meta_s const* meta);
+
+/**
+ * @brief Marks the module a fault report comes from as disabled with the
+ *        reported DTCs.
+ */
+void oscc_vehicle_state_update_fault(oscc_fault_report_s const* report, oscc_frame_meta_s const* meta);
+
+
+#endif // _OSCC_INTERNAL_VEHICLE_STATE_H_
@@ -1,8 +1,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/can.h>
+#include <linux/can/bcm.h>
+#include <linux/can/netlink.h>
 #include <linux/can/raw.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <net/if.h>
+#include <net/if_arp.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -11,37 +16,90 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <poll.h>
+#include <pthread.h>
 
 #include "core/include/oscc.h"
+#include "internal/dispatch.h"
 #include "internal/oscc.h"
+#include "internal/recorder.h"
+#include "internal/vehicle_profiles.h"
 
 #define UNUSED(x) (void)(x)
 
 static int global_oscc_can_socket = UNINITIALIZED_SOCKET;
 static int global_vehicle_can_socket = UNINITIALIZED_SOCKET;
+static char global_oscc_can_channel[IFNAMSIZ];
+static char global_vehicle_can_channel[IFNAMSIZ];
+static can_socket_stats_s global_oscc_can_stats;
+static can_socket_stats_s global_vehicle_can_stats;
+
+// Extra OBD IDs requested through oscc_add_obd_can_filter
+static struct can_filter global_obd_filters[OSCC_MAX_EXTRA_CAN_FILTERS];
+static size_t global_obd_filter_count = 0;
+
+static oscc_rx_mode_t global_rx_mode = OSCC_RX_MODE_SIGNAL;
+static pthread_t global_rx_thread;
+static bool global_rx_thread_running = false;
+static int global_rx_epoll_fd = UNINITIALIZED_SOCKET;
+static int global_rx_stop_fd = UNINITIALIZED_SOCKET;
+
+static oscc_detection_config_s global_detection_config =
+{
+  .confidence = 1,
+  .deadline_ms = CAN_DETECTION_DEADLINE
+};
+
+// Vehicle whose OBD frames are detected, filtered and decoded
+static oscc_vehicle_t global_vehicle = OSCC_VEHICLE_KIA_NIRO;
+
+// CAN FD reception and transmission, and packed FD commands
+static bool global_can_fd = false;
+static bool global_packed_commands = false;
+
+// Detection cache file, empty when the cache is disabled
+static char global_detection_cache_path[OSCC_DETECTION_CACHE_PATH_SIZE];
+
+// CAN_BCM socket owning the cyclic command TX jobs, when enabled
+static int global_bcm_socket = UNINITIALIZED_SOCKET;
+
+// Preallocated receive batch shared by both drain loops. The loops never run
+// concurrently: either the SIGIO handler or the RX thread owns reception.
+static struct canfd_frame global_rx_frames[OSCC_RX_BATCH_SIZE];
+static struct iovec global_rx_iovecs[OSCC_RX_BATCH_SIZE];
+static struct mmsghdr global_rx_msgs[OSCC_RX_BATCH_SIZE];
+static char global_rx_control[OSCC_RX_BATCH_SIZE][OSCC_RX_CONTROL_SIZE];
+static struct sockaddr_can global_rx_addresses[OSCC_RX_BATCH_SIZE];
 
 oscc_result_t oscc_init()
 {
   oscc_result_t result = OSCC_ERROR;
-  result = oscc_search_can( &auto_init_all_can, true);
 
-  if (result == OSCC_OK)
-    result = register_can_signal();
+  // A warm restart reuses the last assignment if it still holds
+  result = oscc_load_detection_cache();
+
+  if (result != OSCC_OK)
+  {
+    result = oscc_search_can( &auto_init_all_can, true);
 
-  if (result==OSCC_OK && global_oscc_can_socket>0)
-    result = oscc_async_enable(global_oscc_can_socket);
+    if (result==OSCC_OK && global_oscc_can_socket>=0)
+      oscc_save_detection_cache();
+  }
+
+  if (result==OSCC_OK && global_oscc_can_socket>=0)
+    result = oscc_start_rx();
   else
   {
     printf("Error: Could not find OSCC CAN signal\n");
     result = OSCC_ERROR;
   }
 
-  if (result==OSCC_OK && global_vehicle_can_socket>0)
-    oscc_async_enable(global_vehicle_can_socket);
-
   return result;
 }
 
@@ -65,17 +123,12 @@ oscc_result_t oscc_open(unsigned int channel)
   }
 
   result = init_oscc_can(can_string_buffer);
-  if (result == OSCC_OK)
-    result = register_can_signal();
 
   if (result==OSCC_OK && global_oscc_can_socket>=0)
-    result = oscc_async_enable(global_oscc_can_socket);
+    result = oscc_start_rx();
   else
     printf("Error: Could not find OSCC CAN signal.\n");
 
-  if (result==OSCC_OK && global_vehicle_can_socket>=0)
-    oscc_async_enable(global_vehicle_can_socket);
-
   return result;
 }
 
@@ -84,6 +137,12 @@ oscc_result_t oscc_close(unsigned int channel)
   bool closed_channel = false;
   bool close_errored = false;
 
+  // The RX thread must not be draining a socket while it is closed
+  oscc_stop_rx_thread();
+
+  if (global_bcm_socket >= 0)
+    oscc_stop_cyclic_commands();
+
   if (global_oscc_can_socket >= 0)
   {
     int result = close(global_oscc_can_socket);
@@ -91,6 +150,7 @@ oscc_result_t oscc_close(unsigned int channel)
       closed_channel = true;
     else
       close_errored = true;
+    global_oscc_can_socket = UNINITIALIZED_SOCKET;
   }
 
   if (global_vehicle_can_socket >= 0)
@@ -100,6 +160,7 @@ oscc_result_t oscc_close(unsigned int channel)
       closed_channel = true;
     else
       close_errored = true;
+    global_vehicle_can_socket = UNINITIALIZED_SOCKET;
   }
 
   if (closed_channel==true && close_errored==false)
@@ -108,126 +169,284 @@ oscc_result_t oscc_close(unsigned int channel)
     return OSCC_ERROR;
 }
 
-oscc_result_t oscc_enable(void)
+oscc_result_t oscc_set_rx_mode(oscc_rx_mode_t mode)
 {
   oscc_result_t result = OSCC_ERROR;
-  result = oscc_enable_brakes( );
-  if (result == OSCC_OK)
+
+  // The mode can only be switched while no channel is open
+  if (global_oscc_can_socket<0 && !global_rx_thread_running)
   {
-    result = oscc_enable_throttle( );
-    if (result == OSCC_OK )
-      result = oscc_enable_steering( );
+    if (mode==OSCC_RX_MODE_SIGNAL || mode==OSCC_RX_MODE_THREAD)
+    {
+      global_rx_mode = mode;
+      result = OSCC_OK;
+    }
   }
+
   return result;
 }
 
-oscc_result_t oscc_disable()
+oscc_result_t oscc_select_vehicle(oscc_vehicle_t vehicle)
 {
   oscc_result_t result = OSCC_ERROR;
-  result = oscc_disable_brakes();
-  if (result == OSCC_OK)
+
+  // Detection, filters and dispatch are set up for the vehicle when a
+  // channel is opened
+  if (global_oscc_can_socket<0 && global_vehicle_can_socket<0)
   {
-    result = oscc_disable_throttle();
-    if (result == OSCC_OK)
-      result = oscc_disable_steering( );
+    if (vehicle>=0 && vehicle<OSCC_VEHICLE_COUNT)
+    {
+      global_vehicle = vehicle;
+      result = OSCC_OK;
+    }
   }
+
   return result;
 }
 
-oscc_result_t oscc_publish_brake_position(double brake_position)
+oscc_result_t oscc_select_vehicle_by_name(const char* name)
 {
   oscc_result_t result = OSCC_ERROR;
-  oscc_brake_command_s brake_cmd;
-  brake_cmd.magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0); 
-  brake_cmd.magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1); 
-  brake_cmd.pedal_command = static_cast<float>(brake_position);
-  result = oscc_can_write(OSCC_BRAKE_COMMAND_CAN_ID, 
-                          (void*)& brake_cmd, 
-                          sizeof(brake_cmd)          );
+
+  for (int vehicle=0; name!=NULL && vehicle<OSCC_VEHICLE_COUNT; ++vehicle)
+  {
+    if (strcmp(name, oscc_vehicle_profiles[vehicle].name) == 0)
+      result = oscc_select_vehicle((oscc_vehicle_t) vehicle);
+  }
+
+  if (result != OSCC_OK)
+    printf("Error: Could not select vehicle %s\n", name != NULL ? name : "(null)");
+
   return result;
 }
 
-oscc_result_t oscc_publish_throttle_position( double throttle_position )
+oscc_vehicle_t oscc_get_vehicle()
 {
-    oscc_result_t result = OSCC_ERROR;
-    oscc_throttle_command_s throttle_cmd;
-    throttle_cmd.magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
-    throttle_cmd.magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
-    throttle_cmd.torque_request = static_cast<float>(throttle_position);
-    result = oscc_can_write(OSCC_THROTTLE_COMMAND_CAN_ID, 
-                            (void *) &throttle_cmd, 
-                            sizeof(throttle_cmd)          );
-    return result;
+  return global_vehicle;
 }
 
-oscc_result_t oscc_publish_steering_torque(double torque)
+oscc_vehicle_profile_s const* oscc_vehicle_profile()
+{
+  return &oscc_vehicle_profiles[global_vehicle];
+}
+
+oscc_vehicle_decoders_s const* oscc_selected_vehicle_decoders()
+{
+  return &oscc_vehicle_decoders[global_vehicle];
+}
+
+oscc_result_t oscc_set_can_fd(bool enable)
 {
   oscc_result_t result = OSCC_ERROR;
-  oscc_steering_command_s steering_cmd;
-  steering_cmd.magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
-  steering_cmd.magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
-  steering_cmd.torque_command = static_cast<float>(torque);
-  result = oscc_can_write(OSCC_STEERING_COMMAND_CAN_ID, 
-                          (void*) &steering_cmd, 
-                          sizeof(steering_cmd)          );
+
+  // FD frames are enabled per socket when it is opened
+  if (global_oscc_can_socket<0 && global_vehicle_can_socket<0)
+  {
+    global_can_fd = enable;
+    if (!enable)
+      global_packed_commands = false;
+    result = OSCC_OK;
+  }
+
   return result;
 }
 
-oscc_result_t oscc_subscribe_to_brake_reports(void(*callback)(oscc_brake_report_s* report))
+oscc_result_t oscc_set_packed_commands(bool enable)
 {
   oscc_result_t result = OSCC_ERROR;
-  if (callback != NULL)
+
+  // Cyclic jobs are set up for one command layout, so it cannot change under them
+  if ((global_can_fd || !enable) && global_bcm_socket<0)
   {
-    brake_report_callback = callback;
+    global_packed_commands = enable;
     result = OSCC_OK;
   }
+
   return result;
 }
 
-oscc_result_t oscc_subscribe_to_throttle_reports(void(*callback)(oscc_throttle_report_s *report))
+oscc_result_t oscc_set_detection_config(unsigned int confidence, unsigned int deadline_ms)
 {
   oscc_result_t result = OSCC_ERROR;
-  if (callback != NULL)
+
+  if (confidence>0 && deadline_ms>0)
   {
-    throttle_report_callback = callback;
+    global_detection_config.confidence = confidence;
+    global_detection_config.deadline_ms = deadline_ms;
     result = OSCC_OK;
   }
+
   return result;
 }
 
-oscc_result_t oscc_subscribe_to_steering_reports(void(*callback)(oscc_steering_report_s *report))
+oscc_result_t oscc_set_detection_cache(const char* path)
 {
   oscc_result_t result = OSCC_ERROR;
-  if (callback != NULL)
+
+  if (path == NULL)
+  {
+    global_detection_cache_path[0] = '\0';
+    result = OSCC_OK;
+  }
+  else if (strlen(path) < OSCC_DETECTION_CACHE_PATH_SIZE)
   {
-    steering_report_callback = callback;
+    strcpy(global_detection_cache_path, path);
     result = OSCC_OK;
   }
+
   return result;
 }
 
-oscc_result_t oscc_subscribe_to_fault_reports( void (*callback)(oscc_fault_report_s *report))
+oscc_result_t oscc_enable(void)
 {
   oscc_result_t result = OSCC_ERROR;
-  if (callback != NULL)
+  result = oscc_enable_brakes( );
+  if (result == OSCC_OK)
   {
-    fault_report_callback = callback;
-    result = OSCC_OK;
+    result = oscc_enable_throttle( );
+    if (result == OSCC_OK )
+      result = oscc_enable_steering( );
   }
   return result;
 }
 
-oscc_result_t oscc_subscribe_to_obd_messages(void(*callback)(struct can_frame *frame))
+oscc_result_t oscc_disable()
 {
   oscc_result_t result = OSCC_ERROR;
-  if (callback != NULL)
+  result = oscc_disable_brakes();
+  if (result == OSCC_OK)
   {
-    obd_frame_callback = callback;
-    result = OSCC_OK;
+    result = oscc_disable_throttle();
+    if (result == OSCC_OK)
+      result = oscc_disable_steering( );
   }
   return result;
 }
 
+oscc_result_t oscc_publish_brake_position(double brake_position)
+{
+  oscc_result_t result = OSCC_ERROR;
+  oscc_brake_command_s brake_cmd;
+  oscc_encode_brake_command(&brake_cmd, brake_position);
+  result = oscc_command_write(OSCC_BRAKE_COMMAND_CAN_ID, 
+                              (void*)& brake_cmd, 
+                              sizeof(brake_cmd)          );
+  return result;
+}
+
+oscc_result_t oscc_publish_throttle_position( double throttle_position )
+{
+    oscc_result_t result = OSCC_ERROR;
+    oscc_throttle_command_s throttle_cmd;
+    oscc_encode_throttle_command(&throttle_cmd, throttle_position);
+    result = oscc_command_write(OSCC_THROTTLE_COMMAND_CAN_ID, 
+                                (void *) &throttle_cmd, 
+                                sizeof(throttle_cmd)          );
+    return result;
+}
+
+oscc_result_t oscc_publish_steering_torque(double torque)
+{
+  oscc_result_t result = OSCC_ERROR;
+  oscc_steering_command_s steering_cmd;
+  oscc_encode_steering_command(&steering_cmd, torque);
+  result = oscc_command_write(OSCC_STEERING_COMMAND_CAN_ID, 
+                              (void*) &steering_cmd, 
+                              sizeof(steering_cmd)          );
+  return result;
+}
+
+oscc_result_t oscc_publish_commands(double brake_position,
+                                    double throttle_position,
+                                    double steering_torque,
+                                    unsigned int* frames_sent)
+{
+  oscc_result_t result = OSCC_ERROR;
+  int sent = 0;
+
+  // A packed command carries all three commands in one FD frame
+  if (global_oscc_can_socket>=0 && global_packed_commands)
+  {
+    oscc_packed_command_s packed_cmd;
+    oscc_encode_packed_command(&packed_cmd,
+                               brake_position,
+                               throttle_position,
+                               steering_torque   );
+    result = oscc_command_write(OSCC_PACKED_COMMAND_CAN_ID,
+                                &packed_cmd,
+                                sizeof(packed_cmd)        );
+    if (result == OSCC_OK)
+      sent = OSCC_COMMAND_FRAME_COUNT;
+  }
+  else if (global_oscc_can_socket >= 0)
+  {
+    oscc_brake_command_s brake_cmd;
+    oscc_throttle_command_s throttle_cmd;
+    oscc_steering_command_s steering_cmd;
+    oscc_encode_brake_command(&brake_cmd, brake_position);
+    oscc_encode_throttle_command(&throttle_cmd, throttle_position);
+    oscc_encode_steering_command(&steering_cmd, steering_torque);
+
+    // In cyclic mode each message updates the payload of a running BCM job
+    // instead of putting a frame on the bus
+    bcm_tx_msg_s tx_buffers[OSCC_COMMAND_FRAME_COUNT];
+    struct iovec tx_iovecs[OSCC_COMMAND_FRAME_COUNT];
+    struct mmsghdr tx_msgs[OSCC_COMMAND_FRAME_COUNT];
+    bool cyclic = global_bcm_socket >= 0;
+
+    tx_iovecs[0].iov_len = oscc_build_command_message(&tx_buffers[0],
+                                                      cyclic, 0, 0,
+                                                      OSCC_BRAKE_COMMAND_CAN_ID,
+                                                      &brake_cmd,
+                                                      sizeof(brake_cmd)        );
+    tx_iovecs[1].iov_len = oscc_build_command_message(&tx_buffers[1],
+                                                      cyclic, 0, 0,
+                                                      OSCC_THROTTLE_COMMAND_CAN_ID,
+                                                      &throttle_cmd,
+                                                      sizeof(throttle_cmd)        );
+    tx_iovecs[2].iov_len = oscc_build_command_message(&tx_buffers[2],
+                                                      cyclic, 0, 0,
+                                                      OSCC_STEERING_COMMAND_CAN_ID,
+                                                      &steering_cmd,
+                                                      sizeof(steering_cmd)        );
+
+    memset(tx_msgs, 0, sizeof(tx_msgs));
+
+    for (int i=0; i<OSCC_COMMAND_FRAME_COUNT; ++i)
+    {
+      tx_iovecs[i].iov_base = &tx_buffers[i];
+      tx_msgs[i].msg_hdr.msg_iov = &tx_iovecs[i];
+      tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    sent = sendmmsg(cyclic ? global_bcm_socket : global_oscc_can_socket,
+                    tx_msgs,
+                    OSCC_COMMAND_FRAME_COUNT,
+                    0                                                  );
+
+    if (sent == OSCC_COMMAND_FRAME_COUNT)
+      result = OSCC_OK;
+    else if (sent > 0)
+      result = OSCC_WARNING;
+    else
+    {
+      perror("Could not write commands to socket:");
+      sent = 0;
+    }
+
+    // BCM payload updates are not frames on the bus
+    if (!cyclic)
+      global_oscc_can_stats.frames_sent.fetch_add(sent, std::memory_order_relaxed);
+    for (int i=0; !cyclic && i<sent; ++i)
+      oscc_record_tx_frame(tx_buffers[i].raw);
+  }
+
+  if (frames_sent != NULL)
+    *frames_sent = sent;
+
+  return result;
+}
+
 /*****************************************************************************/
 // Internal
 /*****************************************************************************/
@@ -306,64 +525,537 @@ oscc_result_t oscc_disable_steering()
 
 void oscc_update_status(int sig, siginfo_t* siginfo, void* context)
 {
-  struct can_frame rx_frame;
-  memset(&rx_frame, 0, sizeof(rx_frame));
+  UNUSED(sig);
+  UNUSED(siginfo);
+  UNUSED(context);
 
   if (global_oscc_can_socket >= 0)
   {
-    // Read bytes of the first incoming CAN frames
-    int oscc_can_bytes = read(global_oscc_can_socket, &rx_frame, CAN_MTU);
+    oscc_drain_oscc_can();
 
-    while (oscc_can_bytes > 0)
-    {
-      if (rx_frame.data[0]==OSCC_MAGIC_BYTE_0 && rx_frame.data[1]==OSCC_MAGIC_BYTE_1)
-      {
-        if (rx_frame.can_id == OSCC_STEERING_REPORT_CAN_ID)
-        {
-          oscc_steering_report_s* steering_report = (oscc_steering_report_s*) rx_frame.data;
-          if (steering_report_callback != NULL)
-            steering_report_callback(steering_report);
-        }
-        else if (rx_frame.can_id == OSCC_THROTTLE_REPORT_CAN_ID)
-        {
-          oscc_throttle_report_s* throttle_report = (oscc_throttle_report_s*) rx_frame.data;
-          if (throttle_report_callback != NULL)
-            throttle_report_callback(throttle_report);
-        }
-        else if (rx_frame.can_id == OSCC_BRAKE_REPORT_CAN_ID)
-        {
-          oscc_brake_report_s *brake_report = (oscc_brake_report_s*) rx_frame.data;
-          if (brake_report_callback != NULL)
-            brake_report_callback(brake_report);
-        }
-        else if (rx_frame.can_id == OSCC_FAULT_REPORT_CAN_ID)
-        {
-          oscc_fault_report_s* fault_report = (oscc_fault_report_s*) rx_frame.data;
-          if (fault_report_callback != NULL)
-            fault_report_callback(fault_report);
-        }
-      }
-      else
-        if (obd_frame_callback!=NULL && global_vehicle_can_socket<0)
-          obd_frame_callback(&rx_frame);
+    if (global_vehicle_can_socket >= 0)
+      oscc_drain_vehicle_can();
+  }
+}
+
+static void oscc_dispatch_oscc_frame(struct canfd_frame* rx_frame,
+                                     oscc_frame_meta_s const* meta)
+{
+  // Without a vehicle CAN channel the gateway forwards OBD frames to us
+  unsigned int flags = OSCC_DISPATCH_REPORTS;
+  if (global_vehicle_can_socket < 0)
+    flags |= OSCC_DISPATCH_OBD;
 
-      // Read bytes of the next frame
-      oscc_can_bytes = read(global_oscc_can_socket, &rx_frame, CAN_MTU);
+  oscc_dispatch_frame(rx_frame, meta, flags);
+}
+
+static void oscc_dispatch_vehicle_frame(struct canfd_frame* rx_frame,
+                                        oscc_frame_meta_s const* meta)
+{
+  oscc_dispatch_frame(rx_frame, meta, OSCC_DISPATCH_OBD);
+}
+
+void oscc_init_rx_batch()
+{
+  memset(global_rx_frames, 0, sizeof(global_rx_frames));
+  memset(global_rx_msgs, 0, sizeof(global_rx_msgs));
+
+  for (size_t i=0; i<OSCC_RX_BATCH_SIZE; ++i)
+  {
+    global_rx_iovecs[i].iov_base = &global_rx_frames[i];
+    global_rx_iovecs[i].iov_len = sizeof(global_rx_frames[i]);
+    global_rx_msgs[i].msg_hdr.msg_iov = &global_rx_iovecs[i];
+    global_rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    global_rx_msgs[i].msg_hdr.msg_control = global_rx_control[i];
+    global_rx_msgs[i].msg_hdr.msg_controllen = OSCC_RX_CONTROL_SIZE;
+    global_rx_msgs[i].msg_hdr.msg_name = &global_rx_addresses[i];
+    global_rx_msgs[i].msg_hdr.msg_namelen = sizeof(global_rx_addresses[i]);
+  }
+}
+
+static int64_t oscc_timespec_diff_ns(struct timespec const* end,
+                                     struct timespec const* start)
+{
+  return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000LL
+         + (end->tv_nsec - start->tv_nsec);
+}
+
+static void oscc_read_rx_control(struct msghdr* msg,
+                                 can_socket_stats_s* stats,
+                                 oscc_frame_meta_s* meta   )
+{
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+       cmsg != NULL;
+       cmsg = CMSG_NXTHDR(msg, cmsg))
+  {
+    if (cmsg->cmsg_level != SOL_SOCKET)
+      continue;
+
+    if (cmsg->cmsg_type == SO_RXQ_OVFL)
+    {
+      uint32_t dropped = 0;
+      memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+      stats->frames_dropped.store(dropped, std::memory_order_relaxed);
     }
+    else if (cmsg->cmsg_type == SO_TIMESTAMPNS)
+      memcpy(&meta->rx_timestamp, CMSG_DATA(cmsg), sizeof(meta->rx_timestamp));
+  }
+}
 
-    if (global_vehicle_can_socket >= 0)
+void oscc_drain_can_socket(int socket,
+                           oscc_recorder_channel_t channel,
+                           void(*dispatch)(struct canfd_frame*, oscc_frame_meta_s const*),
+                           can_socket_stats_s* stats                                     )
+{
+  int received = 0;
+  oscc_frame_meta_s meta;
+
+  // A short batch means the receive queue is empty, so there is no need to
+  // spend another syscall just to collect EAGAIN.
+  do
+  {
+    for (size_t i=0; i<OSCC_RX_BATCH_SIZE; ++i)
     {
-      int vehicle_can_bytes = read(global_vehicle_can_socket, &rx_frame, CAN_MTU);
+      global_rx_msgs[i].msg_hdr.msg_controllen = OSCC_RX_CONTROL_SIZE;
+      global_rx_msgs[i].msg_hdr.msg_namelen = sizeof(global_rx_addresses[i]);
+    }
 
-      while (vehicle_can_bytes > 0)
-      {
-        if (obd_frame_callback != NULL)
-          obd_frame_callback(&rx_frame);
+    received = recvmmsg(socket, global_rx_msgs, OSCC_RX_BATCH_SIZE, MSG_DONTWAIT, NULL);
 
-        vehicle_can_bytes = read(global_vehicle_can_socket, &rx_frame, CAN_MTU);
+    for (int i=0; i<received; ++i)
+    {
+      // Classic frames arrive as CAN_MTU bytes into the FD sized buffer
+      if (global_rx_msgs[i].msg_len==CAN_MTU || global_rx_msgs[i].msg_len==CANFD_MTU)
+      {
+        memset(&meta, 0, sizeof(meta));
+        oscc_read_rx_control(&global_rx_msgs[i].msg_hdr, stats, &meta);
+        meta.ifindex = global_rx_addresses[i].can_ifindex;
+
+        // The kernel stamps frames with CLOCK_REALTIME, the age is measured
+        // on the same clock right before the callbacks run
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        clock_gettime(CLOCK_MONOTONIC, &meta.dispatch_time);
+        meta.age_ns = oscc_timespec_diff_ns(&now, &meta.rx_timestamp);
+
+        // Recorded before the subscribers, which may modify the frame
+        struct timespec const* stamp = meta.rx_timestamp.tv_sec!=0 ? &meta.rx_timestamp : &now;
+        oscc_recorder_record(channel,
+                             global_rx_msgs[i].msg_len==CANFD_MTU ? OSCC_RECORDER_FLAG_FD : 0,
+                             &global_rx_frames[i],
+                             (uint64_t)stamp->tv_sec * 1000000000ULL + stamp->tv_nsec);
+
+        stats->frames_received.fetch_add(1, std::memory_order_relaxed);
+        dispatch(&global_rx_frames[i], &meta);
       }
     }
+  } while (received == OSCC_RX_BATCH_SIZE);
+}
+
+void oscc_drain_oscc_can()
+{
+  oscc_drain_can_socket(global_oscc_can_socket,
+                        OSCC_RECORDER_CHANNEL_OSCC,
+                        oscc_dispatch_oscc_frame,
+                        &global_oscc_can_stats    );
+}
+
+void oscc_drain_vehicle_can()
+{
+  oscc_drain_can_socket(global_vehicle_can_socket,
+                        OSCC_RECORDER_CHANNEL_VEHICLE,
+                        oscc_dispatch_vehicle_frame,
+                        &global_vehicle_can_stats   );
+}
+
+static size_t oscc_append_filter(struct can_filter* filters,
+                                 size_t count,
+                                 canid_t can_id,
+                                 canid_t can_mask          )
+{
+  if (count < OSCC_MAX_CAN_FILTERS)
+  {
+    filters[count].can_id = can_id;
+    filters[count].can_mask = can_mask;
+    ++count;
+  }
+  return count;
+}
+
+static size_t oscc_append_vehicle_filters(struct can_filter* filters, size_t count)
+{
+  oscc_vehicle_profile_s const* profile = oscc_vehicle_profile();
+
+  count = oscc_append_filter(filters, count, profile->steering_wheel_angle_can_id, OSCC_CAN_ID_EXACT_MASK);
+  count = oscc_append_filter(filters, count, profile->wheel_speed_can_id, OSCC_CAN_ID_EXACT_MASK);
+  count = oscc_append_filter(filters, count, profile->brake_pressure_can_id, OSCC_CAN_ID_EXACT_MASK);
+  if (profile->speed_can_id != OSCC_VEHICLE_NO_CAN_ID)
+    count = oscc_append_filter(filters, count, profile->speed_can_id, OSCC_CAN_ID_EXACT_MASK);
+  if (profile->throttle_pressure_can_id != OSCC_VEHICLE_NO_CAN_ID)
+    count = oscc_append_filter(filters, count, profile->throttle_pressure_can_id, OSCC_CAN_ID_EXACT_MASK);
+
+  for (size_t i=0; i<global_obd_filter_count; ++i)
+    count = oscc_append_filter(filters,
+                               count,
+                               global_obd_filters[i].can_id,
+                               global_obd_filters[i].can_mask);
+
+  return count;
+}
+
+static oscc_result_t oscc_set_can_filters(int socket,
+                                          struct can_filter const* filters,
+                                          size_t count                     )
+{
+  oscc_result_t result = OSCC_ERROR;
+  int ret = setsockopt(socket,
+                       SOL_CAN_RAW,
+                       CAN_RAW_FILTER,
+                       filters,
+                       count * sizeof(struct can_filter));
+  if (ret == 0)
+    result = OSCC_OK;
+  else
+    perror("Setting CAN filters failed:");
+  return result;
+}
+
+static unsigned long long oscc_interface_rx_packets(const char* can_channel)
+{
+  unsigned long long rx_packets = 0;
+  char path[64 + IFNAMSIZ];
+  snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/rx_packets", can_channel);
+
+  FILE* file_handler = fopen(path, "r");
+  if (file_handler != NULL)
+  {
+    if (fscanf(file_handler, "%llu", &rx_packets) != 1)
+      rx_packets = 0;
+    fclose(file_handler);
+  }
+
+  return rx_packets;
+}
+
+oscc_result_t oscc_apply_can_filters()
+{
+  oscc_result_t result = OSCC_OK;
+  struct can_filter filters[OSCC_MAX_CAN_FILTERS];
+  size_t count = 0;
+
+  if (global_oscc_can_socket >= 0)
+  {
+    count = oscc_append_filter(filters, count, OSCC_BRAKE_REPORT_CAN_ID, OSCC_CAN_ID_EXACT_MASK);
+    count = oscc_append_filter(filters, count, OSCC_STEERING_REPORT_CAN_ID, OSCC_CAN_ID_EXACT_MASK);
+    count = oscc_append_filter(filters, count, OSCC_THROTTLE_REPORT_CAN_ID, OSCC_CAN_ID_EXACT_MASK);
+    count = oscc_append_filter(filters, count, OSCC_FAULT_REPORT_CAN_ID, OSCC_CAN_ID_EXACT_MASK);
+
+    // Without a vehicle CAN channel the gateway forwards OBD frames to us
+    if (global_vehicle_can_socket < 0)
+      count = oscc_append_vehicle_filters(filters, count);
+
+    result = oscc_set_can_filters(global_oscc_can_socket, filters, count);
+  }
+
+  if (result==OSCC_OK && global_vehicle_can_socket>=0)
+  {
+    count = oscc_append_vehicle_filters(filters, 0);
+    result = oscc_set_can_filters(global_vehicle_can_socket, filters, count);
+  }
+
+  return result;
+}
+
+oscc_result_t oscc_add_obd_can_filter(unsigned int can_id, unsigned int can_mask)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  // Adding the same filter twice is a no-op
+  for (size_t i=0; i<global_obd_filter_count; ++i)
+  {
+    if (global_obd_filters[i].can_id==can_id && global_obd_filters[i].can_mask==can_mask)
+      return OSCC_OK;
+  }
+
+  if (global_obd_filter_count < OSCC_MAX_EXTRA_CAN_FILTERS)
+  {
+    global_obd_filters[global_obd_filter_count].can_id = can_id;
+    global_obd_filters[global_obd_filter_count].can_mask = can_mask;
+    ++global_obd_filter_count;
+    result = OSCC_OK;
+  }
+
+  if (result==OSCC_OK && global_oscc_can_socket>=0)
+    result = oscc_apply_can_filters();
+
+  return result;
+}
+
+static void oscc_fill_channel_stats(const char* can_channel,
+                                    can_socket_stats_s const* socket_stats,
+                                    oscc_can_channel_stats_s* stats        )
+{
+  stats->frames_received = socket_stats->frames_received.load(std::memory_order_relaxed);
+  stats->frames_dropped = socket_stats->frames_dropped.load(std::memory_order_relaxed);
+
+  // Everything the interface received that neither reached us nor overflowed
+  // our queue was rejected by the kernel filter, except the echoes of the
+  // frames we wrote, which a socket does not receive back
+  unsigned long long seen = oscc_interface_rx_packets(can_channel)
+                            - socket_stats->interface_rx_base.load(std::memory_order_relaxed);
+  unsigned long long delivered = stats->frames_received
+                                 + stats->frames_dropped
+                                 + socket_stats->frames_sent.load(std::memory_order_relaxed);
+  stats->frames_filtered = seen>delivered ? seen-delivered : 0;
+}
+
+oscc_result_t oscc_get_can_stats(oscc_can_stats_s* stats)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (stats != NULL)
+  {
+    memset(stats, 0, sizeof(*stats));
+
+    if (global_oscc_can_socket >= 0)
+      oscc_fill_channel_stats(global_oscc_can_channel, &global_oscc_can_stats, &stats->oscc);
+
+    if (global_vehicle_can_socket >= 0)
+      oscc_fill_channel_stats(global_vehicle_can_channel, &global_vehicle_can_stats, &stats->vehicle);
+
+    result = OSCC_OK;
+  }
+
+  return result;
+}
+
+void oscc_encode_brake_command(oscc_brake_command_s* brake_cmd, double brake_position)
+{
+  memset(brake_cmd, 0, sizeof(*brake_cmd));
+  brake_cmd->magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
+  brake_cmd->magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
+  brake_cmd->pedal_command = static_cast<float>(brake_position);
+}
+
+void oscc_encode_throttle_command(oscc_throttle_command_s* throttle_cmd, double throttle_position)
+{
+  memset(throttle_cmd, 0, sizeof(*throttle_cmd));
+  throttle_cmd->magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
+  throttle_cmd->magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
+  throttle_cmd->torque_request = static_cast<float>(throttle_position);
+}
+
+void oscc_encode_steering_command(oscc_steering_command_s* steering_cmd, double torque)
+{
+  memset(steering_cmd, 0, sizeof(*steering_cmd));
+  steering_cmd->magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
+  steering_cmd->magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
+  steering_cmd->torque_command = static_cast<float>(torque);
+}
+
+void oscc_encode_packed_command(oscc_packed_command_s* packed_cmd,
+                                double brake_position,
+                                double throttle_position,
+                                double steering_torque)
+{
+  memset(packed_cmd, 0, sizeof(*packed_cmd));
+  packed_cmd->magic[0] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_0);
+  packed_cmd->magic[1] = static_cast<uint8_t>(OSCC_MAGIC_BYTE_1);
+  packed_cmd->brake_command = static_cast<float>(brake_position);
+  packed_cmd->throttle_command = static_cast<float>(throttle_position);
+  packed_cmd->steering_command = static_cast<float>(steering_torque);
+}
+
+void oscc_build_can_frame(struct can_frame* tx_frame, long id, void* msg, unsigned int dlc)
+{
+  memset(tx_frame, 0, sizeof(*tx_frame));
+  tx_frame->can_id = id;
+  tx_frame->can_dlc = dlc;
+  memcpy(tx_frame->data, msg, dlc);
+}
+
+void oscc_build_canfd_frame(struct canfd_frame* tx_frame, long id, void* msg, unsigned int len)
+{
+  memset(tx_frame, 0, sizeof(*tx_frame));
+  tx_frame->can_id = id;
+  tx_frame->len = len;
+  tx_frame->flags = CANFD_BRS;
+  memcpy(tx_frame->data, msg, len);
+}
+
+size_t oscc_build_command_message(bcm_tx_msg_s* tx_msg,
+                                  bool cyclic,
+                                  uint32_t bcm_flags,
+                                  unsigned int period_us,
+                                  long id,
+                                  void* msg,
+                                  unsigned int dlc)
+{
+  void* tx_frame = tx_msg->raw;
+  size_t size = 0;
+
+  if (cyclic)
+  {
+    if (global_can_fd)
+      bcm_flags |= CAN_FD_FRAME;
+
+    oscc_build_bcm_tx_head(&tx_msg->head, bcm_flags, period_us);
+    tx_msg->head.can_id = id;
+    tx_frame = &tx_msg->head.frames[0];
+    size = sizeof(tx_msg->head);
   }
+
+  if (global_can_fd)
+  {
+    oscc_build_canfd_frame((struct canfd_frame*) tx_frame, id, msg, dlc);
+    size += CANFD_MTU;
+  }
+  else
+  {
+    oscc_build_can_frame((struct can_frame*) tx_frame, id, msg, dlc);
+    size += CAN_MTU;
+  }
+
+  return size;
+}
+
+void oscc_build_bcm_tx_head(struct bcm_msg_head* head, uint32_t flags, unsigned int period_us)
+{
+  memset(head, 0, sizeof(*head));
+  head->opcode = TX_SETUP;
+  head->flags = flags;
+  head->count = 0;
+  head->ival2.tv_sec = period_us / 1000000;
+  head->ival2.tv_usec = period_us % 1000000;
+  head->nframes = 1;
+}
+
+static oscc_result_t oscc_bcm_tx_setup(long id,
+                                       void* msg,
+                                       unsigned int dlc,
+                                       uint32_t flags,
+                                       unsigned int period_us)
+{
+  oscc_result_t result = OSCC_ERROR;
+  bcm_tx_msg_s bcm_msg;
+  size_t size = oscc_build_command_message(&bcm_msg, true, flags, period_us, id, msg, dlc);
+
+  int ret = write(global_bcm_socket, &bcm_msg, size);
+  if (ret == (int)size)
+    result = OSCC_OK;
+  else
+    perror("Could not write to BCM socket:");
+  return result;
+}
+
+oscc_result_t oscc_command_write(long id, void* msg, unsigned int dlc)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  // Without SETTIMER/STARTTIMER a TX_SETUP only swaps the payload of the job,
+  // so the cadence set up by oscc_start_cyclic_commands is untouched
+  if (global_bcm_socket >= 0)
+    result = oscc_bcm_tx_setup(id, msg, dlc, 0, 0);
+  else
+    result = oscc_can_write(id, msg, dlc);
+
+  return result;
+}
+
+oscc_result_t oscc_start_cyclic_commands(unsigned int period_us)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (global_oscc_can_socket<0 || global_bcm_socket>=0 || period_us==0)
+    return result;
+
+  struct sockaddr_can can_address;
+  memset(&can_address, 0, sizeof(can_address));
+  can_address.can_family = AF_CAN;
+  can_address.can_ifindex = if_nametoindex(global_oscc_can_channel);
+
+  global_bcm_socket = socket(PF_CAN, SOCK_DGRAM, CAN_BCM);
+  if (global_bcm_socket < 0)
+    perror("Opening CAN BCM socket failed:");
+  else if (connect(global_bcm_socket,
+                   (struct sockaddr*) &can_address,
+                   sizeof(can_address)             ) < 0)
+    perror("Connecting CAN BCM socket failed:");
+  else
+    result = OSCC_OK;
+
+  // Start every job with a zero command, the modules ignore it until enabled.
+  // Packed commands need a single job carrying all three.
+  if (result==OSCC_OK && global_packed_commands)
+  {
+    oscc_packed_command_s packed_cmd;
+    oscc_encode_packed_command(&packed_cmd, 0.0, 0.0, 0.0);
+    result = oscc_bcm_tx_setup(OSCC_PACKED_COMMAND_CAN_ID,
+                               &packed_cmd,
+                               sizeof(packed_cmd),
+                               SETTIMER | STARTTIMER,
+                               period_us                );
+
+    if (result != OSCC_OK)
+      oscc_stop_cyclic_commands();
+
+    return result;
+  }
+
+  if (result == OSCC_OK)
+  {
+    oscc_brake_command_s brake_cmd;
+    oscc_encode_brake_command(&brake_cmd, 0.0);
+    result = oscc_bcm_tx_setup(OSCC_BRAKE_COMMAND_CAN_ID,
+                               &brake_cmd,
+                               sizeof(brake_cmd),
+                               SETTIMER | STARTTIMER,
+                               period_us                );
+  }
+
+  if (result == OSCC_OK)
+  {
+    oscc_throttle_command_s throttle_cmd;
+    oscc_encode_throttle_command(&throttle_cmd, 0.0);
+    result = oscc_bcm_tx_setup(OSCC_THROTTLE_COMMAND_CAN_ID,
+                               &throttle_cmd,
+                               sizeof(throttle_cmd),
+                               SETTIMER | STARTTIMER,
+                               period_us                   );
+  }
+
+  if (result == OSCC_OK)
+  {
+    oscc_steering_command_s steering_cmd;
+    oscc_encode_steering_command(&steering_cmd, 0.0);
+    result = oscc_bcm_tx_setup(OSCC_STEERING_COMMAND_CAN_ID,
+                               &steering_cmd,
+                               sizeof(steering_cmd),
+                               SETTIMER | STARTTIMER,
+                               period_us                   );
+  }
+
+  if (result!=OSCC_OK && global_bcm_socket>=0)
+    oscc_stop_cyclic_commands();
+
+  return result;
+}
+
+oscc_result_t oscc_stop_cyclic_commands()
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (global_bcm_socket >= 0)
+  {
+    // Closing the BCM socket deletes all of its TX jobs
+    if (close(global_bcm_socket) == 0)
+      result = OSCC_OK;
+    else
+      perror("Closing CAN BCM socket failed:");
+    global_bcm_socket = UNINITIALIZED_SOCKET;
+  }
+
+  return result;
 }
 
 oscc_result_t oscc_can_write(long id, void* msg, unsigned int dlc)
@@ -371,21 +1063,34 @@ oscc_result_t oscc_can_write(long id, void* msg, unsigned int dlc)
   oscc_result_t result = OSCC_ERROR;
   if (global_oscc_can_socket >= 0)
   {
-    struct can_frame tx_frame;
-    memset(&tx_frame, 0, sizeof(tx_frame));
-    tx_frame.can_id = id;
-    tx_frame.can_dlc = dlc;
-    memcpy( tx_frame.data, msg, dlc );
+    bcm_tx_msg_s tx_buffer;
+    size_t size = oscc_build_command_message(&tx_buffer, false, 0, 0, id, msg, dlc);
 
-    int ret = write(global_oscc_can_socket, &tx_frame, sizeof(tx_frame));
+    int ret = write(global_oscc_can_socket, &tx_buffer, size);
     if (ret > 0)
       result = OSCC_OK;
     else
       perror( "Could not write to socket:" );
+
+    if (result == OSCC_OK)
+    {
+      global_oscc_can_stats.frames_sent.fetch_add(1, std::memory_order_relaxed);
+      oscc_record_tx_frame(tx_buffer.raw);
+    }
   }
   return result;
 }
 
+void oscc_record_tx_frame(void const* frame)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  oscc_recorder_record(OSCC_RECORDER_CHANNEL_OSCC,
+                       OSCC_RECORDER_FLAG_TX | (global_can_fd ? OSCC_RECORDER_FLAG_FD : 0),
+                       (struct canfd_frame const*) frame,
+                       (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+
 oscc_result_t register_can_signal()
 {
   oscc_result_t result = OSCC_ERROR;
@@ -410,29 +1115,228 @@ oscc_result_t oscc_async_enable(int socket)
 
   if (result == OSCC_OK)
   {
-    ret = fcntl(socket, F_SETFL, FASYNC|O_NONBLOCK);
-    if (ret < 0)
+    ret = fcntl(socket, F_SETFL, FASYNC|O_NONBLOCK);
+    if (ret < 0)
+    {
+      perror("Setting nonblocking asynchronous socket I/O failed:");
+      result = OSCC_ERROR;
+    }
+  }
+
+  return result;
+}
+
+static void oscc_reset_socket_stats(can_socket_stats_s* stats)
+{
+  stats->frames_received.store(0, std::memory_order_relaxed);
+  stats->frames_dropped.store(0, std::memory_order_relaxed);
+  stats->frames_sent.store(0, std::memory_order_relaxed);
+  stats->interface_rx_base.store(0, std::memory_order_relaxed);
+}
+
+oscc_result_t oscc_start_rx()
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  oscc_init_rx_batch();
+  oscc_dispatch_init();
+
+  oscc_reset_socket_stats(&global_oscc_can_stats);
+  oscc_reset_socket_stats(&global_vehicle_can_stats);
+
+  result = oscc_apply_can_filters();
+
+  // Frames counted by the interface from here on were either delivered to
+  // us, dropped from our queue or rejected by the filters just installed
+  global_oscc_can_stats.interface_rx_base.store(oscc_interface_rx_packets(global_oscc_can_channel),
+                                                std::memory_order_relaxed);
+  if (global_vehicle_can_socket >= 0)
+    global_vehicle_can_stats.interface_rx_base.store(oscc_interface_rx_packets(global_vehicle_can_channel),
+                                                     std::memory_order_relaxed);
+
+  if (result != OSCC_OK)
+    return result;
+
+  if (global_rx_mode == OSCC_RX_MODE_THREAD)
+    result = oscc_start_rx_thread();
+  else
+  {
+    result = register_can_signal();
+
+    if (result == OSCC_OK)
+      result = oscc_async_enable(global_oscc_can_socket);
+
+    if (result==OSCC_OK && global_vehicle_can_socket>=0)
+      oscc_async_enable(global_vehicle_can_socket);
+  }
+
+  return result;
+}
+
+static oscc_result_t oscc_epoll_add(int epoll_fd, int fd)
+{
+  oscc_result_t result = OSCC_ERROR;
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)
+    result = OSCC_OK;
+  else
+    perror("Adding socket to epoll set failed:");
+
+  return result;
+}
+
+static void* oscc_rx_thread(void* arg)
+{
+  UNUSED(arg);
+
+  struct epoll_event events[3];
+  bool running = true;
+
+  while (running)
+  {
+    int ready = epoll_wait(global_rx_epoll_fd, events, 3, -1);
+    if (ready < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("Waiting for CAN frames failed:");
+      break;
+    }
+
+    for (int i=0; i<ready; ++i)
+    {
+      if (events[i].data.fd == global_rx_stop_fd)
+        running = false;
+      else if (events[i].data.fd == global_oscc_can_socket)
+        oscc_drain_oscc_can();
+      else if (events[i].data.fd == global_vehicle_can_socket)
+        oscc_drain_vehicle_can();
+    }
+  }
+
+  return NULL;
+}
+
+oscc_result_t oscc_start_rx_thread()
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (global_rx_thread_running)
+    return result;
+
+  // The drain loops read until EAGAIN, so the sockets must not block
+  result = oscc_set_nonblocking(global_oscc_can_socket);
+  if (result==OSCC_OK && global_vehicle_can_socket>=0)
+    result = oscc_set_nonblocking(global_vehicle_can_socket);
+
+  if (result == OSCC_OK)
+  {
+    global_rx_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    global_rx_stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (global_rx_epoll_fd<0 || global_rx_stop_fd<0)
+    {
+      perror("Creating RX thread descriptors failed:");
+      result = OSCC_ERROR;
+    }
+  }
+
+  if (result == OSCC_OK)
+    result = oscc_epoll_add(global_rx_epoll_fd, global_rx_stop_fd);
+  if (result == OSCC_OK)
+    result = oscc_epoll_add(global_rx_epoll_fd, global_oscc_can_socket);
+  if (result==OSCC_OK && global_vehicle_can_socket>=0)
+    result = oscc_epoll_add(global_rx_epoll_fd, global_vehicle_can_socket);
+
+  if (result == OSCC_OK)
+  {
+    int ret = pthread_create(&global_rx_thread, NULL, oscc_rx_thread, NULL);
+    if (ret == 0)
+      global_rx_thread_running = true;
+    else
     {
-      perror("Setting nonblocking asynchronous socket I/O failed:");
+      printf("Error: Could not start RX thread: %s\n", strerror(ret));
       result = OSCC_ERROR;
     }
   }
 
+  if (result != OSCC_OK)
+    oscc_stop_rx_thread();
+
+  return result;
+}
+
+void oscc_stop_rx_thread()
+{
+  if (global_rx_thread_running)
+  {
+    uint64_t stop = 1;
+    if (write(global_rx_stop_fd, &stop, sizeof(stop)) != sizeof(stop))
+      perror("Signalling RX thread failed:");
+    pthread_join(global_rx_thread, NULL);
+    global_rx_thread_running = false;
+  }
+
+  if (global_rx_epoll_fd >= 0)
+  {
+    close(global_rx_epoll_fd);
+    global_rx_epoll_fd = UNINITIALIZED_SOCKET;
+  }
+
+  if (global_rx_stop_fd >= 0)
+  {
+    close(global_rx_stop_fd);
+    global_rx_stop_fd = UNINITIALIZED_SOCKET;
+  }
+}
+
+oscc_result_t oscc_set_nonblocking(int socket)
+{
+  oscc_result_t result = OSCC_ERROR;
+  int flags = fcntl(socket, F_GETFL);
+  if (flags>=0 && fcntl(socket, F_SETFL, flags|O_NONBLOCK)==0)
+    result = OSCC_OK;
+  else
+    perror("Setting nonblocking socket I/O failed:");
   return result;
 }
 
-oscc_result_t oscc_search_can(can_contains_s(*search_callback)(const char*), 
-                              bool search_oscc                               )
+oscc_result_t oscc_search_can(can_contains_s(*search_callback)(const char*, can_contains_s), 
+                              bool search_oscc                                               )
 {
   oscc_result_t result = OSCC_OK;
 
   if (search_callback == NULL)
     result = OSCC_ERROR;
-  device_names_s dev_list;
-  dev_list.name = NULL;
-  dev_list.size = 0;
+  can_interface_list_s interface_list;
+  interface_list.size = 0;
   if (result == OSCC_OK)
-    result = construct_interfaces_list(&dev_list);
+    result = construct_interfaces_list(&interface_list);
+
+  // Collect the candidates so they can all be sniffed at the same time
+  const char* candidates[OSCC_MAX_DETECTION_CHANNELS];
+  can_contains_s detections[OSCC_MAX_DETECTION_CHANNELS];
+  size_t candidate_count = 0;
+
+  // Only CAN links that are up can carry traffic
+  for (size_t i=0; i<interface_list.size && candidate_count<OSCC_MAX_DETECTION_CHANNELS; ++i)
+  {
+    if (interface_list.interfaces[i].is_up)
+      candidates[candidate_count++] = interface_list.interfaces[i].name;
+  }
+
+  // Stop sniffing as soon as the channels this search needs have been found
+  can_contains_s goal = {.is_oscc=search_oscc, .has_vehicle=true};
+
+  if (result==OSCC_OK && candidate_count>0)
+    can_detection_all(candidates,
+                      candidate_count,
+                      detections,
+                      &goal,
+                      &global_detection_config);
 
   // temp_contents is the temporary storage of the current CAN channel
   can_contains_s temp_contents;
@@ -441,35 +1345,28 @@ oscc_result_t oscc_search_can(can_contains_s(*search_callback)(const char*),
   all_contents.is_oscc = !search_oscc;
   all_contents.has_vehicle = false;
   
-  for (size_t i=0; i<dev_list.size; ++i)
+  for (size_t i=0; i<candidate_count && result==OSCC_OK; ++i)
   {
-    if (strstr(dev_list.name[i], "can")!=NULL && result==OSCC_OK)
-    {
-      temp_contents = search_callback(dev_list.name[i]);
-      all_contents.is_oscc |= temp_contents.is_oscc;
-      all_contents.has_vehicle |= temp_contents.has_vehicle;
+    temp_contents = search_callback(candidates[i], detections[i]);
+    all_contents.is_oscc |= temp_contents.is_oscc;
+    all_contents.has_vehicle |= temp_contents.has_vehicle;
 
-      // Leave the while loop if both requirements are met
-      if(all_contents.is_oscc && all_contents.has_vehicle)
-        break;
-    }
+    // Leave the while loop if both requirements are met
+    if(all_contents.is_oscc && all_contents.has_vehicle)
+      break;
   }
 
-  if (dev_list.name != NULL)
-    result = clear_device_names(&dev_list);
-
   return result;
 }
 
-can_contains_s auto_init_all_can(const char* can_channel)
+can_contains_s auto_init_all_can(const char* can_channel, can_contains_s contents)
 {
   if (can_channel == NULL)
   {
-    can_contains_s contents = {.is_oscc=false, .has_vehicle=false};
-    return contents;
+    can_contains_s no_contents = {.is_oscc=false, .has_vehicle=false};
+    return no_contents;
   }
 
-  can_contains_s contents = can_detection(can_channel);
   if (contents.is_oscc)
     init_oscc_can( can_channel );
   else if( contents.has_vehicle )
@@ -478,16 +1375,14 @@ can_contains_s auto_init_all_can(const char* can_channel)
   return contents;
 }
 
-can_contains_s auto_init_vehicle_can(const char* can_channel)
+can_contains_s auto_init_vehicle_can(const char* can_channel, can_contains_s contents)
 {
   if (can_channel == NULL)
   {
-    can_contains_s contents = {.is_oscc = false, .has_vehicle = false};
-    return contents;
+    can_contains_s no_contents = {.is_oscc = false, .has_vehicle = false};
+    return no_contents;
   }
 
-  can_contains_s contents = can_detection(can_channel);
-
   if (contents.has_vehicle)
     init_vehicle_can(can_channel);
 
@@ -502,10 +1397,14 @@ oscc_result_t init_oscc_can(const char* can_channel)
   {
     printf("Assigning OSCC CAN Channel to: %s\n", can_channel);
     global_oscc_can_socket = init_can_socket(can_channel, NULL);
+    snprintf(global_oscc_can_channel, sizeof(global_oscc_can_channel), "%s", can_channel);
   }
 
   if (can_channel!=NULL && global_oscc_can_socket>=0)
+  {
+    oscc_recorder_set_channel(OSCC_RECORDER_CHANNEL_OSCC, can_channel);
     result = OSCC_OK;
+  }
 
   return result;
 }
@@ -518,10 +1417,14 @@ oscc_result_t init_vehicle_can(const char* can_channel)
   {
     printf("Assigning Vehicle CAN Channel to: %s\n", can_channel);
     global_vehicle_can_socket = init_can_socket(can_channel, NULL);
+    snprintf(global_vehicle_can_channel, sizeof(global_vehicle_can_channel), "%s", can_channel);
   }
 
   if (can_channel!=NULL && global_vehicle_can_socket>=0)
+  {
+    oscc_recorder_set_channel(OSCC_RECORDER_CHANNEL_VEHICLE, can_channel);
     result = OSCC_OK;
+  }
 
   return result;
 }
@@ -548,6 +1451,33 @@ int init_can_socket(const char* can_channel, struct timeval* tv)
       perror( "Finding CAN index failed:" );
   }
 
+  // Report the cumulative number of frames dropped from the receive queue
+  if (valid >= 0)
+  {
+    int enable = 1;
+    valid = setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+    if (valid < 0)
+      perror("Enabling queue overflow reporting failed:");
+  }
+
+  // Stamp every received frame with the kernel receive time
+  if (valid >= 0)
+  {
+    int enable = 1;
+    valid = setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+    if (valid < 0)
+      perror("Enabling receive timestamps failed:");
+  }
+
+  // Deliver and accept canfd_frame in FD mode
+  if (valid>=0 && global_can_fd)
+  {
+    int enable = 1;
+    valid = setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable));
+    if (valid < 0)
+      perror("Enabling CAN FD frames failed:");
+  }
+
   // If a timeout has been specified set one here since it should be set before
   // the bind call
   if (valid>=0 && tv!=NULL)
@@ -586,62 +1516,263 @@ int init_can_socket(const char* can_channel, struct timeval* tv)
   return sock;
 }
 
-can_contains_s can_detection(const char* can_channel)
+oscc_result_t oscc_channel_identity(const char* can_channel,
+                                    can_channel_identity_s* identity)
 {
-  if (can_channel == NULL)
+  oscc_result_t result = OSCC_ERROR;
+
+  if (can_channel!=NULL && identity!=NULL && strlen(can_channel)<IFNAMSIZ)
   {
-    can_contains_s detection = {.is_oscc=false, .has_vehicle=false};
-    return detection;
+    memset(identity, 0, sizeof(*identity));
+    strcpy(identity->name, can_channel);
+    identity->ifindex = if_nametoindex(can_channel);
+
+    if (identity->ifindex > 0)
+      result = OSCC_OK;
+  }
+
+  // The driver is the basename of the device's driver link; virtual
+  // interfaces such as vcan have no device behind them.
+  if (result == OSCC_OK)
+  {
+    char link_path[128];
+    char driver_path[256];
+    snprintf(link_path, sizeof(link_path), "/sys/class/net/%s/device/driver", can_channel);
+
+    ssize_t length = readlink(link_path, driver_path, sizeof(driver_path)-1);
+    if (length > 0)
+    {
+      driver_path[length] = '\0';
+      const char* driver = strrchr(driver_path, '/');
+      driver = (driver != NULL) ? driver+1 : driver_path;
+      size_t driver_length = strnlen(driver, OSCC_DRIVER_NAME_SIZE-1);
+      memcpy(identity->driver, driver, driver_length);
+      identity->driver[driver_length] = '\0';
+    }
+    else
+      strcpy(identity->driver, OSCC_VIRTUAL_DRIVER_NAME);
   }
 
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = CAN_MESSAGE_TIMEOUT;
+  return result;
+}
+
+// Reads one "<role> <name> <ifindex> <driver>" cache line and checks the
+// interface still exists with the same ifindex and driver.
+static bool oscc_read_cached_channel(FILE* cache,
+                                     const char* role,
+                                     can_channel_identity_s* cached)
+{
+  char cached_role[16];
+  bool valid = false;
 
-  int sock = init_can_socket( can_channel, &timeout );
+  int fields = fscanf(cache,
+                      "%15s %15s %u %63s",
+                      cached_role,
+                      cached->name,
+                      &cached->ifindex,
+                      cached->driver);
 
-  vehicle_can_desc_s vehicle_detection =
+  if (fields==4 && strcmp(cached_role, role)==0)
   {
-    .has_steering_angle = false,
-    .has_brake_pressure = false,
-    .has_wheel_speed = false
-  };
+    can_channel_identity_s current;
+    valid = oscc_channel_identity(cached->name, &current) == OSCC_OK
+            && current.ifindex == cached->ifindex
+            && strcmp(current.driver, cached->driver) == 0;
+  }
 
-  oscc_can_desc_s oscc_detection =
+  return valid;
+}
+
+oscc_result_t oscc_load_detection_cache()
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (global_detection_cache_path[0] == '\0')
+    return result;
+
+  FILE* cache = fopen(global_detection_cache_path, "r");
+  if (cache == NULL)
+    return result;
+
+  can_channel_identity_s oscc_channel;
+  can_channel_identity_s vehicle_channel;
+  bool oscc_valid = oscc_read_cached_channel(cache, "oscc", &oscc_channel);
+  bool vehicle_valid = false;
+
+  // The vehicle line is optional; it is absent when vehicle CAN was not found
+  // or shares the OSCC channel.
+  bool vehicle_cached = false;
+  if (oscc_valid)
   {
-    .has_accel_report = false,
-    .has_steer_report = false,
-    .has_brake_report = false
-  };
+    long position = ftell(cache);
+    char role[16];
+    vehicle_cached = fscanf(cache, "%15s", role) == 1;
+    fseek(cache, position, SEEK_SET);
+
+    if (vehicle_cached)
+      vehicle_valid = oscc_read_cached_channel(cache, "vehicle", &vehicle_channel);
+  }
+
+  fclose(cache);
 
-  uint i = 0;
+  if (oscc_valid && (vehicle_valid || !vehicle_cached))
+  {
+    // One quick passive check: with early exit this returns as soon as the
+    // cached channels show the traffic they were assigned for.
+    const char* channels[2] = {oscc_channel.name, vehicle_channel.name};
+    can_contains_s detections[2];
+    can_contains_s goal = {.is_oscc=true, .has_vehicle=vehicle_cached};
+
+    can_detection_all(channels,
+                      vehicle_cached ? 2 : 1,
+                      detections,
+                      &goal,
+                      &global_detection_config);
+
+    if (detections[0].is_oscc
+        && (!vehicle_cached || detections[1].has_vehicle))
+    {
+      printf("Using cached CAN channel assignment\n");
+      result = init_oscc_can(oscc_channel.name);
+
+      if (result==OSCC_OK && vehicle_cached)
+        result = init_vehicle_can(vehicle_channel.name);
+    }
+  }
 
-  for (i=0; i<MAX_CAN_IDS; i++)
+  // Fall back to a full scan with nothing left open
+  if (result != OSCC_OK)
   {
-    struct can_frame rx_frame;
-    memset(&rx_frame, 0, sizeof(rx_frame));
-    int recv_bytes = 0;
+    if (global_oscc_can_socket >= 0)
+    {
+      close(global_oscc_can_socket);
+      global_oscc_can_socket = UNINITIALIZED_SOCKET;
+    }
+
+    if (global_vehicle_can_socket >= 0)
+    {
+      close(global_vehicle_can_socket);
+      global_vehicle_can_socket = UNINITIALIZED_SOCKET;
+    }
+  }
+
+  return result;
+}
+
+oscc_result_t oscc_save_detection_cache()
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (global_detection_cache_path[0]=='\0' || global_oscc_can_socket<0)
+    return result;
 
-    recv_bytes = read(sock, &rx_frame, sizeof(rx_frame));
+  can_channel_identity_s oscc_channel;
+  can_channel_identity_s vehicle_channel;
+  bool has_vehicle = global_vehicle_can_socket >= 0;
 
-    if (recv_bytes==CAN_MTU || recv_bytes==CANFD_MTU)
+  result = oscc_channel_identity(global_oscc_can_channel, &oscc_channel);
+
+  if (result==OSCC_OK && has_vehicle)
+    result = oscc_channel_identity(global_vehicle_can_channel, &vehicle_channel);
+
+  // Write a temporary file and rename it over the cache so a concurrent
+  // start never reads a partial assignment.
+  char temp_path[OSCC_DETECTION_CACHE_PATH_SIZE + 8];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", global_detection_cache_path);
+
+  FILE* cache = NULL;
+  if (result == OSCC_OK)
+  {
+    cache = fopen(temp_path, "w");
+    if (cache == NULL)
     {
-      if (rx_frame.can_id < 0x100 
-          && rx_frame.data[0] == OSCC_MAGIC_BYTE_0 
-          && rx_frame.data[1] == OSCC_MAGIC_BYTE_1 )
-      {
-        oscc_detection.has_brake_report |= rx_frame.can_id==OSCC_BRAKE_REPORT_CAN_ID;
-        oscc_detection.has_steer_report |= rx_frame.can_id==OSCC_STEERING_REPORT_CAN_ID;
-        oscc_detection.has_accel_report |= rx_frame.can_id==OSCC_THROTTLE_REPORT_CAN_ID;
-      }
+      perror("Opening CAN detection cache failed:");
+      result = OSCC_ERROR;
+    }
+  }
 
-      vehicle_detection.has_brake_pressure |= rx_frame.can_id==KIA_SOUL_OBD_BRAKE_PRESSURE_CAN_ID;
-      vehicle_detection.has_steering_angle |= rx_frame.can_id==KIA_SOUL_OBD_STEERING_WHEEL_ANGLE_CAN_ID;
-      vehicle_detection.has_wheel_speed |= rx_frame.can_id==KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID;
+  if (result == OSCC_OK)
+  {
+    fprintf(cache,
+            "oscc %s %u %s\n",
+            oscc_channel.name,
+            oscc_channel.ifindex,
+            oscc_channel.driver);
+
+    if (has_vehicle)
+      fprintf(cache,
+              "vehicle %s %u %s\n",
+              vehicle_channel.name,
+              vehicle_channel.ifindex,
+              vehicle_channel.driver);
+
+    if (fclose(cache)!=0 || rename(temp_path, global_detection_cache_path)!=0)
+    {
+      perror("Writing CAN detection cache failed:");
+      unlink(temp_path);
+      result = OSCC_ERROR;
     }
   }
 
-  close(sock);
+  return result;
+}
+
+can_contains_s can_detection(const char* can_channel)
+{
+  can_contains_s detection = {.is_oscc=false, .has_vehicle=false};
+
+  if (can_channel != NULL)
+    can_detection_all(&can_channel, 1, &detection, NULL, &global_detection_config);
+
+  return detection;
+}
+
+static uint64_t oscc_monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec*1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void can_detection_update(can_detection_state_s* state,
+                                 struct canfd_frame const* rx_frame)
+{
+  if (rx_frame->can_id < 0x100 
+      && rx_frame->data[0] == OSCC_MAGIC_BYTE_0 
+      && rx_frame->data[1] == OSCC_MAGIC_BYTE_1 )
+  {
+    state->counts.brake_report += rx_frame->can_id==OSCC_BRAKE_REPORT_CAN_ID;
+    state->counts.steer_report += rx_frame->can_id==OSCC_STEERING_REPORT_CAN_ID;
+    state->counts.accel_report += rx_frame->can_id==OSCC_THROTTLE_REPORT_CAN_ID;
+  }
+
+  oscc_vehicle_profile_s const* profile = oscc_vehicle_profile();
+
+  state->counts.brake_pressure += rx_frame->can_id==profile->brake_pressure_can_id;
+  state->counts.steering_angle += rx_frame->can_id==profile->steering_wheel_angle_can_id;
+  state->counts.wheel_speed += rx_frame->can_id==profile->wheel_speed_can_id;
+  state->counts.vehicle_speed += rx_frame->can_id==profile->speed_can_id;
+}
+
+static can_contains_s can_detection_result(can_detection_state_s const* state,
+                                           unsigned int confidence         )
+{
+  oscc_can_desc_s oscc_detection =
+  {
+    .has_accel_report = state->counts.accel_report >= confidence,
+    .has_steer_report = state->counts.steer_report >= confidence,
+    .has_brake_report = state->counts.brake_report >= confidence
+  };
+
+  vehicle_can_desc_s vehicle_detection =
+  {
+    .has_steering_angle = state->counts.steering_angle >= confidence,
+    .has_brake_pressure = state->counts.brake_pressure >= confidence,
+    .has_wheel_speed = state->counts.wheel_speed >= confidence,
+    // Only required from vehicles that send it
+    .has_vehicle_speed = state->counts.vehicle_speed >= confidence
+                         || oscc_vehicle_profile()->speed_can_id == OSCC_VEHICLE_NO_CAN_ID
+  };
 
   can_contains_s detection =
   {
@@ -652,130 +1783,286 @@ can_contains_s can_detection(const char* can_channel)
     .has_vehicle = vehicle_detection.has_brake_pressure 
                    && vehicle_detection.has_steering_angle 
                    && vehicle_detection.has_wheel_speed
+                   && vehicle_detection.has_vehicle_speed
   };
 
   return detection;
 }
 
-oscc_result_t construct_interfaces_list(device_names_s* const names_ptr)
+void can_detection_all(const char* const* can_channels,
+                       size_t count,
+                       can_contains_s* detections,
+                       can_contains_s const* goal,
+                       oscc_detection_config_s const* config)
 {
-  FILE* file_handler;
-  char buffer[512];
-  oscc_result_t result = OSCC_OK;
+  if (can_channels==NULL || detections==NULL || config==NULL)
+    return;
 
-  file_handler = fopen("/proc/net/dev", "r");
-  if (!file_handler) 
-  {
-    perror( "Cannot read: /proc/net/dev" );
-    result = OSCC_ERROR;
-  }
+  if (count > OSCC_MAX_DETECTION_CHANNELS)
+    count = OSCC_MAX_DETECTION_CHANNELS;
 
-  if (result==OSCC_OK && names_ptr==NULL)
-    result = OSCC_ERROR;
+  const unsigned int confidence = config->confidence>0 ? config->confidence : 1;
 
-  int lines = 0;
+  struct pollfd fds[OSCC_MAX_DETECTION_CHANNELS];
+  can_detection_state_s states[OSCC_MAX_DETECTION_CHANNELS];
+  memset(states, 0, sizeof(states));
 
-  if (result == OSCC_OK)
-  {
-    while (fgets( buffer, sizeof(buffer), file_handler)) 
-      ++lines;
+  uint64_t now = oscc_monotonic_ns();
+  const uint64_t deadline = now + (uint64_t)config->deadline_ms*1000000ULL;
+  const uint64_t message_timeout = (uint64_t)CAN_MESSAGE_TIMEOUT*1000000ULL;
+  size_t active = 0;
 
-    names_ptr->name = (char**)malloc(lines*sizeof(char*));
+  for (size_t i=0; i<count; ++i)
+  {
+    fds[i].fd = init_can_socket(can_channels[i], NULL);
+    fds[i].events = POLLIN;
+    fds[i].revents = 0;
+    states[i].last_activity_ns = now;
 
-    for (int i=0; i<lines; ++i)
-      names_ptr->name[i] = (char*)malloc(IFNAMSIZ * sizeof(char));
+    if (fds[i].fd >= 0)
+    {
+      if (oscc_set_nonblocking(fds[i].fd) == OSCC_OK)
+        ++active;
+      else
+      {
+        close(fds[i].fd);
+        fds[i].fd = UNINITIALIZED_SOCKET;
+      }
+    }
+  }
 
-    rewind(file_handler);
+  // Every interface gets MAX_CAN_IDS chances to show its IDs: each frame read
+  // and each CAN_MESSAGE_TIMEOUT without a frame uses one. All interfaces are
+  // sniffed at once, so the total time is that of the slowest one, and never
+  // more than the deadline. Sniffing stops early once the evidence is in: an
+  // interface is done when it has shown both OSCC and vehicle IDs, and the
+  // whole search is done when the channels seen so far satisfy the goal.
+  bool goal_met = false;
 
-    // Consume the first two lines since they are headers
-    fgets(buffer, sizeof(buffer), file_handler);
-    fgets(buffer, sizeof(buffer), file_handler);
-  }
+  while (active>0 && now<deadline && !goal_met)
+  {
+    uint64_t wait_ns = deadline - now;
+    if (wait_ns > message_timeout)
+      wait_ns = message_timeout;
 
-  char* socket_name = (char*)calloc(IFNAMSIZ, sizeof(char)); //FIX IT?
+    struct timespec timeout;
+    timeout.tv_sec = wait_ns / 1000000000ULL;
+    timeout.tv_nsec = wait_ns % 1000000000ULL;
 
-  if (!socket_name)
-    result = OSCC_ERROR;
+    int ready = ppoll(fds, count, &timeout, NULL);
+    if (ready<0 && errno!=EINTR)
+    {
+      perror("Waiting for CAN detection frames failed:");
+      break;
+    }
 
-  if (result == OSCC_OK)
-  {
-    int size = 0;
+    now = oscc_monotonic_ns();
+    can_contains_s found = {.is_oscc=false, .has_vehicle=false};
 
-    while (size<lines && fgets(buffer, sizeof(buffer), file_handler)) 
+    for (size_t i=0; i<count; ++i)
     {
-      result = get_device_name(buffer, socket_name);
-      if (result == OSCC_OK)
+      can_detection_state_s* state = &states[i];
+      can_contains_s detection = can_detection_result(state, confidence);
+
+      if (fds[i].fd >= 0)
       {
-        strncpy(names_ptr->name[size], socket_name, IFNAMSIZ);
-        ++size;
+        if (ready>0 && (fds[i].revents & POLLIN))
+        {
+          struct canfd_frame rx_frame;
+          memset(&rx_frame, 0, sizeof(rx_frame));
+          ssize_t length = 0;
+
+          while (state->frames_checked < MAX_CAN_IDS
+                 && !(detection.is_oscc && detection.has_vehicle)
+                 && ((length = read(fds[i].fd, &rx_frame, sizeof(rx_frame))) == CAN_MTU
+                     || length == CANFD_MTU))
+          {
+            can_detection_update(state, &rx_frame);
+            ++state->frames_checked;
+            detection = can_detection_result(state, confidence);
+          }
+          state->last_activity_ns = now;
+        }
+        else if (now - state->last_activity_ns >= message_timeout)
+        {
+          ++state->frames_checked;
+          state->last_activity_ns = now;
+        }
+
+        bool failed = ready>0 && (fds[i].revents & (POLLERR|POLLHUP|POLLNVAL));
+        bool settled = detection.is_oscc && detection.has_vehicle;
+
+        if (state->frames_checked>=MAX_CAN_IDS || failed || settled)
+        {
+          close(fds[i].fd);
+          fds[i].fd = UNINITIALIZED_SOCKET;
+          --active;
+        }
       }
-    }
 
-    free(socket_name);
+      found.is_oscc |= detection.is_oscc;
+      found.has_vehicle |= detection.has_vehicle;
+    }
 
-    names_ptr->size = size;
+    if (goal != NULL)
+      goal_met = (found.is_oscc || !goal->is_oscc)
+                 && (found.has_vehicle || !goal->has_vehicle);
   }
 
-  fclose(file_handler);
+  for (size_t i=0; i<count; ++i)
+  {
+    if (fds[i].fd >= 0)
+      close(fds[i].fd);
 
-  return result;
+    detections[i] = can_detection_result(&states[i], confidence);
+  }
 }
 
-oscc_result_t clear_device_names(device_names_s* const names_ptr)
+// Copies the CAN specific link details nested in IFLA_LINKINFO/IFLA_INFO_DATA
+static void oscc_parse_can_link_info(struct rtattr* link_info, can_interface_s* interface)
 {
-  oscc_result_t result = OSCC_OK;
+  int link_info_length = RTA_PAYLOAD(link_info);
 
-  if (names_ptr == NULL)
-    result = OSCC_ERROR;
-  else
+  for (struct rtattr* info = (struct rtattr*)RTA_DATA(link_info);
+       RTA_OK(info, link_info_length);
+       info = RTA_NEXT(info, link_info_length))
   {
-    // uint i;
-    for (size_t i=0; i<names_ptr->size; ++i)
+    if (info->rta_type != IFLA_INFO_DATA)
+      continue;
+
+    int data_length = RTA_PAYLOAD(info);
+
+    for (struct rtattr* data = (struct rtattr*)RTA_DATA(info);
+         RTA_OK(data, data_length);
+         data = RTA_NEXT(data, data_length))
     {
-      if (names_ptr->name[i] != NULL)
+      if (data->rta_type==IFLA_CAN_BITTIMING
+          && RTA_PAYLOAD(data)>=sizeof(struct can_bittiming))
       {
-        free(names_ptr->name[i]);
-        names_ptr->name[i] = NULL;
+        struct can_bittiming const* bittiming =
+          (struct can_bittiming const*)RTA_DATA(data);
+        interface->bitrate = bittiming->bitrate;
       }
+      else if (data->rta_type==IFLA_CAN_STATE
+               && RTA_PAYLOAD(data)>=sizeof(uint32_t))
+        memcpy(&interface->can_state, RTA_DATA(data), sizeof(uint32_t));
     }
+  }
+}
+
+// Adds the interface described by one RTM_NEWLINK message if it is CAN
+static void oscc_parse_link(struct nlmsghdr* message, can_interface_list_s* list)
+{
+  struct ifinfomsg* link = (struct ifinfomsg*)NLMSG_DATA(message);
+
+  if (link->ifi_type!=ARPHRD_CAN || list->size>=OSCC_MAX_CAN_INTERFACES)
+    return;
 
-    if (names_ptr->name != NULL)
+  can_interface_s* interface = &list->interfaces[list->size];
+  memset(interface, 0, sizeof(*interface));
+  interface->ifindex = link->ifi_index;
+  interface->is_up = (link->ifi_flags & IFF_UP) != 0;
+  interface->can_state = OSCC_CAN_STATE_UNKNOWN;
+
+  int attributes_length = IFLA_PAYLOAD(message);
+
+  for (struct rtattr* attribute = IFLA_RTA(link);
+       RTA_OK(attribute, attributes_length);
+       attribute = RTA_NEXT(attribute, attributes_length))
+  {
+    if (attribute->rta_type == IFLA_IFNAME)
     {
-      free(names_ptr->name);
-      names_ptr->name = NULL;
+      // Bounded by the attribute too, in case the kernel left out the NUL
+      size_t limit = RTA_PAYLOAD(attribute) < IFNAMSIZ-1 ? RTA_PAYLOAD(attribute) : IFNAMSIZ-1;
+      size_t length = strnlen((const char*)RTA_DATA(attribute), limit);
+      memcpy(interface->name, RTA_DATA(attribute), length);
+      interface->name[length] = '\0';
     }
+    else if (attribute->rta_type == IFLA_LINKINFO)
+      oscc_parse_can_link_info(attribute, interface);
   }
 
-  return result;
+  if (interface->name[0] != '\0')
+    ++list->size;
 }
 
-oscc_result_t get_device_name(char* string, char* const name)
+oscc_result_t construct_interfaces_list(can_interface_list_s* const list)
 {
-  oscc_result_t result = OSCC_OK;
+  oscc_result_t result = OSCC_ERROR;
 
-  if (name==NULL || string==NULL)
-    result = OSCC_ERROR;
+  if (list == NULL)
+    return result;
+
+  list->size = 0;
+
+  int netlink = socket(AF_NETLINK, SOCK_RAW|SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (netlink < 0)
+  {
+    perror("Opening rtnetlink socket failed:");
+    return result;
+  }
+
+  struct {
+    struct nlmsghdr header;
+    struct ifinfomsg link;
+  } request;
+
+  memset(&request, 0, sizeof(request));
+  request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  request.header.nlmsg_type = RTM_GETLINK;
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.header.nlmsg_seq = 1;
+  request.link.ifi_family = AF_UNSPEC;
+
+  if (send(netlink, &request, request.header.nlmsg_len, 0) < 0)
+    perror("Requesting link dump failed:");
+  else
+    result = OSCC_OK;
 
-  if (result==OSCC_OK)
+  // The dump arrives as a series of multipart datagrams ending in NLMSG_DONE
+  uint32_t buffer[4096];
+  bool done = false;
+
+  while (result==OSCC_OK && !done)
   {
-    size_t span = strcspn(string, ":");
-    char temp_name[IFNAMSIZ];
-    strncpy(temp_name, string, span);
-    if (span <= IFNAMSIZ)
-      temp_name[span] = '\0';
+    ssize_t length = recv(netlink, buffer, sizeof(buffer), 0);
+    if (length < 0)
+    {
+      if (errno == EINTR)
+        continue;
 
-    size_t leading_spaces = strspn(temp_name, " ");
-    if (leading_spaces != 0)
+      perror("Reading link dump failed:");
+      result = OSCC_ERROR;
+      break;
+    }
+
+    int remaining = (int)length;
+
+    for (struct nlmsghdr* message = (struct nlmsghdr*)buffer;
+         NLMSG_OK(message, remaining);
+         message = NLMSG_NEXT(message, remaining))
     {
-      char new_name[IFNAMSIZ];
-      strncpy(name, temp_name+leading_spaces, span-leading_spaces+1);
-      new_name[span-leading_spaces] = '\0';
-      UNUSED(new_name);
+      if (message->nlmsg_type == NLMSG_DONE)
+      {
+        done = true;
+        break;
+      }
+      else if (message->nlmsg_type == NLMSG_ERROR)
+      {
+        printf("Error: rtnetlink link dump failed\n");
+        result = OSCC_ERROR;
+        break;
+      }
+      else if (message->nlmsg_type == RTM_NEWLINK)
+        oscc_parse_link(message, list);
     }
-    else
-      strncpy(name, temp_name, span);
+
+    if (length == 0)
+      done = true;
   }
 
+  close(netlink);
+
   return result;
 }
 
@@ -783,18 +2070,7 @@ static oscc_result_t get_wheel_speed(struct can_frame const* const frame,
                                      double* wheel_speed, 
                                      const size_t offset                  )
 {
-  if (frame==NULL || wheel_speed==NULL)
-    return OSCC_ERROR;
-
-  if (frame->can_id != KIA_SOUL_OBD_WHEEL_SPEED_CAN_ID)
-    return OSCC_ERROR;
-
-  uint16_t raw = ((frame->data[offset + 1] & 0x0F) << 8) | frame->data[offset];
-
-  // 10^-1 precision, raw / 32.0
-  *wheel_speed = (double)((int)((double)raw / 3.2) / 10.0);
-
-  return OSCC_OK;
+  return oscc_selected_vehicle_decoders()->wheel_speed(frame, wheel_speed, offset);
 }
 
 oscc_result_t get_wheel_speed_right_rear(struct can_frame const* const frame, 
@@ -832,37 +2108,17 @@ oscc_result_t get_wheel_speed_left_front(struct can_frame const* const frame,
 oscc_result_t get_steering_wheel_angle(struct can_frame const* const frame, 
                                        double* steering_wheel_angle         )
 {
-  if (frame==NULL || steering_wheel_angle==NULL)
-    return OSCC_ERROR;
-
-  if (frame->can_id != KIA_SOUL_OBD_STEERING_WHEEL_ANGLE_CAN_ID)
-    return OSCC_ERROR;
-
-  int16_t raw = (frame->data[1] << 8) | frame->data[0];
-
-  *steering_wheel_angle = -((double)raw * KIA_SOUL_OBD_STEERING_ANGLE_SCALAR);
-
-  return OSCC_OK;
+  return oscc_selected_vehicle_decoders()->steering_wheel_angle(frame, steering_wheel_angle);
 }
 
 oscc_result_t get_brake_pressure(struct can_frame const * const frame, 
                                  double* brake_pressure                )
 {
-  if (frame==NULL || brake_pressure==NULL)
-    return OSCC_ERROR;
-
-  if (frame->can_id != KIA_SOUL_OBD_BRAKE_PRESSURE_CAN_ID)
-    return OSCC_ERROR;
-
-#ifdef KIA_NIRO
-    double scale = 40.0;
-    uint16_t raw = ((frame->data[4] & 0x0F) << 8) | frame->data[3];
-#else
-    double scale = 10.0;
-    uint16_t raw = ((frame->data[5] & 0x0F) << 8) | frame->data[4];
-#endif
-
-  *brake_pressure = (double)raw / scale;
+  return oscc_selected_vehicle_decoders()->brake_pressure(frame, brake_pressure);
+}
 
-  return OSCC_OK;
+oscc_result_t get_vehicle_speed(struct can_frame const * const frame, 
+                                double* vehicle_speed                 )
+{
+  return oscc_selected_vehicle_decoders()->vehicle_speed(frame, vehicle_speed);
 }
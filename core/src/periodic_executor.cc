@@ -0,0 +1,177 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/include/periodic_executor.h"
+
+static uint64_t monotonic_now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec*1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(uint64_t ns)
+{
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000ULL;
+  ts.tv_nsec = ns % 1000000000ULL;
+  return ts;
+}
+
+oscc_result_t periodic_executor_init(periodic_executor_s* executor, unsigned long period_us)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (executor==NULL || period_us==0)
+    return result;
+
+  memset(executor, 0, sizeof(*executor));
+  executor->period_ns = (uint64_t)period_us * 1000ULL;
+  executor->period_min_ns = INFINITY;
+
+  executor->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (executor->timer_fd < 0)
+    perror("Creating periodic timer failed:");
+  else
+  {
+    uint64_t now = monotonic_now_ns();
+    struct itimerspec spec;
+    spec.it_value = ns_to_timespec(now + executor->period_ns);
+    spec.it_interval = ns_to_timespec(executor->period_ns);
+
+    if (timerfd_settime(executor->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0)
+    {
+      executor->last_wakeup_ns = now;
+      result = OSCC_OK;
+    }
+    else
+    {
+      perror("Arming periodic timer failed:");
+      close(executor->timer_fd);
+      executor->timer_fd = -1;
+    }
+  }
+
+  return result;
+}
+
+oscc_result_t periodic_executor_wait(periodic_executor_s* executor)
+{
+  oscc_result_t result = OSCC_ERROR;
+  uint64_t expirations = 0;
+
+  if (executor==NULL || executor->timer_fd<0)
+    return result;
+
+  ssize_t ret = read(executor->timer_fd, &expirations, sizeof(expirations));
+  if (ret != sizeof(expirations))
+  {
+    if (errno != EINTR)
+      perror("Waiting for periodic timer failed:");
+    return result;
+  }
+
+  uint64_t now = monotonic_now_ns();
+  double period = (double)(now - executor->last_wakeup_ns);
+  executor->last_wakeup_ns = now;
+
+  // Welford's running mean and variance of the measured period
+  ++executor->cycles;
+  double delta = period - executor->period_mean_ns;
+  executor->period_mean_ns += delta / executor->cycles;
+  executor->period_m2_ns += delta * (period - executor->period_mean_ns);
+
+  if (period < executor->period_min_ns)
+    executor->period_min_ns = period;
+  if (period > executor->period_max_ns)
+    executor->period_max_ns = period;
+
+  double jitter = fabs(period - (double)executor->period_ns*expirations);
+  if (jitter > executor->jitter_max_ns)
+    executor->jitter_max_ns = jitter;
+
+  result = OSCC_OK;
+  if (expirations > 1)
+  {
+    executor->overruns += expirations - 1;
+    result = OSCC_WARNING;
+  }
+
+  return result;
+}
+
+oscc_result_t periodic_executor_run(periodic_executor_s* executor,
+                                    oscc_result_t(*task)(void* user_data),
+                                    void* user_data,
+                                    volatile sig_atomic_t const* stop)
+{
+  oscc_result_t result = OSCC_OK;
+
+  if (task == NULL)
+    return OSCC_ERROR;
+
+  while (result==OSCC_OK && (stop==NULL || *stop==0))
+  {
+    oscc_result_t wait_result = periodic_executor_wait(executor);
+    if (wait_result == OSCC_ERROR)
+    {
+      // Interrupted by the signal that set the stop flag
+      if (stop==NULL || *stop==0)
+        result = OSCC_ERROR;
+    }
+    else
+      result = task(user_data);
+  }
+
+  return result;
+}
+
+void periodic_executor_get_stats(periodic_executor_s const* executor,
+                                 periodic_executor_stats_s* stats)
+{
+  if (executor==NULL || stats==NULL)
+    return;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->cycles = executor->cycles;
+  stats->overruns = executor->overruns;
+
+  if (executor->cycles > 0)
+  {
+    stats->period_min_us = executor->period_min_ns / 1000.0;
+    stats->period_max_us = executor->period_max_ns / 1000.0;
+    stats->period_mean_us = executor->period_mean_ns / 1000.0;
+    stats->jitter_stddev_us = sqrt(executor->period_m2_ns / executor->cycles) / 1000.0;
+    stats->jitter_max_us = executor->jitter_max_ns / 1000.0;
+  }
+}
+
+void periodic_executor_print_stats(periodic_executor_s const* executor, const char* label)
+{
+  periodic_executor_stats_s stats;
+  periodic_executor_get_stats(executor, &stats);
+  printf("%s: cycles=%llu overruns=%llu period us min=%.1f mean=%.1f max=%.1f "
+         "jitter us stddev=%.1f max=%.1f\n",
+         label,
+         stats.cycles,
+         stats.overruns,
+         stats.period_min_us,
+         stats.period_mean_us,
+         stats.period_max_us,
+         stats.jitter_stddev_us,
+         stats.jitter_max_us);
+}
+
+void periodic_executor_close(periodic_executor_s* executor)
+{
+  if (executor!=NULL && executor->timer_fd>=0)
+  {
+    close(executor->timer_fd);
+    executor->timer_fd = -1;
+  }
+}
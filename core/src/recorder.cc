@@ -0,0 +1,239 @@
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/include/oscc.h"
+#include "core/include/recorder.h"
+#include "internal/recorder.h"
+#include "internal/vehicle_profiles.h"
+
+static_assert(sizeof(oscc_recorder_header_s) <= OSCC_RECORDER_HEADER_SIZE,
+              "The recorder header must fit in its page");
+static_assert(sizeof(((oscc_recorder_record_s*) 0)->data) == CANFD_MAX_DLEN,
+              "A record must hold a CAN FD payload");
+static_assert(sizeof(oscc_recorder_record_s) % sizeof(uint64_t) == 0,
+              "Records must keep their timestamps aligned");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Frames are recorded from a signal handler");
+
+static int global_recorder_fd = -1;
+static void* global_recorder_mapping = NULL;
+static size_t global_recorder_mapping_size = 0;
+static oscc_recorder_header_s* global_recorder_header = NULL;
+static oscc_recorder_record_s* global_recorder_records = NULL;
+static uint64_t global_recorder_capacity = 0;
+
+// Writers announce themselves before checking that recording is on, and stop
+// turns it off before waiting for the announced writers, so no writer can
+// touch the mapping once stop has seen the count drop to zero.
+static std::atomic<bool> global_recorder_active(false);
+static std::atomic<int> global_recorder_writers(0);
+static std::atomic<uint64_t> global_recorder_next(0);
+
+static char global_recorder_channels[OSCC_RECORDER_CHANNEL_COUNT][IFNAMSIZ];
+
+static uint64_t realtime_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void write_header_channels()
+{
+  for (int i=0; i<OSCC_RECORDER_CHANNEL_COUNT; ++i)
+    memcpy(global_recorder_header->channels[i].name, global_recorder_channels[i], IFNAMSIZ);
+}
+
+static void write_header(size_t record_capacity)
+{
+  oscc_vehicle_t vehicle = oscc_get_vehicle();
+  oscc_recorder_header_s* header = global_recorder_header;
+
+  memcpy(header->magic, OSCC_RECORDER_MAGIC, sizeof(OSCC_RECORDER_MAGIC));
+  header->version = OSCC_RECORDER_VERSION;
+  header->header_size = OSCC_RECORDER_HEADER_SIZE;
+  header->record_size = sizeof(oscc_recorder_record_s);
+  header->vehicle = vehicle;
+  header->record_capacity = record_capacity;
+  header->records_written = 0;
+  header->start_time_ns = realtime_ns();
+  snprintf(header->vehicle_name,
+           sizeof(header->vehicle_name),
+           "%s",
+           oscc_vehicle_profiles[vehicle].name);
+
+  write_header_channels();
+}
+
+static void unmap_file()
+{
+  if (global_recorder_mapping != NULL)
+    munmap(global_recorder_mapping, global_recorder_mapping_size);
+  if (global_recorder_fd >= 0)
+    close(global_recorder_fd);
+
+  global_recorder_fd = -1;
+  global_recorder_mapping = NULL;
+  global_recorder_mapping_size = 0;
+  global_recorder_header = NULL;
+  global_recorder_records = NULL;
+  global_recorder_capacity = 0;
+}
+
+oscc_result_t oscc_recorder_start(const char* path, size_t record_capacity)
+{
+  if (path==NULL || record_capacity==0 || global_recorder_mapping!=NULL)
+    return OSCC_ERROR;
+
+  if (record_capacity > (SIZE_MAX - OSCC_RECORDER_HEADER_SIZE) / sizeof(oscc_recorder_record_s))
+  {
+    printf("Error: Recorder capacity of %zu records is too large\n", record_capacity);
+    return OSCC_ERROR;
+  }
+
+  size_t size = OSCC_RECORDER_HEADER_SIZE + record_capacity * sizeof(oscc_recorder_record_s);
+
+  // Truncating zeroes every slot, which marks it empty
+  global_recorder_fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (global_recorder_fd < 0)
+  {
+    perror("Opening recorder file failed:");
+    return OSCC_ERROR;
+  }
+
+  // Reserve the blocks now, so a full disk fails here rather than as SIGBUS
+  // on a write to the mapping. Not every filesystem can preallocate.
+  int err = posix_fallocate(global_recorder_fd, 0, size);
+  if (err==EOPNOTSUPP || err==EINVAL)
+    err = ftruncate(global_recorder_fd, size) == 0 ? 0 : errno;
+
+  if (err != 0)
+  {
+    printf("Error: Could not allocate recorder file: %s\n", strerror(err));
+    unmap_file();
+    return OSCC_ERROR;
+  }
+
+  // Fault the pages in up front, so recording never takes a page fault
+  void* mapping = mmap(NULL,
+                       size,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       global_recorder_fd,
+                       0                         );
+  if (mapping == MAP_FAILED)
+  {
+    perror("Mapping recorder file failed:");
+    unmap_file();
+    return OSCC_ERROR;
+  }
+
+  global_recorder_mapping = mapping;
+  global_recorder_mapping_size = size;
+  global_recorder_header = (oscc_recorder_header_s*) mapping;
+  global_recorder_records = (oscc_recorder_record_s*) ((char*) mapping + OSCC_RECORDER_HEADER_SIZE);
+  global_recorder_capacity = record_capacity;
+
+  write_header(record_capacity);
+
+  global_recorder_next.store(0, std::memory_order_relaxed);
+  global_recorder_active.store(true, std::memory_order_seq_cst);
+
+  return OSCC_OK;
+}
+
+oscc_result_t oscc_recorder_stop()
+{
+  if (global_recorder_mapping == NULL)
+    return OSCC_ERROR;
+
+  global_recorder_active.store(false, std::memory_order_seq_cst);
+  while (global_recorder_writers.load(std::memory_order_seq_cst) != 0)
+    sched_yield();
+
+  global_recorder_header->records_written = global_recorder_next.load(std::memory_order_relaxed);
+
+  oscc_result_t result = OSCC_OK;
+  if (msync(global_recorder_mapping, global_recorder_mapping_size, MS_SYNC) != 0)
+  {
+    perror("Flushing recorder file failed:");
+    result = OSCC_ERROR;
+  }
+
+  unmap_file();
+
+  return result;
+}
+
+oscc_result_t oscc_recorder_get_stats(oscc_recorder_stats_s* stats)
+{
+  if (stats == NULL)
+    return OSCC_ERROR;
+
+  memset(stats, 0, sizeof(*stats));
+
+  if (global_recorder_mapping != NULL)
+  {
+    stats->records_written = global_recorder_next.load(std::memory_order_relaxed);
+    stats->record_capacity = global_recorder_capacity;
+  }
+
+  return OSCC_OK;
+}
+
+void oscc_recorder_set_channel(oscc_recorder_channel_t channel, const char* name)
+{
+  if (channel<0 || channel>=OSCC_RECORDER_CHANNEL_COUNT || name==NULL)
+    return;
+
+  memset(global_recorder_channels[channel], 0, IFNAMSIZ);
+  snprintf(global_recorder_channels[channel], IFNAMSIZ, "%s", name);
+
+  if (global_recorder_header != NULL)
+    write_header_channels();
+}
+
+void oscc_recorder_record(oscc_recorder_channel_t channel,
+                          uint8_t flags,
+                          struct canfd_frame const* frame,
+                          uint64_t timestamp_ns)
+{
+  // Not recording costs this one load
+  if (!global_recorder_active.load(std::memory_order_relaxed))
+    return;
+
+  global_recorder_writers.fetch_add(1, std::memory_order_seq_cst);
+
+  if (global_recorder_active.load(std::memory_order_seq_cst))
+  {
+    uint64_t index = global_recorder_next.fetch_add(1, std::memory_order_relaxed);
+    oscc_recorder_record_s* record = &global_recorder_records[index % global_recorder_capacity];
+    uint8_t len = frame->len > CANFD_MAX_DLEN ? CANFD_MAX_DLEN : frame->len;
+
+    // Mark the slot empty while it is rewritten
+    record->sequence = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record->timestamp_ns = timestamp_ns;
+    record->can_id = frame->can_id;
+    record->len = len;
+    record->flags = flags;
+    record->channel = channel;
+    record->reserved = 0;
+    memcpy(record->data, frame->data, len);
+    memset(record->data + len, 0, CANFD_MAX_DLEN - len);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    record->sequence = index + 1;
+  }
+
+  global_recorder_writers.fetch_sub(1, std::memory_order_release);
+}
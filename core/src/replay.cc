@@ -0,0 +1,567 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <linux/can/raw.h>
+
+#include "core/include/oscc.h"
+#include "core/include/recorder.h"
+#include "core/include/replay.h"
+
+#define LINE_SIZE 512
+
+// Time to back off when the interface queue is full. [ns]
+#define WRITE_RETRY_NS 50000
+
+static const char* global_recorder_role_names[OSCC_RECORDER_CHANNEL_COUNT] =
+{
+  "oscc",
+  "vehicle"
+};
+
+static uint64_t monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(uint64_t ns)
+{
+  struct timespec time;
+  time.tv_sec = ns / 1000000000ULL;
+  time.tv_nsec = ns % 1000000000ULL;
+  return time;
+}
+
+static replay_frame_s* append_frame(replay_log_s* log)
+{
+  if (log->frame_count == log->frame_capacity)
+  {
+    size_t new_capacity = log->frame_capacity==0 ? 1024 : log->frame_capacity*2;
+    void* grown = realloc(log->frames, new_capacity * sizeof(replay_frame_s));
+    if (grown == NULL)
+      return NULL;
+
+    log->frames = (replay_frame_s*) grown;
+    log->frame_capacity = new_capacity;
+  }
+
+  replay_frame_s* frame = &log->frames[log->frame_count++];
+  memset(frame, 0, sizeof(*frame));
+  return frame;
+}
+
+static int find_channel(replay_log_s* log, const char* name)
+{
+  for (size_t i=0; i<log->channel_count; ++i)
+  {
+    if (strncmp(log->channels[i], name, IFNAMSIZ) == 0)
+      return (int) i;
+  }
+
+  if (log->channel_count == REPLAY_MAX_CHANNELS)
+    return -1;
+
+  snprintf(log->channels[log->channel_count], IFNAMSIZ, "%s", name);
+  return (int) log->channel_count++;
+}
+
+static oscc_result_t load_recorder_file(replay_log_s* log, void const* mapping, size_t size)
+{
+  oscc_recorder_header_s const* header = (oscc_recorder_header_s const*) mapping;
+
+  if (header->version!=OSCC_RECORDER_VERSION
+      || header->record_size!=sizeof(oscc_recorder_record_s)
+      || header->record_capacity==0
+      || header->header_size>size
+      || header->record_capacity>(size - header->header_size)/header->record_size)
+  {
+    printf("Error: Unsupported or truncated recorder file\n");
+    return OSCC_ERROR;
+  }
+
+  oscc_recorder_record_s const* records =
+    (oscc_recorder_record_s const*) ((char const*) mapping + header->header_size);
+  uint64_t capacity = header->record_capacity;
+
+  for (int i=0; i<OSCC_RECORDER_CHANNEL_COUNT; ++i)
+  {
+    // The name in the file need not be terminated
+    char name[IFNAMSIZ];
+    size_t length = strnlen(header->channels[i].name, IFNAMSIZ - 1);
+    memcpy(name, header->channels[i].name, length);
+    name[length] = '\0';
+    if (name[0] == '\0')
+      snprintf(name, sizeof(name), "%s", global_recorder_role_names[i]);
+    find_channel(log, name);
+  }
+
+  // A file left behind by a crash has no record count, so the newest record
+  // is found from the sequences
+  uint64_t written = header->records_written;
+  if (written == 0)
+  {
+    for (uint64_t slot=0; slot<capacity; ++slot)
+    {
+      if (records[slot].sequence > written)
+        written = records[slot].sequence;
+    }
+  }
+
+  uint64_t first = written > capacity ? written - capacity : 0;
+
+  for (uint64_t n=first; n<written; ++n)
+  {
+    oscc_recorder_record_s const* record = &records[n % capacity];
+
+    // Skips slots that were being written, or were never written
+    if (record->sequence!=n+1 || record->channel>=OSCC_RECORDER_CHANNEL_COUNT)
+      continue;
+
+    replay_frame_s* frame = append_frame(log);
+    if (frame == NULL)
+      return OSCC_ERROR;
+
+    frame->timestamp_ns = record->timestamp_ns;
+    frame->channel = record->channel;
+    if (record->flags & OSCC_RECORDER_FLAG_FD)
+      frame->flags |= REPLAY_FRAME_FD;
+    if (record->flags & OSCC_RECORDER_FLAG_TX)
+      frame->flags |= REPLAY_FRAME_TX;
+    frame->frame.can_id = record->can_id;
+    frame->frame.len = record->len > CANFD_MAX_DLEN ? CANFD_MAX_DLEN : record->len;
+    memcpy(frame->frame.data, record->data, frame->frame.len);
+  }
+
+  return OSCC_OK;
+}
+
+static int hex_value(char c)
+{
+  if (c>='0' && c<='9')
+    return c - '0';
+  if (c>='a' && c<='f')
+    return c - 'a' + 10;
+  if (c>='A' && c<='F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Parses "id#data", "id#R" or "id##flags data" as written by candump -l
+static bool parse_candump_frame(const char* text, replay_frame_s* frame)
+{
+  const char* separator = strchr(text, '#');
+  if (separator == NULL || separator == text)
+    return false;
+
+  size_t id_length = separator - text;
+  canid_t can_id = 0;
+  for (const char* c=text; c<separator; ++c)
+  {
+    int value = hex_value(*c);
+    if (value < 0)
+      return false;
+    can_id = (can_id << 4) | value;
+  }
+
+  // Three digits are a standard ID, eight an extended one
+  if (id_length == 8)
+    can_id = (can_id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+  else if (id_length!=3 || can_id>CAN_SFF_MASK)
+    return false;
+
+  const char* data = separator + 1;
+  size_t max_length = CAN_MAX_DLEN;
+
+  if (*data == '#')
+  {
+    if (hex_value(data[1]) < 0)
+      return false;
+
+    frame->flags |= REPLAY_FRAME_FD;
+    frame->frame.flags = hex_value(data[1]);
+    max_length = CANFD_MAX_DLEN;
+    data += 2;
+  }
+  else if (*data=='R' || *data=='r')
+  {
+    frame->frame.can_id = can_id | CAN_RTR_FLAG;
+    frame->frame.len = hex_value(data[1]) > 0 ? hex_value(data[1]) : 0;
+    return frame->frame.len <= CAN_MAX_DLEN;
+  }
+
+  frame->frame.can_id = can_id;
+
+  size_t length = 0;
+  while (*data!='\0' && !isspace((unsigned char) *data))
+  {
+    // Some tools separate the bytes with dots
+    if (*data == '.')
+    {
+      ++data;
+      continue;
+    }
+
+    int high = hex_value(data[0]);
+    int low = high < 0 ? -1 : hex_value(data[1]);
+    if (low<0 || length==max_length)
+      return false;
+
+    frame->frame.data[length++] = (high << 4) | low;
+    data += 2;
+  }
+
+  frame->frame.len = length;
+  return true;
+}
+
+static oscc_result_t load_candump_file(replay_log_s* log, FILE* file, const char* path)
+{
+  char line[LINE_SIZE];
+  unsigned long line_number = 0;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    ++line_number;
+
+    unsigned long long seconds = 0;
+    char fraction[16];
+    char interface[IFNAMSIZ];
+    char text[LINE_SIZE];
+
+    if (sscanf(line, " (%llu.%15[0-9]) %15s %511s", &seconds, fraction, interface, text) != 4)
+      continue;
+
+    replay_frame_s* frame = append_frame(log);
+    if (frame == NULL)
+      return OSCC_ERROR;
+
+    if (!parse_candump_frame(text, frame))
+    {
+      printf("Warning: Skipping malformed frame on line %lu of %s\n", line_number, path);
+      --log->frame_count;
+      continue;
+    }
+
+    int channel = find_channel(log, interface);
+    if (channel < 0)
+    {
+      printf("Error: %s uses more than %d interfaces\n", path, REPLAY_MAX_CHANNELS);
+      return OSCC_ERROR;
+    }
+
+    // Scale the fraction to nanoseconds whatever its number of digits
+    uint64_t nanoseconds = 0;
+    for (int digit=0; digit<9; ++digit)
+    {
+      nanoseconds *= 10;
+      if (digit < (int) strlen(fraction))
+        nanoseconds += fraction[digit] - '0';
+    }
+
+    frame->timestamp_ns = seconds * 1000000000ULL + nanoseconds;
+    frame->channel = channel;
+  }
+
+  return OSCC_OK;
+}
+
+void replay_default_config(replay_config_s* config)
+{
+  if (config == NULL)
+    return;
+
+  memset(config, 0, sizeof(*config));
+  config->speed = 1.0;
+  config->spin_us = REPLAY_DEFAULT_SPIN_US;
+  config->include_tx = false;
+}
+
+oscc_result_t replay_load(replay_log_s* log, const char* path)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (log==NULL || path==NULL)
+    return result;
+
+  memset(log, 0, sizeof(*log));
+
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    printf("Error: Could not open log %s\n", path);
+    return result;
+  }
+
+  char magic[sizeof(OSCC_RECORDER_MAGIC)];
+  memset(magic, 0, sizeof(magic));
+  size_t magic_length = fread(magic, 1, sizeof(magic), file);
+
+  if (magic_length==sizeof(magic) && memcmp(magic, OSCC_RECORDER_MAGIC, sizeof(magic))==0)
+  {
+    struct stat file_stat;
+    void* mapping = MAP_FAILED;
+
+    if (fstat(fileno(file), &file_stat) == 0
+        && (size_t) file_stat.st_size >= sizeof(oscc_recorder_header_s))
+      mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+
+    if (mapping == MAP_FAILED)
+      printf("Error: Could not map recorder file %s\n", path);
+    else
+    {
+      result = load_recorder_file(log, mapping, file_stat.st_size);
+      munmap(mapping, file_stat.st_size);
+    }
+  }
+  else
+  {
+    rewind(file);
+    result = load_candump_file(log, file, path);
+  }
+
+  fclose(file);
+
+  if (result==OSCC_OK && log->frame_count==0)
+  {
+    printf("Error: No frames in log %s\n", path);
+    result = OSCC_ERROR;
+  }
+
+  // Frames of different channels may be logged slightly out of order
+  if (result == OSCC_OK)
+    std::stable_sort(log->frames,
+                     log->frames + log->frame_count,
+                     [](replay_frame_s const& a, replay_frame_s const& b)
+                     { return a.timestamp_ns < b.timestamp_ns; });
+  else
+    replay_free(log);
+
+  return result;
+}
+
+void replay_free(replay_log_s* log)
+{
+  if (log == NULL)
+    return;
+
+  free(log->frames);
+  memset(log, 0, sizeof(*log));
+}
+
+static int open_replay_socket(const char* interface)
+{
+  int sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (sock < 0)
+  {
+    perror("Opening CAN socket failed:");
+    return -1;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface);
+
+  // Send only, so nothing piles up in the receive queue
+  int enable = 1;
+  bool valid = ioctl(sock, SIOCGIFINDEX, &ifr) == 0
+               && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0) == 0
+               && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) == 0;
+
+  if (valid)
+  {
+    struct sockaddr_can address;
+    memset(&address, 0, sizeof(address));
+    address.can_family = AF_CAN;
+    address.can_ifindex = ifr.ifr_ifindex;
+    valid = bind(sock, (struct sockaddr*) &address, sizeof(address)) == 0;
+  }
+
+  if (!valid)
+  {
+    printf("Error: Could not open interface %s: %s\n", interface, strerror(errno));
+    close(sock);
+    sock = -1;
+  }
+
+  return sock;
+}
+
+static bool is_stopped(volatile sig_atomic_t const* stop)
+{
+  return stop!=NULL && *stop!=0;
+}
+
+// Sleeps until spin_ns before the deadline, then spins up to it
+static void wait_until(uint64_t deadline_ns, uint64_t spin_ns, volatile sig_atomic_t const* stop)
+{
+  if (deadline_ns > monotonic_ns() + spin_ns)
+  {
+    struct timespec wake = ns_to_timespec(deadline_ns - spin_ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR
+           && !is_stopped(stop))
+      ;
+  }
+
+  while (monotonic_ns() < deadline_ns && !is_stopped(stop))
+    ;
+}
+
+static bool write_frame(int sock, replay_frame_s const* frame, volatile sig_atomic_t const* stop)
+{
+  size_t size = (frame->flags & REPLAY_FRAME_FD) ? CANFD_MTU : CAN_MTU;
+
+  // A full interface queue is back pressure, not an error
+  while (write(sock, &frame->frame, size) != (ssize_t) size)
+  {
+    if ((errno!=ENOBUFS && errno!=EAGAIN) || is_stopped(stop))
+      return false;
+
+    struct timespec retry = ns_to_timespec(WRITE_RETRY_NS);
+    nanosleep(&retry, NULL);
+  }
+
+  return true;
+}
+
+oscc_result_t replay_run(replay_log_s const* log,
+                         replay_config_s const* config,
+                         replay_stats_s* stats,
+                         volatile sig_atomic_t const* stop)
+{
+  oscc_result_t result = OSCC_OK;
+  int sockets[REPLAY_MAX_CHANNELS];
+  replay_stats_s run_stats;
+
+  memset(&run_stats, 0, sizeof(run_stats));
+
+  if (log==NULL || config==NULL || config->speed<0.0)
+    return OSCC_ERROR;
+
+  for (size_t i=0; i<REPLAY_MAX_CHANNELS; ++i)
+    sockets[i] = -1;
+
+  // Only channels that have frames to send need an interface
+  for (size_t i=0; i<log->frame_count && result==OSCC_OK; ++i)
+  {
+    replay_frame_s const* frame = &log->frames[i];
+    if (sockets[frame->channel]>=0 || ((frame->flags & REPLAY_FRAME_TX) && !config->include_tx))
+      continue;
+
+    const char* target = config->targets[frame->channel] != NULL
+                         ? config->targets[frame->channel]
+                         : log->channels[frame->channel];
+    sockets[frame->channel] = open_replay_socket(target);
+    if (sockets[frame->channel] < 0)
+      result = OSCC_ERROR;
+  }
+
+  uint64_t spin_ns = (uint64_t) config->spin_us * 1000ULL;
+  uint64_t start_ns = monotonic_ns();
+  uint64_t first_timestamp_ns = 0;
+  uint64_t last_sent_ns = start_ns;
+  bool started = false;
+  double error_m2 = 0.0;
+
+  for (size_t i=0; i<log->frame_count && result==OSCC_OK && !is_stopped(stop); ++i)
+  {
+    replay_frame_s const* frame = &log->frames[i];
+
+    if ((frame->flags & REPLAY_FRAME_TX) && !config->include_tx)
+    {
+      ++run_stats.frames_skipped;
+      continue;
+    }
+
+    if (!started)
+    {
+      first_timestamp_ns = frame->timestamp_ns;
+      start_ns = monotonic_ns();
+      started = true;
+    }
+
+    uint64_t deadline_ns = start_ns;
+    if (config->speed > 0.0)
+    {
+      deadline_ns += (uint64_t) ((double) (frame->timestamp_ns - first_timestamp_ns) / config->speed);
+      wait_until(deadline_ns, spin_ns, stop);
+      if (is_stopped(stop))
+        break;
+    }
+
+    if (!write_frame(sockets[frame->channel], frame, stop))
+    {
+      if (!is_stopped(stop))
+      {
+        perror("Writing replayed frame failed:");
+        result = OSCC_ERROR;
+      }
+      break;
+    }
+
+    last_sent_ns = monotonic_ns();
+    ++run_stats.frames_sent;
+
+    // As fast as possible has no deadlines to miss
+    if (config->speed > 0.0)
+    {
+      double error = (double) ((int64_t) (last_sent_ns - deadline_ns)) / 1000.0;
+
+      // Welford's running mean and variance of the timing error
+      double delta = error - run_stats.error_mean_us;
+      run_stats.error_mean_us += delta / run_stats.frames_sent;
+      error_m2 += delta * (error - run_stats.error_mean_us);
+
+      if (error > run_stats.error_max_us)
+        run_stats.error_max_us = error;
+      if (error > REPLAY_LATE_THRESHOLD_US)
+        ++run_stats.frames_late;
+    }
+  }
+
+  for (size_t i=0; i<REPLAY_MAX_CHANNELS; ++i)
+  {
+    if (sockets[i] >= 0)
+      close(sockets[i]);
+  }
+
+  if (run_stats.frames_sent > 0)
+  {
+    run_stats.duration_s = (double) (last_sent_ns - start_ns) / 1e9;
+    run_stats.error_stddev_us = sqrt(error_m2 / run_stats.frames_sent);
+  }
+
+  if (stats != NULL)
+    *stats = run_stats;
+
+  return result;
+}
+
+void replay_print_stats(replay_stats_s const* stats)
+{
+  if (stats == NULL)
+    return;
+
+  printf("replay: sent=%llu skipped=%llu late=%llu duration s=%.3f "
+         "error us mean=%.1f stddev=%.1f max=%.1f\n",
+         stats->frames_sent,
+         stats->frames_skipped,
+         stats->frames_late,
+         stats->duration_s,
+         stats->error_mean_us,
+         stats->error_stddev_us,
+         stats->error_max_us);
+}
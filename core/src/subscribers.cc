@@ -0,0 +1,524 @@
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "core/include/oscc.h"
+#include "internal/dispatch.h"
+#include "internal/subscribers.h"
+
+// Subscription handles pack the slot generation above the list and slot index
+#define SUBSCRIPTION_SLOT_BITS 6
+#define SUBSCRIPTION_TYPE_BITS 3
+#define SUBSCRIPTION_INDEX_BITS ( SUBSCRIPTION_SLOT_BITS + SUBSCRIPTION_TYPE_BITS )
+#define SUBSCRIPTION_GENERATION_MASK ( 0xFFFFFFFFu >> SUBSCRIPTION_INDEX_BITS )
+
+// Writers yield between attempts; readers may run in a signal handler and
+// only retry a few times before skipping the slot
+#define SLOT_WRITE_ATTEMPTS 1000
+#define SLOT_READ_ATTEMPTS 4
+
+static_assert(OSCC_MAX_SUBSCRIBERS <= (1 << SUBSCRIPTION_SLOT_BITS),
+              "subscriber slot index does not fit in a subscription handle");
+static_assert(OSCC_MAX_CAN_ID_SUBSCRIBERS <= (1 << SUBSCRIPTION_SLOT_BITS),
+              "per-ID subscriber node index does not fit in a subscription handle");
+static_assert(OSCC_SUBSCRIBER_CAN_ID < (1 << SUBSCRIPTION_TYPE_BITS),
+              "subscriber type does not fit in a subscription handle");
+static_assert(ATOMIC_POINTER_LOCK_FREE == 2,
+              "subscriber slots must be lock-free to be read from a signal handler");
+
+// Zero initialised: every slot starts empty at generation 0
+static subscriber_list_s global_subscribers[OSCC_SUBSCRIBER_TYPE_COUNT];
+
+typedef void (*brake_report_handler_t)(oscc_brake_report_s*, oscc_frame_meta_s const*, void*);
+typedef void (*throttle_report_handler_t)(oscc_throttle_report_s*, oscc_frame_meta_s const*, void*);
+typedef void (*steering_report_handler_t)(oscc_steering_report_s*, oscc_frame_meta_s const*, void*);
+typedef void (*fault_report_handler_t)(oscc_fault_report_s*, oscc_frame_meta_s const*, void*);
+typedef void (*obd_frame_handler_t)(struct canfd_frame*, oscc_frame_meta_s const*, void*);
+
+oscc_subscription_t oscc_make_subscription(oscc_subscriber_type_t type,
+                                           size_t slot_index,
+                                           uint32_t generation)
+{
+  return ((generation & SUBSCRIPTION_GENERATION_MASK) << SUBSCRIPTION_INDEX_BITS)
+         | ((uint32_t)type << SUBSCRIPTION_SLOT_BITS)
+         | (uint32_t)slot_index;
+}
+
+// Starts rewriting a slot; fails if another writer got there first
+static bool begin_slot_write(subscriber_slot_s* slot, uint32_t* sequence)
+{
+  *sequence = slot->sequence.load(std::memory_order_relaxed);
+
+  return (*sequence & 1) == 0
+         && slot->sequence.compare_exchange_strong(*sequence,
+                                                   *sequence + 1,
+                                                   std::memory_order_acquire);
+}
+
+static uint32_t end_slot_write(subscriber_slot_s* slot, uint32_t sequence)
+{
+  slot->sequence.store(sequence + 2, std::memory_order_release);
+  return (sequence + 2) / 2;
+}
+
+uint32_t oscc_subscriber_slot_claim(subscriber_slot_s* slot,
+                                    oscc_subscriber_fn_t handler,
+                                    void* user_data)
+{
+  uint32_t generation = 0;
+  uint32_t sequence = 0;
+
+  if (slot->handler.load(std::memory_order_relaxed) == NULL
+      && begin_slot_write(slot, &sequence))
+  {
+    // Another writer may have filled the slot between the check and the claim
+    if (slot->handler.load(std::memory_order_relaxed) == NULL)
+    {
+      slot->user_data.store(user_data, std::memory_order_relaxed);
+      slot->handler.store(handler, std::memory_order_relaxed);
+      generation = end_slot_write(slot, sequence);
+    }
+    else
+      slot->sequence.store(sequence, std::memory_order_release);
+  }
+
+  return generation;
+}
+
+uint32_t oscc_subscriber_slot_set(subscriber_slot_s* slot,
+                                  oscc_subscriber_fn_t handler,
+                                  void* user_data)
+{
+  uint32_t sequence = 0;
+
+  // The writer holding the slot may be the context a signal handler
+  // interrupted, so give up rather than spin forever
+  for (int attempt = 0; attempt < SLOT_WRITE_ATTEMPTS; ++attempt)
+  {
+    if (begin_slot_write(slot, &sequence))
+    {
+      slot->user_data.store(user_data, std::memory_order_relaxed);
+      slot->handler.store(handler, std::memory_order_relaxed);
+
+      return end_slot_write(slot, sequence);
+    }
+
+    sched_yield();
+  }
+
+  return 0;
+}
+
+oscc_result_t oscc_subscriber_slot_remove(subscriber_slot_s* slot, uint32_t generation)
+{
+  oscc_result_t result = OSCC_ERROR;
+  uint32_t sequence = 0;
+
+  // A stale handle must not remove whoever reused the slot
+  if (begin_slot_write(slot, &sequence))
+  {
+    bool current = ((sequence / 2) & SUBSCRIPTION_GENERATION_MASK) == generation
+                   && slot->handler.load(std::memory_order_relaxed) != NULL;
+
+    if (current)
+    {
+      slot->handler.store(NULL, std::memory_order_relaxed);
+      slot->user_data.store(NULL, std::memory_order_relaxed);
+      end_slot_write(slot, sequence);
+      result = OSCC_OK;
+    }
+    else
+      slot->sequence.store(sequence, std::memory_order_release);
+  }
+
+  return result;
+}
+
+bool oscc_subscriber_slot_read(subscriber_slot_s* slot,
+                               oscc_subscriber_fn_t* handler,
+                               void** user_data)
+{
+  for (int attempt = 0; attempt < SLOT_READ_ATTEMPTS; ++attempt)
+  {
+    uint32_t before = slot->sequence.load(std::memory_order_acquire);
+
+    if ((before & 1) == 0)
+    {
+      *handler = slot->handler.load(std::memory_order_relaxed);
+      *user_data = slot->user_data.load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (slot->sequence.load(std::memory_order_relaxed) == before)
+        return *handler != NULL;
+    }
+  }
+
+  // Never block the receive path: a write that outlasts the retries, such as
+  // one this signal handler interrupted, costs the slot this frame
+  return false;
+}
+
+// Raised after the slot is published, so dispatch never skips a subscriber
+static void mark_slot_used(subscriber_list_s* list, size_t slot_index)
+{
+  uint32_t used = list->slots_used.load(std::memory_order_relaxed);
+
+  while (used < slot_index+1
+         && !list->slots_used.compare_exchange_weak(used,
+                                                    slot_index+1,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed))
+    ;
+}
+
+static oscc_subscription_t add_subscriber(oscc_subscriber_type_t type,
+                                          oscc_subscriber_fn_t handler,
+                                          void* user_data)
+{
+  oscc_subscription_t subscription = OSCC_INVALID_SUBSCRIPTION;
+
+  for (size_t i=OSCC_RESERVED_SLOT_COUNT;
+       i<OSCC_MAX_SUBSCRIBERS && handler!=NULL && subscription==OSCC_INVALID_SUBSCRIPTION;
+       ++i)
+  {
+    uint32_t generation = oscc_subscriber_slot_claim(&global_subscribers[type].slots[i],
+                                                     handler,
+                                                     user_data);
+    if (generation != 0)
+    {
+      mark_slot_used(&global_subscribers[type], i);
+      subscription = oscc_make_subscription(type, i, generation);
+    }
+  }
+
+  if (handler!=NULL && subscription==OSCC_INVALID_SUBSCRIPTION)
+    printf("Error: No free subscriber slot left\n");
+
+  return subscription;
+}
+
+static oscc_result_t set_legacy_subscriber(oscc_subscriber_type_t type,
+                                           size_t slot_index,
+                                           oscc_subscriber_fn_t handler,
+                                           void* callback)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  if (callback != NULL)
+  {
+    if (oscc_subscriber_slot_set(&global_subscribers[type].slots[slot_index], handler, callback) != 0)
+    {
+      mark_slot_used(&global_subscribers[type], slot_index);
+      result = OSCC_OK;
+    }
+  }
+
+  return result;
+}
+
+/*****************************************************************************/
+// Subscription
+/*****************************************************************************/
+
+oscc_subscription_t oscc_add_brake_report_subscriber(
+  void(*handler)(oscc_brake_report_s* report, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  return add_subscriber(OSCC_SUBSCRIBER_BRAKE_REPORT,
+                        reinterpret_cast<oscc_subscriber_fn_t>(handler),
+                        user_data);
+}
+
+oscc_subscription_t oscc_add_throttle_report_subscriber(
+  void(*handler)(oscc_throttle_report_s* report, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  return add_subscriber(OSCC_SUBSCRIBER_THROTTLE_REPORT,
+                        reinterpret_cast<oscc_subscriber_fn_t>(handler),
+                        user_data);
+}
+
+oscc_subscription_t oscc_add_steering_report_subscriber(
+  void(*handler)(oscc_steering_report_s* report, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  return add_subscriber(OSCC_SUBSCRIBER_STEERING_REPORT,
+                        reinterpret_cast<oscc_subscriber_fn_t>(handler),
+                        user_data);
+}
+
+oscc_subscription_t oscc_add_fault_report_subscriber(
+  void(*handler)(oscc_fault_report_s* report, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  return add_subscriber(OSCC_SUBSCRIBER_FAULT_REPORT,
+                        reinterpret_cast<oscc_subscriber_fn_t>(handler),
+                        user_data);
+}
+
+oscc_subscription_t oscc_add_obd_subscriber(
+  void(*handler)(struct canfd_frame* frame, oscc_frame_meta_s const* meta, void* user_data),
+  void* user_data)
+{
+  return add_subscriber(OSCC_SUBSCRIBER_OBD_FRAME,
+                        reinterpret_cast<oscc_subscriber_fn_t>(handler),
+                        user_data);
+}
+
+oscc_result_t oscc_unsubscribe(oscc_subscription_t subscription)
+{
+  oscc_result_t result = OSCC_ERROR;
+
+  size_t slot_index = subscription & ((1u << SUBSCRIPTION_SLOT_BITS) - 1);
+  uint32_t type = (subscription >> SUBSCRIPTION_SLOT_BITS)
+                  & ((1u << SUBSCRIPTION_TYPE_BITS) - 1);
+  uint32_t generation = subscription >> SUBSCRIPTION_INDEX_BITS;
+
+  if (subscription == OSCC_INVALID_SUBSCRIPTION)
+    result = OSCC_ERROR;
+  else if (type == OSCC_SUBSCRIBER_CAN_ID)
+    result = oscc_dispatch_remove_subscriber(slot_index, generation);
+  else if (type < OSCC_SUBSCRIBER_TYPE_COUNT
+           && slot_index >= OSCC_RESERVED_SLOT_COUNT
+           && slot_index < OSCC_MAX_SUBSCRIBERS)
+  {
+    result = oscc_subscriber_slot_remove(&global_subscribers[type].slots[slot_index],
+                                         generation);
+  }
+
+  return result;
+}
+
+/*****************************************************************************/
+// Single-callback subscription
+/*****************************************************************************/
+
+// The single-callback functions keep their replace-on-subscribe behaviour by
+// owning reserved slots. The slot's user data is the callback itself, called
+// through an adapter with the registry handler signature.
+
+static void legacy_brake_report(oscc_brake_report_s* report,
+                                oscc_frame_meta_s const*,
+                                void* callback)
+{
+  reinterpret_cast<void(*)(oscc_brake_report_s*)>(callback)(report);
+}
+
+static void legacy_throttle_report(oscc_throttle_report_s* report,
+                                   oscc_frame_meta_s const*,
+                                   void* callback)
+{
+  reinterpret_cast<void(*)(oscc_throttle_report_s*)>(callback)(report);
+}
+
+static void legacy_steering_report(oscc_steering_report_s* report,
+                                   oscc_frame_meta_s const*,
+                                   void* callback)
+{
+  reinterpret_cast<void(*)(oscc_steering_report_s*)>(callback)(report);
+}
+
+static void legacy_fault_report(oscc_fault_report_s* report,
+                                oscc_frame_meta_s const*,
+                                void* callback)
+{
+  reinterpret_cast<void(*)(oscc_fault_report_s*)>(callback)(report);
+}
+
+// Classic frame callbacks only see frames whose payload fits in 8 bytes. A
+// canfd_frame starts with the same layout as a can_frame, so that is a cast.
+static void legacy_obd_frame(struct canfd_frame* frame,
+                             oscc_frame_meta_s const*,
+                             void* callback)
+{
+  if (frame->len <= CAN_MAX_DLEN)
+    reinterpret_cast<void(*)(struct can_frame*)>(callback)((struct can_frame*) frame);
+}
+
+static void legacy_brake_report_meta(oscc_brake_report_s* report,
+                                     oscc_frame_meta_s const* meta,
+                                     void* callback)
+{
+  reinterpret_cast<void(*)(oscc_brake_report_s*, oscc_frame_meta_s const*)>(callback)(report, meta);
+}
+
+static void legacy_throttle_report_meta(oscc_throttle_report_s* report,
+                                        oscc_frame_meta_s const* meta,
+                                        void* callback)
+{
+  reinterpret_cast<void(*)(oscc_throttle_report_s*, oscc_frame_meta_s const*)>(callback)(report, meta);
+}
+
+static void legacy_steering_report_meta(oscc_steering_report_s* report,
+                                        oscc_frame_meta_s const* meta,
+                                        void* callback)
+{
+  reinterpret_cast<void(*)(oscc_steering_report_s*, oscc_frame_meta_s const*)>(callback)(report, meta);
+}
+
+static void legacy_fault_report_meta(oscc_fault_report_s* report,
+                                     oscc_frame_meta_s const* meta,
+                                     void* callback)
+{
+  reinterpret_cast<void(*)(oscc_fault_report_s*, oscc_frame_meta_s const*)>(callback)(report, meta);
+}
+
+static void legacy_obd_frame_meta(struct canfd_frame* frame,
+                                  oscc_frame_meta_s const* meta,
+                                  void* callback)
+{
+  if (frame->len <= CAN_MAX_DLEN)
+    reinterpret_cast<void(*)(struct can_frame*, oscc_frame_meta_s const*)>(callback)(
+      (struct can_frame*) frame, meta);
+}
+
+static void legacy_obd_fd_frame(struct canfd_frame* frame,
+                                oscc_frame_meta_s const* meta,
+                                void* callback)
+{
+  reinterpret_cast<void(*)(struct canfd_frame*, oscc_frame_meta_s const*)>(callback)(frame, meta);
+}
+
+#define SET_LEGACY_SUBSCRIBER(type, slot, adapter, callback)        \
+  set_legacy_subscriber(type,                                        \
+                        slot,                                        \
+                        reinterpret_cast<oscc_subscriber_fn_t>(adapter), \
+                        reinterpret_cast<void*>(callback))
+
+oscc_result_t oscc_subscribe_to_brake_reports(void(*callback)(oscc_brake_report_s* report))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_BRAKE_REPORT,
+                               OSCC_LEGACY_SLOT,
+                               legacy_brake_report,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_throttle_reports(void(*callback)(oscc_throttle_report_s *report))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_THROTTLE_REPORT,
+                               OSCC_LEGACY_SLOT,
+                               legacy_throttle_report,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_steering_reports(void(*callback)(oscc_steering_report_s *report))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_STEERING_REPORT,
+                               OSCC_LEGACY_SLOT,
+                               legacy_steering_report,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_fault_reports( void (*callback)(oscc_fault_report_s *report))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_FAULT_REPORT,
+                               OSCC_LEGACY_SLOT,
+                               legacy_fault_report,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_obd_messages(void(*callback)(struct can_frame *frame))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_OBD_FRAME,
+                               OSCC_LEGACY_SLOT,
+                               legacy_obd_frame,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_brake_reports_with_meta(
+  void(*callback)(oscc_brake_report_s* report, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_BRAKE_REPORT,
+                               OSCC_LEGACY_META_SLOT,
+                               legacy_brake_report_meta,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_throttle_reports_with_meta(
+  void(*callback)(oscc_throttle_report_s* report, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_THROTTLE_REPORT,
+                               OSCC_LEGACY_META_SLOT,
+                               legacy_throttle_report_meta,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_steering_reports_with_meta(
+  void(*callback)(oscc_steering_report_s* report, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_STEERING_REPORT,
+                               OSCC_LEGACY_META_SLOT,
+                               legacy_steering_report_meta,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_fault_reports_with_meta(
+  void(*callback)(oscc_fault_report_s* report, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_FAULT_REPORT,
+                               OSCC_LEGACY_META_SLOT,
+                               legacy_fault_report_meta,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_obd_messages_with_meta(
+  void(*callback)(struct can_frame* frame, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_OBD_FRAME,
+                               OSCC_LEGACY_META_SLOT,
+                               legacy_obd_frame_meta,
+                               callback);
+}
+
+oscc_result_t oscc_subscribe_to_obd_fd_messages(
+  void(*callback)(struct canfd_frame* frame, oscc_frame_meta_s const* meta))
+{
+  return SET_LEGACY_SUBSCRIBER(OSCC_SUBSCRIBER_OBD_FRAME,
+                               OSCC_LEGACY_FD_SLOT,
+                               legacy_obd_fd_frame,
+                               callback);
+}
+
+/*****************************************************************************/
+// Dispatch
+/*****************************************************************************/
+
+#define NOTIFY_SUBSCRIBERS(type, handler_type, message, meta)                 \
+  do                                                                           \
+  {                                                                            \
+    subscriber_list_s* list = &global_subscribers[type];                       \
+    uint32_t used = list->slots_used.load(std::memory_order_acquire);          \
+    for (size_t i=0; i<used; ++i)                                              \
+    {                                                                          \
+      oscc_subscriber_fn_t handler = NULL;                                     \
+      void* user_data = NULL;                                                  \
+      if (oscc_subscriber_slot_read(&list->slots[i], &handler, &user_data))    \
+        reinterpret_cast<handler_type>(handler)(message, meta, user_data);     \
+    }                                                                          \
+  } while (0)
+
+void oscc_notify_brake_report(oscc_brake_report_s* report, oscc_frame_meta_s const* meta)
+{
+  NOTIFY_SUBSCRIBERS(OSCC_SUBSCRIBER_BRAKE_REPORT, brake_report_handler_t, report, meta);
+}
+
+void oscc_notify_throttle_report(oscc_throttle_report_s* report, oscc_frame_meta_s const* meta)
+{
+  NOTIFY_SUBSCRIBERS(OSCC_SUBSCRIBER_THROTTLE_REPORT, throttle_report_handler_t, report, meta);
+}
+
+void oscc_notify_steering_report(oscc_steering_report_s* report, oscc_frame_meta_s const* meta)
+{
+  NOTIFY_SUBSCRIBERS(OSCC_SUBSCRIBER_STEERING_REPORT, steering_report_handler_t, report, meta);
+}
+
+void oscc_notify_fault_report(oscc_fault_report_s* report, oscc_frame_meta_s const* meta)
+{
+  NOTIFY_SUBSCRIBERS(OSCC_SUBSCRIBER_FAULT_REPORT, fault_report_handler_t, report, meta);
+}
+
+void oscc_notify_obd_frame(struct canfd_frame* frame, oscc_frame_meta_s const* meta)
+{
+  NOTIFY_SUBSCRIBERS(OSCC_SUBSCRIBER_OBD_FRAME, obd_frame_handler_t, frame, meta);
+}
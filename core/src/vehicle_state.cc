@@ -0,0 +1,243 @@
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+#include "core/include/oscc.h"
+#include "core/include/vehicle_state.h"
+#include "internal/dispatch.h"
+#include "internal/oscc.h"
+#include "internal/vehicle_profiles.h"
+#include "internal/vehicle_state.h"
+
+#define STATE_WORD_COUNT ( sizeof(oscc_vehicle_state_s) / sizeof(uint64_t) )
+
+static_assert(sizeof(oscc_vehicle_state_s) % sizeof(uint64_t) == 0,
+              "The vehicle state is published in whole 64-bit words");
+static_assert(std::is_trivially_copyable<oscc_vehicle_state_s>::value,
+              "The vehicle state is published as raw words");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The vehicle state is published from a signal handler");
+
+// Working copy of the state, only touched by the receive path
+static oscc_vehicle_state_s global_vehicle_state;
+
+// Published copy of the state, read word by word under the sequence lock.
+// The sequence is odd while the writer is copying words in.
+static std::atomic<uint64_t> global_published_words[STATE_WORD_COUNT];
+static std::atomic<uint32_t> global_state_sequence(0);
+
+static uint64_t timespec_to_ns(struct timespec const* time)
+{
+  return (uint64_t) time->tv_sec * 1000000000ULL + time->tv_nsec;
+}
+
+// Publishes the changed fields, which lie in the size bytes from first, and
+// the store sequence
+static void publish(void const* first, size_t size)
+{
+  size_t offset = (char const*) first - (char const*) &global_vehicle_state;
+  size_t first_word = offset / sizeof(uint64_t);
+  size_t last_word = (offset + size - 1) / sizeof(uint64_t);
+  size_t sequence_word = offsetof(oscc_vehicle_state_s, sequence) / sizeof(uint64_t);
+  uint64_t words[STATE_WORD_COUNT];
+
+  ++global_vehicle_state.sequence;
+  memcpy(words, &global_vehicle_state, sizeof(words));
+
+  uint32_t sequence = global_state_sequence.load(std::memory_order_relaxed);
+  global_state_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (size_t i=first_word; i<=last_word; ++i)
+    global_published_words[i].store(words[i], std::memory_order_relaxed);
+  global_published_words[sequence_word].store(words[sequence_word], std::memory_order_relaxed);
+
+  global_state_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static void update_signal(oscc_vehicle_signal_s* signal,
+                          double value,
+                          oscc_frame_meta_s const* meta)
+{
+  signal->value = value;
+  signal->timestamp_ns = timespec_to_ns(&meta->dispatch_time);
+  ++signal->sequence;
+}
+
+static void update_module(oscc_module_state_s* module,
+                          bool enabled,
+                          bool operator_override,
+                          uint8_t dtcs,
+                          oscc_frame_meta_s const* meta)
+{
+  module->enabled = enabled;
+  module->operator_override = operator_override;
+  module->dtcs = dtcs;
+  module->timestamp_ns = timespec_to_ns(&meta->dispatch_time);
+  ++module->sequence;
+
+  publish(module, sizeof(*module));
+}
+
+// canfd_frame starts with the same layout as a can_frame, so the decoders
+// take it with a cast
+
+template <oscc_vehicle_t vehicle>
+static void update_wheel_speeds(struct canfd_frame const* frame, oscc_frame_meta_s const* meta)
+{
+  typedef oscc_vehicle_decoder<vehicle> decoder;
+  struct can_frame const* classic = (struct can_frame const*) frame;
+  oscc_vehicle_state_s* state = &global_vehicle_state;
+  double values[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+  if (frame->len > CAN_MAX_DLEN)
+    return;
+
+  if (decoder::wheel_speed(classic, &values[0], 0) != OSCC_OK
+      || decoder::wheel_speed(classic, &values[1], 2) != OSCC_OK
+      || decoder::wheel_speed(classic, &values[2], 4) != OSCC_OK
+      || decoder::wheel_speed(classic, &values[3], 6) != OSCC_OK)
+    return;
+
+  update_signal(&state->wheel_speed_front_left, values[0], meta);
+  update_signal(&state->wheel_speed_front_right, values[1], meta);
+  update_signal(&state->wheel_speed_rear_left, values[2], meta);
+  update_signal(&state->wheel_speed_rear_right, values[3], meta);
+
+  // The four wheel speeds are adjacent
+  publish(&state->wheel_speed_front_left, 4 * sizeof(oscc_vehicle_signal_s));
+}
+
+template <oscc_vehicle_t vehicle>
+static void update_steering_wheel_angle(struct canfd_frame const* frame, oscc_frame_meta_s const* meta)
+{
+  double value = 0.0;
+
+  if (frame->len <= CAN_MAX_DLEN
+      && oscc_vehicle_decoder<vehicle>::steering_wheel_angle((struct can_frame const*) frame, &value) == OSCC_OK)
+  {
+    update_signal(&global_vehicle_state.steering_wheel_angle, value, meta);
+    publish(&global_vehicle_state.steering_wheel_angle, sizeof(oscc_vehicle_signal_s));
+  }
+}
+
+template <oscc_vehicle_t vehicle>
+static void update_brake_pressure(struct canfd_frame const* frame, oscc_frame_meta_s const* meta)
+{
+  double value = 0.0;
+
+  if (frame->len <= CAN_MAX_DLEN
+      && oscc_vehicle_decoder<vehicle>::brake_pressure((struct can_frame const*) frame, &value) == OSCC_OK)
+  {
+    update_signal(&global_vehicle_state.brake_pressure, value, meta);
+    publish(&global_vehicle_state.brake_pressure, sizeof(oscc_vehicle_signal_s));
+  }
+}
+
+template <oscc_vehicle_t vehicle>
+static void update_vehicle_speed(struct canfd_frame const* frame, oscc_frame_meta_s const* meta)
+{
+  double value = 0.0;
+
+  if (frame->len <= CAN_MAX_DLEN
+      && oscc_vehicle_decoder<vehicle>::vehicle_speed((struct can_frame const*) frame, &value) == OSCC_OK)
+  {
+    update_signal(&global_vehicle_state.vehicle_speed, value, meta);
+    publish(&global_vehicle_state.vehicle_speed, sizeof(oscc_vehicle_signal_s));
+  }
+}
+
+template <oscc_vehicle_t vehicle>
+static void install_vehicle_decoders()
+{
+  constexpr oscc_vehicle_profile_s const& profile = oscc_vehicle_profiles[vehicle];
+
+  oscc_dispatch_set_vehicle_decoder(profile.wheel_speed_can_id, update_wheel_speeds<vehicle>);
+  oscc_dispatch_set_vehicle_decoder(profile.steering_wheel_angle_can_id, update_steering_wheel_angle<vehicle>);
+  oscc_dispatch_set_vehicle_decoder(profile.brake_pressure_can_id, update_brake_pressure<vehicle>);
+
+  if constexpr (profile.speed_can_id != OSCC_VEHICLE_NO_CAN_ID)
+    oscc_dispatch_set_vehicle_decoder(profile.speed_can_id, update_vehicle_speed<vehicle>);
+}
+
+void oscc_vehicle_state_init(oscc_vehicle_t vehicle)
+{
+  static void (* const installers[OSCC_VEHICLE_COUNT])() =
+  {
+    install_vehicle_decoders<OSCC_VEHICLE_KIA_SOUL_PETROL>,
+    install_vehicle_decoders<OSCC_VEHICLE_KIA_SOUL_EV>,
+    install_vehicle_decoders<OSCC_VEHICLE_KIA_NIRO>
+  };
+
+  if (vehicle>=0 && vehicle<OSCC_VEHICLE_COUNT)
+    installers[vehicle]();
+}
+
+void oscc_vehicle_state_update_brake(oscc_brake_report_s const* report, oscc_frame_meta_s const* meta)
+{
+  update_module(&global_vehicle_state.brake,
+                report->enabled != 0,
+                report->operator_override != 0,
+                report->dtcs,
+                meta);
+}
+
+void oscc_vehicle_state_update_throttle(oscc_throttle_report_s const* report, oscc_frame_meta_s const* meta)
+{
+  update_module(&global_vehicle_state.throttle,
+                report->enabled != 0,
+                report->operator_override != 0,
+                report->dtcs,
+                meta);
+}
+
+void oscc_vehicle_state_update_steering(oscc_steering_report_s const* report, oscc_frame_meta_s const* meta)
+{
+  update_module(&global_vehicle_state.steering,
+                report->enabled != 0,
+                report->operator_override != 0,
+                report->dtcs,
+                meta);
+}
+
+void oscc_vehicle_state_update_fault(oscc_fault_report_s const* report, oscc_frame_meta_s const* meta)
+{
+  oscc_module_state_s* module = NULL;
+
+  if (report->fault_origin_id == FAULT_ORIGIN_BRAKE)
+    module = &global_vehicle_state.brake;
+  else if (report->fault_origin_id == FAULT_ORIGIN_STEERING)
+    module = &global_vehicle_state.steering;
+  else if (report->fault_origin_id == FAULT_ORIGIN_THROTTLE)
+    module = &global_vehicle_state.throttle;
+
+  // A module disables itself when it reports a fault
+  if (module != NULL)
+    update_module(module, false, module->operator_override, report->dtcs, meta);
+}
+
+oscc_result_t oscc_get_vehicle_state(oscc_vehicle_state_s* state)
+{
+  if (state == NULL)
+    return OSCC_ERROR;
+
+  uint64_t words[STATE_WORD_COUNT];
+  uint32_t before = 0;
+  uint32_t after = 0;
+
+  do
+  {
+    before = global_state_sequence.load(std::memory_order_acquire);
+
+    for (size_t i=0; i<STATE_WORD_COUNT; ++i)
+      words[i] = global_published_words[i].load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = global_state_sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+
+  memcpy(state, words, sizeof(*state));
+
+  return OSCC_OK;
+}
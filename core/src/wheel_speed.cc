@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "core/include/oscc.h"
+#include "internal/oscc.h"
+#include "internal/vehicle_profiles.h"
+
+// Byte offsets of the wheels in a wheel speed frame
+#define FRONT_LEFT_OFFSET 0
+#define FRONT_RIGHT_OFFSET 2
+#define REAR_LEFT_OFFSET 4
+#define REAR_RIGHT_OFFSET 6
+
+#define WHEEL_SPEED_RAW_MASK 0x0FFF
+#define FRAMES_PER_STEP 4
+
+static inline uint16_t raw_wheel_speed(struct can_frame const* frame, size_t offset)
+{
+  return ((frame->data[offset + 1] & 0x0F) << 8) | frame->data[offset];
+}
+
+static inline bool is_wheel_speed_frame(struct can_frame const* frame, canid_t can_id)
+{
+  return frame->can_id == can_id;
+}
+
+static inline bool are_wheel_speed_frames(struct can_frame const* frames, canid_t can_id)
+{
+  return is_wheel_speed_frame(&frames[0], can_id) & is_wheel_speed_frame(&frames[1], can_id)
+         & is_wheel_speed_frame(&frames[2], can_id) & is_wheel_speed_frame(&frames[3], can_id);
+}
+
+static size_t decode_wheel_speeds_tail(struct can_frame const* frames,
+                                       size_t first,
+                                       size_t count,
+                                       canid_t can_id,
+                                       oscc_wheel_speeds_s const* speeds)
+{
+  size_t i = first;
+
+  for (; i<count && is_wheel_speed_frame(&frames[i], can_id); ++i)
+  {
+    speeds->front_left[i] = oscc_wheel_speed_from_raw(raw_wheel_speed(&frames[i], FRONT_LEFT_OFFSET));
+    speeds->front_right[i] = oscc_wheel_speed_from_raw(raw_wheel_speed(&frames[i], FRONT_RIGHT_OFFSET));
+    speeds->rear_left[i] = oscc_wheel_speed_from_raw(raw_wheel_speed(&frames[i], REAR_LEFT_OFFSET));
+    speeds->rear_right[i] = oscc_wheel_speed_from_raw(raw_wheel_speed(&frames[i], REAR_RIGHT_OFFSET));
+  }
+
+  return i;
+}
+
+size_t oscc_decode_wheel_speeds_scalar(struct can_frame const* frames,
+                                       size_t count,
+                                       canid_t wheel_speed_can_id,
+                                       oscc_wheel_speeds_s const* speeds)
+{
+  return decode_wheel_speeds_tail(frames, 0, count, wheel_speed_can_id, speeds);
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Both SIMD paths load the 4 little-endian 16-bit wheel words of 4 frames and
+ * transpose them so each register holds one wheel of all 4 frames:
+ *
+ *   a  = f0w0 f0w1 f0w2 f0w3 f1w0 f1w1 f1w2 f1w3
+ *   b  = f2w0 f2w1 f2w2 f2w3 f3w0 f3w1 f3w2 f3w3
+ *   lo = f0w0 f1w0 f2w0 f3w0 f0w1 f1w1 f2w1 f3w1
+ *   hi = f0w2 f1w2 f2w2 f3w2 f0w3 f1w3 f2w3 f3w3
+ *
+ * The scaling then repeats the scalar operations lane by lane: divide by 3.2,
+ * truncate to int, divide by 10. Division is correctly rounded in SSE2 and
+ * AVX as in scalar code, so every lane is bit-identical to the scalar path.
+ */
+static inline void transpose_wheel_words(struct can_frame const* frames, __m128i* lo, __m128i* hi)
+{
+  __m128i const mask = _mm_set1_epi16(WHEEL_SPEED_RAW_MASK);
+
+  __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const*) frames[0].data),
+                                 _mm_loadl_epi64((__m128i const*) frames[1].data));
+  __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const*) frames[2].data),
+                                 _mm_loadl_epi64((__m128i const*) frames[3].data));
+
+  __m128i t0 = _mm_unpacklo_epi16(a, b);
+  __m128i t1 = _mm_unpackhi_epi16(a, b);
+
+  *lo = _mm_and_si128(_mm_unpacklo_epi16(t0, t1), mask);
+  *hi = _mm_and_si128(_mm_unpackhi_epi16(t0, t1), mask);
+}
+
+static inline __m128d scale_wheel_speeds_sse2(__m128i raw)
+{
+  __m128d const divisor = _mm_set1_pd(3.2);
+  __m128d const precision = _mm_set1_pd(10.0);
+
+  __m128i truncated = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(raw), divisor));
+  return _mm_div_pd(_mm_cvtepi32_pd(truncated), precision);
+}
+
+// Scales the 4 wheel speeds in the low 64 bits of words and stores them
+static inline void store_wheel_speeds_sse2(__m128i words, double* out)
+{
+  __m128i raw = _mm_unpacklo_epi16(words, _mm_setzero_si128());
+
+  _mm_storeu_pd(out, scale_wheel_speeds_sse2(raw));
+  _mm_storeu_pd(out + 2, scale_wheel_speeds_sse2(_mm_srli_si128(raw, 8)));
+}
+
+size_t oscc_decode_wheel_speeds_sse2(struct can_frame const* frames,
+                                     size_t count,
+                                     canid_t wheel_speed_can_id,
+                                     oscc_wheel_speeds_s const* speeds)
+{
+  size_t i = 0;
+
+  for (; i+FRAMES_PER_STEP<=count && are_wheel_speed_frames(&frames[i], wheel_speed_can_id); i+=FRAMES_PER_STEP)
+  {
+    __m128i lo;
+    __m128i hi;
+    transpose_wheel_words(&frames[i], &lo, &hi);
+
+    store_wheel_speeds_sse2(lo, &speeds->front_left[i]);
+    store_wheel_speeds_sse2(_mm_srli_si128(lo, 8), &speeds->front_right[i]);
+    store_wheel_speeds_sse2(hi, &speeds->rear_left[i]);
+    store_wheel_speeds_sse2(_mm_srli_si128(hi, 8), &speeds->rear_right[i]);
+  }
+
+  return decode_wheel_speeds_tail(frames, i, count, wheel_speed_can_id, speeds);
+}
+
+__attribute__((target("avx")))
+static inline void store_wheel_speeds_avx(__m128i words, double* out)
+{
+  __m256d const divisor = _mm256_set1_pd(3.2);
+  __m256d const precision = _mm256_set1_pd(10.0);
+
+  __m128i raw = _mm_unpacklo_epi16(words, _mm_setzero_si128());
+  __m128i truncated = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(raw), divisor));
+
+  _mm256_storeu_pd(out, _mm256_div_pd(_mm256_cvtepi32_pd(truncated), precision));
+}
+
+__attribute__((target("avx")))
+size_t oscc_decode_wheel_speeds_avx(struct can_frame const* frames,
+                                    size_t count,
+                                    canid_t wheel_speed_can_id,
+                                    oscc_wheel_speeds_s const* speeds)
+{
+  size_t i = 0;
+
+  for (; i+FRAMES_PER_STEP<=count && are_wheel_speed_frames(&frames[i], wheel_speed_can_id); i+=FRAMES_PER_STEP)
+  {
+    __m128i lo;
+    __m128i hi;
+    transpose_wheel_words(&frames[i], &lo, &hi);
+
+    store_wheel_speeds_avx(lo, &speeds->front_left[i]);
+    store_wheel_speeds_avx(_mm_srli_si128(lo, 8), &speeds->front_right[i]);
+    store_wheel_speeds_avx(hi, &speeds->rear_left[i]);
+    store_wheel_speeds_avx(_mm_srli_si128(hi, 8), &speeds->rear_right[i]);
+  }
+
+  return decode_wheel_speeds_tail(frames, i, count, wheel_speed_can_id, speeds);
+}
+
+#endif
+
+oscc_result_t get_wheel_speeds(struct can_frame const* frames,
+                               size_t count,
+                               oscc_wheel_speeds_s const* speeds)
+{
+  if (frames==NULL || speeds==NULL
+      || speeds->front_left==NULL || speeds->front_right==NULL
+      || speeds->rear_left==NULL || speeds->rear_right==NULL)
+    return OSCC_ERROR;
+
+  size_t decoded = 0;
+  canid_t can_id = oscc_vehicle_profile()->wheel_speed_can_id;
+
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx"))
+    decoded = oscc_decode_wheel_speeds_avx(frames, count, can_id, speeds);
+  else
+    decoded = oscc_decode_wheel_speeds_sse2(frames, count, can_id, speeds);
+#else
+  decoded = oscc_decode_wheel_speeds_scalar(frames, count, can_id, speeds);
+#endif
+
+  return decoded == count ? OSCC_OK : OSCC_ERROR;
+}
@@ -2,35 +2,21 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
 #include <sys/time.h>
 #include <fcntl.h>
 
 #include "oscc.h"
+#include "periodic_executor.h"
 #include "commander.h"
 #include "can_protocols/steering_can_protocol.h"
 // #include "can_protocols/steering_can_protocol.h"
 
 #define COMMANDER_UPDATE_INTERVAL_MICRO 50000
-#define SLEEP_TICK_INTERVAL_MICRO 1000
 
 extern int g_channel;
-static int error_thrown = OSCC_OK;
-extern double g_steering_angle;
-
-static unsigned long long get_timestamp_micro()
-{
-  struct timeval time;
-  gettimeofday( &time, NULL );
-  return ( time.tv_usec );
-}
-
-static unsigned long long get_elapsed_time( unsigned long long timestamp )
-{
-  unsigned long long now = get_timestamp_micro( );
-  unsigned long long elapsed_time = now - timestamp;
-  return elapsed_time;
-}
+static volatile sig_atomic_t error_thrown = OSCC_OK;
 
 void signal_handler(int signal_number)
 {
@@ -38,23 +24,32 @@ void signal_handler(int signal_number)
     error_thrown = OSCC_ERROR;
 }
 
+static oscc_result_t controller_update_task(void* user_data)
+{
+  (void)user_data;
+  return check_for_controller_update();
+}
+
 int main(int argc, char** argv)
 {
   oscc_result_t ret = OSCC_OK;
-  unsigned long long update_timestamp = get_timestamp_micro();
-  unsigned long long elapsed_time = 0;
   int channel;
   errno = 0;
 
-  if (argc!=2 || (channel=atoi(argv[1]), errno)!=0)
+  if (argc<2 || argc>3 || (channel=atoi(argv[1]), errno)!=0)
   {
-    printf("usage %s channel\n", argv[0]);
+    printf("usage %s channel [kia_niro|kia_soul_ev|kia_soul_petrol]\n", argv[0]);
     exit(1);
   }
 
+  if (argc==3 && oscc_select_vehicle_by_name(argv[2])!=OSCC_OK)
+    exit(1);
+
   g_channel = channel;
 
   struct sigaction sig;
+  memset(&sig, 0, sizeof(sig));
+  sigemptyset(&sig.sa_mask);
   sig.sa_handler = signal_handler;
   sigaction(SIGINT, &sig, NULL);
   ret = commander_init(channel);
@@ -68,17 +63,17 @@ int main(int argc, char** argv)
     printf("    RIGHT TRIGGER - Throttle\n");
     printf("    LEFT STICK - Steering\n");
 
-    while (ret==OSCC_OK && error_thrown==OSCC_OK)
+    // One wakeup per control cycle, on absolute deadlines
+    periodic_executor_s executor;
+    ret = periodic_executor_init(&executor, COMMANDER_UPDATE_INTERVAL_MICRO);
+    if (ret == OSCC_OK)
     {
-      elapsed_time = get_elapsed_time(update_timestamp);
-      if (elapsed_time > COMMANDER_UPDATE_INTERVAL_MICRO)
-      {
-        update_timestamp = get_timestamp_micro();
-        ret = check_for_controller_update();
-      }
-
-      // Delay 1 ms to avoid loading the CPU
-      (void)usleep(SLEEP_TICK_INTERVAL_MICRO);
+      ret = periodic_executor_run(&executor,
+                                  controller_update_task,
+                                  NULL,
+                                  &error_thrown           );
+      periodic_executor_print_stats(&executor, "Control loop");
+      periodic_executor_close(&executor);
     }
     commander_close(channel);
   }
@@ -38,9 +38,6 @@
 
 static int commander_enabled = COMMANDER_DISABLED;
 static bool control_enabled = false;
-static double curr_angle = 0.0;
-double g_steering_angle = 0.0;
-double g_brake_pressure = 0.0;
 
 static oscc_result_t get_normalized_position(SDL_GameControllerAxis, 
                                              double* const normalized_position);
@@ -49,9 +46,18 @@ static oscc_result_t commander_disable_controls();
 static oscc_result_t commander_enable_controls();
 static oscc_result_t get_button(SDL_GameControllerButton button, 
                                 unsigned int* const state       );
-static oscc_result_t command_brakes();
-static oscc_result_t command_throttle();
-static oscc_result_t command_steering();
+static oscc_result_t command_brakes(double* const brake_position,
+                                    bool* const publish_brake     );
+static oscc_result_t command_throttle(double* const throttle_position,
+                                      bool* const publish_throttle     );
+static oscc_result_t command_steering(double* const steering_torque,
+                                      bool* const publish_steering   );
+static oscc_result_t publish_commands(double brake_position,
+                                      bool publish_brake,
+                                      double throttle_position,
+                                      bool publish_throttle,
+                                      double steering_torque,
+                                      bool publish_steering    );
 static void brake_callback(oscc_brake_report_s *report);
 static void throttle_callback(oscc_throttle_report_s* report);
 static void steering_callback(oscc_steering_report_s* report);
@@ -142,11 +148,22 @@ oscc_result_t check_for_controller_update()
 
   if (return_code == OSCC_OK)
   {
-    return_code = command_brakes();
+    double brake_position = 0.0;
+    double throttle_position = 0.0;
+    double steering_torque = 0.0;
+    bool publish_brake = false;
+    bool publish_throttle = false;
+    bool publish_steering = false;
+
+    return_code = command_brakes(&brake_position, &publish_brake);
     if (return_code == OSCC_OK)
-      return_code = command_throttle();
+      return_code = command_throttle(&throttle_position, &publish_throttle);
     if (return_code == OSCC_OK)
-      return_code = command_steering();
+      return_code = command_steering(&steering_torque, &publish_steering);
+    if (return_code == OSCC_OK)
+      return_code = publish_commands(brake_position, publish_brake,
+                                     throttle_position, publish_throttle,
+                                     steering_torque, publish_steering   );
   }
 
   return return_code;
@@ -251,7 +268,8 @@ static oscc_result_t get_button(SDL_GameControllerButton button, unsigned int* c
 
 // Since the OSCC API requires a normalized value, we will read in and
 // normalize a value from the game pad, using that as our requested brake position.
-static oscc_result_t command_brakes()
+static oscc_result_t command_brakes(double* const brake_position,
+                                    bool* const publish_brake     )
 {
   oscc_result_t return_code = OSCC_ERROR;
   static double average = 0.0;
@@ -265,7 +283,7 @@ static oscc_result_t command_brakes()
                                           normalized_position, 
                                           BRAKE_FILTER_FACTOR  );
       // printf("Brake: %f ", average);
-      return_code = oscc_publish_brake_position( average );
+      *publish_brake = true;
     }
   }
   else
@@ -273,13 +291,15 @@ static oscc_result_t command_brakes()
     average = 0.0;
     return_code = OSCC_OK;
   }
+  *brake_position = average;
   return return_code;
 }
 
 // For the throttle command, we want to send a normalized position based on the
 // throttle position trigger. We also don't want to send throttle commands if
 // we are currently braking.
-static oscc_result_t command_throttle()
+static oscc_result_t command_throttle(double* const throttle_position,
+                                      bool* const publish_throttle     )
 {
   oscc_result_t return_code = OSCC_ERROR;
   static double average = 0.0;
@@ -304,7 +324,7 @@ static oscc_result_t command_throttle()
                                          normalized_throttle_position, 
                                          THROTTLE_FILTER_FACTOR        );
       // printf("Throttle: %f ", average);
-      return_code = oscc_publish_throttle_position( average );
+      *publish_throttle = true;
     }
   }
   else
@@ -312,6 +332,7 @@ static oscc_result_t command_throttle()
     average = 0.0;
     return_code = OSCC_OK;
   }
+  *throttle_position = average;
   return return_code;
 }
 
@@ -319,7 +340,8 @@ static oscc_result_t command_throttle()
 // the game controller. Since the car will fault if it detects too much discontinuity
 // between spoofed output signals, we use an exponential average filter to smooth
 // our output.
-static oscc_result_t command_steering()
+static oscc_result_t command_steering(double* const steering_torque,
+                                      bool* const publish_steering   )
 {
   oscc_result_t return_code = OSCC_ERROR;
   static double average = 0.0;
@@ -333,9 +355,7 @@ static oscc_result_t command_steering()
                                           normalized_position, 
                                           STEERING_FILTER_FACTOR );
       // printf("Steering: %f\n", average);
-
-      // use only 20% of allowable range for controllability
-      return_code = oscc_publish_steering_torque( average * STEERING_RANGE_PERCENTAGE );
+      *publish_steering = true;
     }
   }
   else
@@ -343,6 +363,42 @@ static oscc_result_t command_steering()
     average = 0.0;
     return_code = OSCC_OK;
   }
+  // use only 20% of allowable range for controllability
+  *steering_torque = average * STEERING_RANGE_PERCENTAGE;
+  return return_code;
+}
+
+// All three commands go out in one syscall so the modules see them
+// back-to-back instead of skewed by three separate writes. A command whose
+// input was not read this cycle is not sent, so then the others go out one
+// at a time.
+static oscc_result_t publish_commands(double brake_position,
+                                      bool publish_brake,
+                                      double throttle_position,
+                                      bool publish_throttle,
+                                      double steering_torque,
+                                      bool publish_steering    )
+{
+  oscc_result_t return_code = OSCC_OK;
+  if (!publish_brake || !publish_throttle || !publish_steering)
+  {
+    if (publish_brake)
+      return_code = oscc_publish_brake_position(brake_position);
+    if (return_code==OSCC_OK && publish_throttle)
+      return_code = oscc_publish_throttle_position(throttle_position);
+    if (return_code==OSCC_OK && publish_steering)
+      return_code = oscc_publish_steering_torque(steering_torque);
+  }
+  else
+  {
+    unsigned int frames_sent = 0;
+    return_code = oscc_publish_commands(brake_position,
+                                        throttle_position,
+                                        steering_torque,
+                                        &frames_sent       );
+    if (return_code == OSCC_WARNING)
+      printf("Only %u of 3 commands were sent\n", frames_sent);
+  }
   return return_code;
 }
 
@@ -393,24 +449,19 @@ static void fault_callback(oscc_fault_report_s* report)
 }
 
 // To cast specific OBD messages, you need to know the structure of the
-// data fields and the CAN_ID.
+// data fields and the CAN_ID. Other threads read the decoded values with
+// oscc_get_vehicle_state instead.
 static void obd_callback(struct can_frame* frame)
 {
-  if (frame->can_id == KIA_SOUL_OBD_STEERING_WHEEL_ANGLE_CAN_ID)
-  {
-    kia_soul_obd_steering_wheel_angle_data_s* steering_data = (kia_soul_obd_steering_wheel_angle_data_s*)frame->data;     
-    curr_angle = steering_data->steering_wheel_angle*KIA_SOUL_OBD_STEERING_ANGLE_SCALAR;
-    g_steering_angle = curr_angle;
-    printf ("Steering Angle: floats: %4.2f, ", g_steering_angle);
-  }
-  else if (frame->can_id == KIA_SOUL_OBD_BRAKE_PRESSURE_CAN_ID) 
-  {
-    double scale = 40.0;
-    uint16_t raw = ((frame->data[4] & 0x0F) << 8) | frame->data[3];
-    // double brake_pressure;
-    g_brake_pressure = (double)raw/scale;
-    printf ("Brake Pressure: floats: %4.2f \n", g_brake_pressure);
-  }
+  double steering_angle = 0.0;
+  double brake_pressure = 0.0;
+
+  // The getter negates the angle to the library's sign convention; the
+  // commander has always printed it with the sign of the frame
+  if (get_steering_wheel_angle(frame, &steering_angle) == OSCC_OK)
+    printf ("Steering Angle: floats: %4.2f, ", -steering_angle);
+  else if (get_brake_pressure(frame, &brake_pressure) == OSCC_OK)
+    printf ("Brake Pressure: floats: %4.2f \n", brake_pressure);
 }
 
 static double calc_exponential_average(double average, double setpoint, double factor)
@@ -1,7 +1,5 @@
 
-# Set MACROs for NIRO
+# Shared compiler options. The vehicle is selected at run time with
+# oscc_select_vehicle(), so no vehicle macros are needed.
 
-COPTS = [      
-  "-DKIA_NIRO",
-  "-DVEHICLE=kia_niro",
-]
\ No newline at end of file
+COPTS = []
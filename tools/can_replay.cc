@@ -0,0 +1,135 @@
+/**
+ * @file can_replay.cc
+ * @brief Replays a recorder file or a candump log onto CAN interfaces,
+ *        usually vcan, and reports how closely it kept the timing.
+ *
+ * Usage: can_replay [-s speed | -f] [-p spin_us] [-t] [-m channel=interface]... <log>
+ *
+ *   -s speed  Replay speed, e.g. 10 for ten times faster (default 1)
+ *   -f        Send as fast as the interfaces accept frames
+ *   -p spin   Time to spin before each deadline (default 200 us)
+ *   -t        Also send the frames the recording library wrote
+ *   -m        Send a log channel on another interface, e.g. -m can0=vcan0.
+ *             Recorder files without interface names call their channels
+ *             "oscc" and "vehicle".
+ *
+ * Unmapped channels are sent on the interface named in the log.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/include/oscc.h"
+#include "core/include/replay.h"
+
+static volatile sig_atomic_t global_stop = 0;
+
+static void signal_handler(int signal_number)
+{
+  if (signal_number == SIGINT || signal_number == SIGTERM)
+    global_stop = 1;
+}
+
+static void print_usage(const char* program)
+{
+  printf("Usage: %s [-s speed | -f] [-p spin_us] [-t] [-m channel=interface]... <log>\n",
+         program);
+}
+
+int main(int argc, char** argv)
+{
+  replay_config_s config;
+  replay_default_config(&config);
+
+  const char* mappings[REPLAY_MAX_CHANNELS];
+  size_t mapping_count = 0;
+  int option = 0;
+
+  while ((option = getopt(argc, argv, "s:fp:tm:")) != -1)
+  {
+    if (option == 's')
+    {
+      config.speed = strtod(optarg, NULL);
+      if (config.speed <= 0.0)
+      {
+        printf("Error: Speed must be positive, use -f to send as fast as possible\n");
+        return 1;
+      }
+    }
+    else if (option == 'f')
+      config.speed = 0.0;
+    else if (option == 'p')
+      config.spin_us = strtoul(optarg, NULL, 10);
+    else if (option == 't')
+      config.include_tx = true;
+    else if (option=='m' && mapping_count<REPLAY_MAX_CHANNELS)
+      mappings[mapping_count++] = optarg;
+    else
+    {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  replay_log_s log;
+  if (replay_load(&log, argv[optind]) != OSCC_OK)
+    return 1;
+
+  char targets[REPLAY_MAX_CHANNELS][IFNAMSIZ];
+
+  for (size_t m=0; m<mapping_count; ++m)
+  {
+    const char* separator = strchr(mappings[m], '=');
+    bool mapped = false;
+
+    for (size_t c=0; separator!=NULL && c<log.channel_count; ++c)
+    {
+      size_t length = separator - mappings[m];
+      if (length==strlen(log.channels[c]) && strncmp(mappings[m], log.channels[c], length)==0)
+      {
+        memset(targets[c], 0, IFNAMSIZ);
+        snprintf(targets[c], IFNAMSIZ, "%s", separator + 1);
+        config.targets[c] = targets[c];
+        mapped = true;
+      }
+    }
+
+    if (!mapped)
+    {
+      printf("Error: %s does not name a channel of the log\n", mappings[m]);
+      replay_free(&log);
+      return 1;
+    }
+  }
+
+  printf("Replaying %zu frames", log.frame_count);
+  for (size_t c=0; c<log.channel_count; ++c)
+    printf(", %s on %s", log.channels[c], config.targets[c]!=NULL ? config.targets[c] : log.channels[c]);
+  if (config.speed > 0.0)
+    printf(" at %gx\n", config.speed);
+  else
+    printf(" as fast as possible\n");
+
+  struct sigaction sig;
+  memset(&sig, 0, sizeof(sig));
+  sig.sa_handler = signal_handler;
+  sigaction(SIGINT, &sig, NULL);
+  sigaction(SIGTERM, &sig, NULL);
+
+  replay_stats_s stats;
+  oscc_result_t result = replay_run(&log, &config, &stats, &global_stop);
+
+  replay_print_stats(&stats);
+  replay_free(&log);
+
+  return result == OSCC_OK ? 0 : 1;
+}
@@ -0,0 +1,557 @@
+/**
+ * @file dbc_codegen.cc
+ * @brief Generates a compile-time codec header from a DBC file.
+ *
+ * Every signal becomes a struct of constants that the templates in
+ * core/include/can_protocols/dbc_codec.h decode and encode, and the header
+ * lists all signals in a metadata table. Messages get CAN ID and length
+ * macros.
+ *
+ * Usage: dbc_codegen <input.dbc> <output.h> [prefix]
+ *
+ * The prefix (default "oscc") names the generated macros and types, e.g.
+ * OSCC_DBC_BRAKE_REPORT_CAN_ID and oscc_dbc_brake_report_enabled_s.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define LINE_SIZE 4096
+
+// Pseudo message holding signals that belong to no message
+#define DBC_INDEPENDENT_SIGNALS "VECTOR__INDEPENDENT_SIG_MSG"
+
+typedef struct
+{
+  std::string name;
+  unsigned int start_bit;
+  unsigned int length;
+  bool little_endian;
+  bool is_signed;
+  int value_type;
+  double factor;
+  double offset;
+  double minimum;
+  double maximum;
+  std::string unit;
+  std::string comment;
+} dbc_signal_s;
+
+typedef struct
+{
+  unsigned long can_id;
+  std::string name;
+  unsigned int dlc;
+  std::string comment;
+  std::vector<dbc_signal_s> signals;
+} dbc_message_s;
+
+static std::string upper(std::string const& text)
+{
+  std::string result = text;
+  for (size_t i=0; i<result.size(); ++i)
+    result[i] = toupper((unsigned char) result[i]);
+  return result;
+}
+
+static std::string lower(std::string const& text)
+{
+  std::string result = text;
+  for (size_t i=0; i<result.size(); ++i)
+    result[i] = tolower((unsigned char) result[i]);
+  return result;
+}
+
+static const char* skip_space(const char* text)
+{
+  while (*text!='\0' && isspace((unsigned char) *text))
+    ++text;
+  return text;
+}
+
+static bool starts_with(const char* text, const char* prefix)
+{
+  return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+static std::string escape(std::string const& text)
+{
+  std::string result;
+  for (size_t i=0; i<text.size(); ++i)
+  {
+    if (text[i]=='"' || text[i]=='\\')
+      result += '\\';
+    result += text[i];
+  }
+  return result;
+}
+
+// Reads a quoted string starting at text, which may continue on the
+// following lines of the file
+static std::string read_quoted(const char* text, FILE* file)
+{
+  std::string result;
+  const char* open = strchr(text, '"');
+  if (open == NULL)
+    return result;
+
+  std::string rest = open + 1;
+  char line[LINE_SIZE];
+
+  while (true)
+  {
+    size_t close = rest.find('"');
+    if (close != std::string::npos)
+    {
+      result += rest.substr(0, close);
+      break;
+    }
+    result += rest;
+    if (fgets(line, sizeof(line), file) == NULL)
+      break;
+    rest = line;
+  }
+
+  // Collapse line breaks so the text fits a one-line doc comment
+  for (size_t i=0; i<result.size(); ++i)
+  {
+    if (result[i]=='\r' || result[i]=='\n')
+      result[i] = ' ';
+  }
+
+  return result;
+}
+
+static dbc_message_s* find_message(std::vector<dbc_message_s>& messages, unsigned long can_id)
+{
+  for (size_t i=0; i<messages.size(); ++i)
+  {
+    if (messages[i].can_id == can_id)
+      return &messages[i];
+  }
+  return NULL;
+}
+
+static dbc_signal_s* find_signal(std::vector<dbc_message_s>& messages,
+                                 unsigned long can_id,
+                                 const char* name)
+{
+  dbc_message_s* message = find_message(messages, can_id);
+  if (message != NULL)
+  {
+    for (size_t i=0; i<message->signals.size(); ++i)
+    {
+      if (message->signals[i].name == name)
+        return &message->signals[i];
+    }
+  }
+  return NULL;
+}
+
+//  SG_ name [M|mN] : start|length@order sign (factor,offset) [min|max] "unit" receivers
+static bool parse_signal(const char* text, dbc_signal_s* signal)
+{
+  char name[LINE_SIZE];
+  if (sscanf(text, "SG_ %s", name) != 1)
+    return false;
+
+  const char* layout = strchr(text, ':');
+  if (layout == NULL)
+    return false;
+
+  unsigned int start_bit = 0;
+  unsigned int length = 0;
+  char order = 0;
+  char sign = 0;
+  double factor = 1;
+  double offset = 0;
+  double minimum = 0;
+  double maximum = 0;
+
+  int parsed = sscanf(layout + 1,
+                      " %u|%u@%c%c (%lf,%lf) [%lf|%lf]",
+                      &start_bit, &length, &order, &sign,
+                      &factor, &offset, &minimum, &maximum);
+  if (parsed != 8 || (order!='0' && order!='1') || (sign!='+' && sign!='-'))
+    return false;
+
+  signal->name = name;
+  signal->start_bit = start_bit;
+  signal->length = length;
+  signal->little_endian = order == '1';
+  signal->is_signed = sign == '-';
+  signal->value_type = 0;
+  signal->factor = factor;
+  signal->offset = offset;
+  signal->minimum = minimum;
+  signal->maximum = maximum;
+
+  const char* unit = strchr(layout, '"');
+  if (unit != NULL)
+  {
+    const char* unit_end = strchr(unit + 1, '"');
+    if (unit_end != NULL)
+      signal->unit = std::string(unit + 1, unit_end);
+  }
+
+  return true;
+}
+
+static bool parse_dbc(const char* path, std::vector<dbc_message_s>& messages)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    printf("Error: Could not open %s\n", path);
+    return false;
+  }
+
+  bool ok = true;
+  int line_number = 0;
+  char line[LINE_SIZE];
+  dbc_message_s* message = NULL;
+  bool skip_signals = false;
+
+  while (ok && fgets(line, sizeof(line), file) != NULL)
+  {
+    ++line_number;
+    const char* text = skip_space(line);
+
+    if (starts_with(text, "BO_ "))
+    {
+      unsigned long can_id = 0;
+      char name[LINE_SIZE];
+      unsigned int dlc = 0;
+
+      if (sscanf(text, "BO_ %lu %[^: ] : %u", &can_id, name, &dlc) != 3)
+      {
+        printf("Error: %s:%d: malformed message\n", path, line_number);
+        ok = false;
+      }
+      else if (strcmp(name, DBC_INDEPENDENT_SIGNALS) == 0)
+      {
+        message = NULL;
+        skip_signals = true;
+      }
+      else
+      {
+        skip_signals = false;
+        dbc_message_s parsed;
+        parsed.can_id = can_id;
+        parsed.name = name;
+        parsed.dlc = dlc;
+        messages.push_back(parsed);
+        message = &messages.back();
+      }
+    }
+    else if (starts_with(text, "SG_ ") && !skip_signals)
+    {
+      dbc_signal_s signal;
+
+      if (message == NULL || !parse_signal(text, &signal))
+      {
+        printf("Error: %s:%d: malformed signal\n", path, line_number);
+        ok = false;
+      }
+      else
+        message->signals.push_back(signal);
+    }
+    else if (starts_with(text, "SIG_VALTYPE_ "))
+    {
+      unsigned long can_id = 0;
+      char name[LINE_SIZE];
+      int value_type = 0;
+
+      if (sscanf(text, "SIG_VALTYPE_ %lu %s : %d", &can_id, name, &value_type) != 3)
+      {
+        printf("Error: %s:%d: malformed signal value type\n", path, line_number);
+        ok = false;
+      }
+      else
+      {
+        dbc_signal_s* signal = find_signal(messages, can_id, name);
+        if (signal != NULL)
+          signal->value_type = value_type;
+      }
+    }
+    else if (starts_with(text, "CM_ "))
+    {
+      unsigned long can_id = 0;
+      char name[LINE_SIZE];
+
+      if (sscanf(text, "CM_ SG_ %lu %s", &can_id, name) == 2)
+      {
+        dbc_signal_s* signal = find_signal(messages, can_id, name);
+        std::string comment = read_quoted(text, file);
+        if (signal != NULL)
+          signal->comment = comment;
+      }
+      else if (sscanf(text, "CM_ BO_ %lu", &can_id) == 1)
+      {
+        dbc_message_s* commented = find_message(messages, can_id);
+        std::string comment = read_quoted(text, file);
+        if (commented != NULL)
+          commented->comment = comment;
+      }
+      else if (strchr(text, ';') == NULL)
+        read_quoted(text, file);
+    }
+    else if (*text!='\0' && strchr(text, '"')!=NULL
+             && std::count(text, text + strlen(text), '"') % 2 != 0)
+    {
+      // Skip the rest of any other multi-line string
+      read_quoted(text, file);
+    }
+  }
+
+  fclose(file);
+  return ok;
+}
+
+static const char* raw_type(dbc_signal_s const& signal)
+{
+  if (signal.length <= 8)
+    return signal.is_signed ? "int8_t" : "uint8_t";
+  if (signal.length <= 16)
+    return signal.is_signed ? "int16_t" : "uint16_t";
+  if (signal.length <= 32)
+    return signal.is_signed ? "int32_t" : "uint32_t";
+  return signal.is_signed ? "int64_t" : "uint64_t";
+}
+
+static const char* value_type(dbc_signal_s const& signal)
+{
+  if (signal.value_type == 1)
+    return "float";
+  if (signal.value_type == 2 || signal.factor != 1 || signal.offset != 0)
+    return "double";
+  return raw_type(signal);
+}
+
+static const char* value_type_name(dbc_signal_s const& signal)
+{
+  if (signal.value_type == 1)
+    return "DBC_VALUE_FLOAT";
+  if (signal.value_type == 2)
+    return "DBC_VALUE_DOUBLE";
+  return "DBC_VALUE_INTEGER";
+}
+
+static bool check_signal(dbc_message_s const& message, dbc_signal_s const& signal)
+{
+  bool ok = signal.length>0 && signal.length<=64;
+
+  if (ok && (signal.value_type==1 && signal.length!=32))
+    ok = false;
+  if (ok && (signal.value_type==2 && signal.length!=64))
+    ok = false;
+
+  if (!ok)
+    printf("Error: Signal %s of %s has an unsupported layout\n",
+           signal.name.c_str(),
+           message.name.c_str());
+
+  return ok;
+}
+
+// Writes a double so that it reads back as the same value
+static std::string literal(double value)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "%.17g", value);
+  std::string result = text;
+  if (result.find_first_of(".eEn") == std::string::npos)
+    result += ".0";
+  return result;
+}
+
+static bool write_header(const char* path,
+                         const char* source,
+                         std::string const& prefix,
+                         std::vector<dbc_message_s> const& messages)
+{
+  FILE* out = fopen(path, "w");
+  if (out == NULL)
+  {
+    printf("Error: Could not create %s\n", path);
+    return false;
+  }
+
+  std::string macro = upper(prefix) + "_DBC_";
+  std::string type = lower(prefix) + "_dbc_";
+  std::string guard = "_" + upper(prefix) + "_DBC_H_";
+  const char* base = strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 : path;
+  size_t signal_count = 0;
+
+  fprintf(out,
+          "/**\n"
+          " * @file %s\n"
+          " * @brief Codec generated by tools/dbc_codegen from %s. Do not edit.\n"
+          " */\n"
+          "\n"
+          "#ifndef %s\n"
+          "#define %s\n"
+          "\n"
+          "\n"
+          "#include <stdint.h>\n"
+          "\n"
+          "#include \"core/include/can_protocols/dbc_codec.h\"\n",
+          base, source, guard.c_str(), guard.c_str());
+
+  for (size_t m=0; m<messages.size(); ++m)
+  {
+    dbc_message_s const& message = messages[m];
+    std::string message_macro = macro + upper(message.name);
+
+    fprintf(out,
+            "\n"
+            "\n"
+            "/*\n"
+            " * @brief %s%s%s\n"
+            " */\n"
+            "#define %s_CAN_ID ( 0x%lX )\n"
+            "#define %s_DLC ( %u )\n",
+            message.name.c_str(),
+            message.comment.empty() ? "" : " - ",
+            message.comment.c_str(),
+            message_macro.c_str(), message.can_id,
+            message_macro.c_str(), message.dlc);
+
+    for (size_t s=0; s<message.signals.size(); ++s)
+    {
+      dbc_signal_s const& signal = message.signals[s];
+      if (!check_signal(message, signal))
+      {
+        fclose(out);
+        remove(path);
+        return false;
+      }
+
+      fprintf(out,
+              "\n"
+              "/**\n"
+              " * @brief %s: %u|%u@%c%c (%g,%g)%s%s\n"
+              " */\n"
+              "struct %s%s_s\n"
+              "{\n"
+              "  typedef %s raw_t;\n"
+              "  typedef %s value_t;\n"
+              "  static constexpr uint32_t can_id = 0x%lX;\n"
+              "  static constexpr uint16_t start_bit = %u;\n"
+              "  static constexpr uint8_t length = %u;\n"
+              "  static constexpr bool little_endian = %s;\n"
+              "  static constexpr bool is_signed = %s;\n"
+              "  static constexpr dbc_value_type_t value_type = %s;\n"
+              "  static constexpr double factor = %s;\n"
+              "  static constexpr double offset = %s;\n"
+              "  static constexpr double minimum = %s;\n"
+              "  static constexpr double maximum = %s;\n"
+              "};\n",
+              signal.name.c_str(),
+              signal.start_bit, signal.length,
+              signal.little_endian ? '1' : '0',
+              signal.is_signed ? '-' : '+',
+              signal.factor, signal.offset,
+              signal.comment.empty() ? "" : " - ",
+              signal.comment.c_str(),
+              type.c_str(), signal.name.c_str(),
+              raw_type(signal),
+              value_type(signal),
+              message.can_id,
+              signal.start_bit,
+              signal.length,
+              signal.little_endian ? "true" : "false",
+              signal.is_signed ? "true" : "false",
+              value_type_name(signal),
+              literal(signal.factor).c_str(),
+              literal(signal.offset).c_str(),
+              literal(signal.minimum).c_str(),
+              literal(signal.maximum).c_str());
+
+      ++signal_count;
+    }
+  }
+
+  fprintf(out,
+          "\n"
+          "\n"
+          "/*\n"
+          " * @brief Every signal of %s, in file order.\n"
+          " */\n"
+          "#define %sSIGNAL_COUNT ( %zu )\n"
+          "\n"
+          "static constexpr dbc_signal_info_s %ssignals[%sSIGNAL_COUNT] =\n"
+          "{\n",
+          source,
+          macro.c_str(), signal_count,
+          type.c_str(), macro.c_str());
+
+  for (size_t m=0; m<messages.size(); ++m)
+  {
+    dbc_message_s const& message = messages[m];
+
+    for (size_t s=0; s<message.signals.size(); ++s)
+    {
+      dbc_signal_s const& signal = message.signals[s];
+
+      fprintf(out,
+              "  { \"%s\", \"%s\", 0x%lX, %u, %u, %u, %s, %s, %s, %s, %s, %s, %s, \"%s\" },\n",
+              signal.name.c_str(),
+              message.name.c_str(),
+              message.can_id,
+              message.dlc,
+              signal.start_bit,
+              signal.length,
+              signal.little_endian ? "true" : "false",
+              signal.is_signed ? "true" : "false",
+              value_type_name(signal),
+              literal(signal.factor).c_str(),
+              literal(signal.offset).c_str(),
+              literal(signal.minimum).c_str(),
+              literal(signal.maximum).c_str(),
+              escape(signal.unit).c_str());
+    }
+  }
+
+  fprintf(out,
+          "};\n"
+          "\n"
+          "\n"
+          "#endif // %s\n",
+          guard.c_str());
+
+  bool ok = ferror(out) == 0;
+  if (fclose(out) != 0)
+    ok = false;
+  if (!ok)
+    printf("Error: Writing %s failed\n", path);
+
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3 || argc > 4)
+  {
+    printf("Usage: %s <input.dbc> <output.h> [prefix]\n", argv[0]);
+    return 1;
+  }
+
+  std::string prefix = argc > 3 ? argv[3] : "oscc";
+  std::vector<dbc_message_s> messages;
+
+  if (!parse_dbc(argv[1], messages))
+    return 1;
+
+  const char* source = strrchr(argv[1], '/') != NULL ? strrchr(argv[1], '/') + 1 : argv[1];
+  if (!write_header(argv[2], source, prefix, messages))
+    return 1;
+
+  return 0;
+}
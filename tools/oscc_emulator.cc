@@ -0,0 +1,544 @@
+/**
+ * @file oscc_emulator.cc
+ * @brief Emulates the OSCC brake, steering and throttle modules on a CAN
+ *        interface, usually vcan, so the library and the commander can run
+ *        end to end without hardware.
+ *
+ * Like the firmware, each module:
+ * - is enabled and disabled by its enable and disable frames,
+ * - takes commands only while enabled,
+ * - publishes its report at its OSCC_*_PUBLISH_FREQ_IN_HZ rate,
+ * - disables itself and publishes a fault report on an operator override
+ *   or when no command arrives within the command timeout,
+ * - disables itself when any module reports a fault.
+ * Packed commands are accepted too.
+ *
+ * Overrides use the kia_niro.h thresholds against emulated driver input,
+ * read from stdin one line at a time:
+ *
+ *   brake <pedal position steps>      BRAKE_PEDAL_OVERRIDE_THRESHOLD
+ *   steering <torque difference>      TORQUE_DIFFERENCE_OVERRIDE_THRESHOLD
+ *   throttle <accelerator steps>      ACCELERATOR_OVERRIDE_THRESHOLD
+ *
+ * Setting the input back below the threshold clears the override, after
+ * which the module can be enabled again.
+ *
+ * Usage: oscc_emulator [-t timeout_ms] [-e] <interface>
+ *
+ *   -t  Command timeout, 0 to never time out (default 250 ms)
+ *   -e  Also publish a report right after every enable, disable and command
+ *       frame, so round-trip latency is not hidden by the report period
+ */
+
+#include <errno.h>
+#include <linux/can/raw.h>
+#include <math.h>
+#include <net/if.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/include/oscc.h"
+#include "core/include/periodic_executor.h"
+#include "core/include/vehicles/kia_niro.h"
+
+#define DEFAULT_COMMAND_TIMEOUT_MS 250
+#define LINE_SIZE 128
+
+static_assert(OSCC_BRAKE_REPORT_PUBLISH_FREQ_IN_HZ == OSCC_REPORT_STEERING_PUBLISH_FREQ_IN_HZ
+              && OSCC_BRAKE_REPORT_PUBLISH_FREQ_IN_HZ == OSCC_REPORT_THROTTLE_PUBLISH_FREQ_IN_HZ,
+              "All reports are published by one periodic task");
+
+typedef enum
+{
+  MODULE_BRAKE,
+  MODULE_STEERING,
+  MODULE_THROTTLE,
+  MODULE_COUNT
+} module_t;
+
+typedef struct
+{
+  const char* name;
+  fault_origin_id_t fault_origin;
+  canid_t enable_can_id;
+  canid_t disable_can_id;
+  canid_t command_can_id;
+  canid_t report_can_id;
+  double override_threshold; /*!< Driver input above which the operator
+                              *   overrides the module. */
+  uint8_t override_dtc; /*!< DTC bit of an operator override. */
+} module_info_s;
+
+typedef struct
+{
+  bool enabled;
+  bool operator_override;
+  uint8_t dtcs;
+  float command;
+  double driver_input;
+  uint64_t last_command_ns;
+} module_state_s;
+
+static const module_info_s global_modules[MODULE_COUNT] =
+{
+  {
+    "brake",
+    FAULT_ORIGIN_BRAKE,
+    OSCC_BRAKE_ENABLE_CAN_ID,
+    OSCC_BRAKE_DISABLE_CAN_ID,
+    OSCC_BRAKE_COMMAND_CAN_ID,
+    OSCC_BRAKE_REPORT_CAN_ID,
+    BRAKE_PEDAL_OVERRIDE_THRESHOLD,
+    OSCC_BRAKE_DTC_OPERATOR_OVERRIDE
+  },
+  {
+    "steering",
+    FAULT_ORIGIN_STEERING,
+    OSCC_STEERING_ENABLE_CAN_ID,
+    OSCC_STEERING_DISABLE_CAN_ID,
+    OSCC_STEERING_COMMAND_CAN_ID,
+    OSCC_STEERING_REPORT_CAN_ID,
+    TORQUE_DIFFERENCE_OVERRIDE_THRESHOLD,
+    OSCC_STEERING_DTC_OPERATOR_OVERRIDE
+  },
+  {
+    "throttle",
+    FAULT_ORIGIN_THROTTLE,
+    OSCC_THROTTLE_ENABLE_CAN_ID,
+    OSCC_THROTTLE_DISABLE_CAN_ID,
+    OSCC_THROTTLE_COMMAND_CAN_ID,
+    OSCC_THROTTLE_REPORT_CAN_ID,
+    ACCELERATOR_OVERRIDE_THRESHOLD,
+    OSCC_THROTTLE_DTC_OPERATOR_OVERRIDE
+  }
+};
+
+static volatile sig_atomic_t global_stop = 0;
+
+// Shared by the frame loop and the periodic report task
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static module_state_s global_states[MODULE_COUNT];
+static int global_socket = -1;
+static uint64_t global_command_timeout_ns = DEFAULT_COMMAND_TIMEOUT_MS * 1000000ULL;
+static bool global_echo_reports = false;
+static unsigned long long global_frames_received = 0;
+static unsigned long long global_reports_sent = 0;
+static unsigned long long global_faults_sent = 0;
+
+static void signal_handler(int signal_number)
+{
+  if (signal_number == SIGINT || signal_number == SIGTERM)
+    global_stop = 1;
+}
+
+static uint64_t monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool has_magic(uint8_t const* data, uint8_t len)
+{
+  return len>=2 && data[0]==OSCC_MAGIC_BYTE_0 && data[1]==OSCC_MAGIC_BYTE_1;
+}
+
+static void write_frame(canid_t can_id, void const* data, size_t len)
+{
+  struct can_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = can_id;
+  frame.can_dlc = len;
+  memcpy(frame.data, data, len);
+
+  if (write(global_socket, &frame, CAN_MTU) != CAN_MTU)
+    perror("Writing frame failed:");
+}
+
+// The three reports share one layout
+template <typename report_t>
+static void write_report(module_t module)
+{
+  module_state_s const* state = &global_states[module];
+  report_t report;
+
+  memset(&report, 0, sizeof(report));
+  report.magic[0] = OSCC_MAGIC_BYTE_0;
+  report.magic[1] = OSCC_MAGIC_BYTE_1;
+  report.enabled = state->enabled;
+  report.operator_override = state->operator_override;
+  report.dtcs = state->dtcs;
+
+  write_frame(global_modules[module].report_can_id, &report, sizeof(report));
+  ++global_reports_sent;
+}
+
+static void publish_report(module_t module)
+{
+  if (module == MODULE_BRAKE)
+    write_report<oscc_brake_report_s>(module);
+  else if (module == MODULE_STEERING)
+    write_report<oscc_steering_report_s>(module);
+  else
+    write_report<oscc_throttle_report_s>(module);
+}
+
+// Every module disables itself when any module reports a fault
+static void disable_all()
+{
+  for (int m=0; m<MODULE_COUNT; ++m)
+    global_states[m].enabled = false;
+}
+
+static void publish_fault(module_t module, const char* reason)
+{
+  oscc_fault_report_s fault;
+  memset(&fault, 0, sizeof(fault));
+  fault.magic[0] = OSCC_MAGIC_BYTE_0;
+  fault.magic[1] = OSCC_MAGIC_BYTE_1;
+  fault.fault_origin_id = global_modules[module].fault_origin;
+  fault.dtcs = global_states[module].dtcs;
+
+  write_frame(OSCC_FAULT_REPORT_CAN_ID, &fault, sizeof(fault));
+  ++global_faults_sent;
+
+  printf("%s: fault, %s\n", global_modules[module].name, reason);
+  disable_all();
+}
+
+static void enable_module(module_t module)
+{
+  module_state_s* state = &global_states[module];
+
+  // Like the firmware, a module stays disabled while overridden
+  if (!state->enabled && !state->operator_override)
+  {
+    state->enabled = true;
+    state->last_command_ns = monotonic_ns();
+    printf("%s: enabled\n", global_modules[module].name);
+  }
+}
+
+static void disable_module(module_t module)
+{
+  if (global_states[module].enabled)
+  {
+    global_states[module].enabled = false;
+    printf("%s: disabled\n", global_modules[module].name);
+  }
+}
+
+static void command_module(module_t module, float command)
+{
+  module_state_s* state = &global_states[module];
+
+  // Commands keep the module from timing out even while disabled, but only
+  // drive the actuator while enabled
+  state->last_command_ns = monotonic_ns();
+  if (state->enabled)
+    state->command = command;
+}
+
+static void check_override(module_t module)
+{
+  module_info_s const* info = &global_modules[module];
+  module_state_s* state = &global_states[module];
+  bool overridden = state->driver_input > info->override_threshold;
+
+  if (overridden && state->enabled)
+  {
+    state->operator_override = true;
+    state->dtcs |= 1 << info->override_dtc;
+    publish_fault(module, "operator override");
+  }
+  else if (!overridden && state->operator_override)
+  {
+    state->operator_override = false;
+    state->dtcs &= ~(1 << info->override_dtc);
+    printf("%s: override cleared\n", info->name);
+  }
+}
+
+static void check_timeouts(uint64_t now_ns)
+{
+  for (int m=0; m<MODULE_COUNT; ++m)
+  {
+    module_state_s const* state = &global_states[m];
+
+    if (global_command_timeout_ns>0
+        && state->enabled
+        && now_ns-state->last_command_ns>global_command_timeout_ns)
+      publish_fault((module_t) m, "command timeout");
+  }
+}
+
+static void handle_frame(struct canfd_frame const* frame)
+{
+  ++global_frames_received;
+
+  if (!has_magic(frame->data, frame->len))
+    return;
+
+  if (frame->can_id == OSCC_FAULT_REPORT_CAN_ID)
+  {
+    printf("fault report received\n");
+    disable_all();
+    return;
+  }
+
+  if (frame->can_id==OSCC_PACKED_COMMAND_CAN_ID && frame->len>=sizeof(oscc_packed_command_s))
+  {
+    oscc_packed_command_s packed;
+    memcpy(&packed, frame->data, sizeof(packed));
+    command_module(MODULE_BRAKE, packed.brake_command);
+    command_module(MODULE_STEERING, packed.steering_command);
+    command_module(MODULE_THROTTLE, packed.throttle_command);
+
+    for (int m=0; global_echo_reports && m<MODULE_COUNT; ++m)
+      publish_report((module_t) m);
+    return;
+  }
+
+  for (int m=0; m<MODULE_COUNT; ++m)
+  {
+    module_info_s const* info = &global_modules[m];
+    module_t module = (module_t) m;
+
+    if (frame->can_id == info->enable_can_id)
+      enable_module(module);
+    else if (frame->can_id == info->disable_can_id)
+      disable_module(module);
+    else if (frame->can_id==info->command_can_id && frame->len>=2+sizeof(float))
+    {
+      // Every command carries its float right after the magic
+      float command = 0.0f;
+      memcpy(&command, &frame->data[2], sizeof(command));
+      command_module(module, command);
+    }
+    else
+      continue;
+
+    if (global_echo_reports)
+      publish_report(module);
+    return;
+  }
+}
+
+static void handle_input_line(const char* line)
+{
+  char name[LINE_SIZE];
+  double value = 0.0;
+
+  if (sscanf(line, "%127s %lf", name, &value) != 2)
+  {
+    printf("Error: Expected \"<brake|steering|throttle> <driver input>\"\n");
+    return;
+  }
+
+  for (int m=0; m<MODULE_COUNT; ++m)
+  {
+    if (strcmp(name, global_modules[m].name) == 0)
+    {
+      global_states[m].driver_input = fabs(value);
+      check_override((module_t) m);
+      return;
+    }
+  }
+
+  printf("Error: Unknown module %s\n", name);
+}
+
+static oscc_result_t publish_reports(void* user_data)
+{
+  (void) user_data;
+
+  pthread_mutex_lock(&global_lock);
+
+  check_timeouts(monotonic_ns());
+  for (int m=0; m<MODULE_COUNT; ++m)
+  {
+    check_override((module_t) m);
+    publish_report((module_t) m);
+  }
+
+  pthread_mutex_unlock(&global_lock);
+
+  return OSCC_OK;
+}
+
+static void* report_thread(void* arg)
+{
+  periodic_executor_s* executor = (periodic_executor_s*) arg;
+  periodic_executor_run(executor, publish_reports, NULL, &global_stop);
+  return NULL;
+}
+
+static int open_socket(const char* interface)
+{
+  int sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (sock < 0)
+  {
+    perror("Opening CAN socket failed:");
+    return -1;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface);
+
+  // The module input IDs, the packed command and fault reports of others
+  struct can_filter filters[] =
+  {
+    { OSCC_BRAKE_CAN_ID_INDEX, CAN_SFF_MASK & ~0x3 },
+    { OSCC_STEERING_CAN_ID_INDEX, CAN_SFF_MASK & ~0x3 },
+    { OSCC_THROTTLE_CAN_ID_INDEX, CAN_SFF_MASK & ~0x3 },
+    { OSCC_PACKED_COMMAND_CAN_ID, CAN_SFF_MASK },
+    { OSCC_FAULT_REPORT_CAN_ID, CAN_SFF_MASK }
+  };
+
+  int enable = 1;
+  bool valid = ioctl(sock, SIOCGIFINDEX, &ifr) == 0
+               && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FILTER, filters, sizeof(filters)) == 0
+               && setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) == 0;
+
+  if (valid)
+  {
+    struct sockaddr_can address;
+    memset(&address, 0, sizeof(address));
+    address.can_family = AF_CAN;
+    address.can_ifindex = ifr.ifr_ifindex;
+    valid = bind(sock, (struct sockaddr*) &address, sizeof(address)) == 0;
+  }
+
+  if (!valid)
+  {
+    printf("Error: Could not open interface %s: %s\n", interface, strerror(errno));
+    close(sock);
+    sock = -1;
+  }
+
+  return sock;
+}
+
+int main(int argc, char** argv)
+{
+  int option = 0;
+
+  while ((option = getopt(argc, argv, "t:e")) != -1)
+  {
+    if (option == 't')
+      global_command_timeout_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+    else if (option == 'e')
+      global_echo_reports = true;
+    else
+      optind = argc + 1;
+  }
+
+  if (optind != argc - 1)
+  {
+    printf("Usage: %s [-t timeout_ms] [-e] <interface>\n", argv[0]);
+    return 1;
+  }
+
+  global_socket = open_socket(argv[optind]);
+  if (global_socket < 0)
+    return 1;
+
+  struct sigaction sig;
+  memset(&sig, 0, sizeof(sig));
+  sig.sa_handler = signal_handler;
+  sigaction(SIGINT, &sig, NULL);
+  sigaction(SIGTERM, &sig, NULL);
+
+  periodic_executor_s executor;
+  pthread_t thread;
+
+  // Signals go to this thread, so they interrupt the poll below
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  bool started = periodic_executor_init(&executor, 1000000 / OSCC_BRAKE_REPORT_PUBLISH_FREQ_IN_HZ) == OSCC_OK
+                 && pthread_create(&thread, NULL, report_thread, &executor) == 0;
+
+  pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+
+  if (!started)
+  {
+    printf("Error: Could not start publishing reports\n");
+    close(global_socket);
+    return 1;
+  }
+
+  printf("Emulating OSCC modules on %s\n", argv[optind]);
+
+  struct pollfd fds[2];
+  fds[0].fd = global_socket;
+  fds[0].events = POLLIN;
+  fds[1].fd = STDIN_FILENO;
+  fds[1].events = POLLIN;
+  nfds_t fd_count = 2;
+
+  while (!global_stop)
+  {
+    if (poll(fds, fd_count, -1) < 0)
+    {
+      if (errno != EINTR)
+        perror("Polling failed:");
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      struct canfd_frame frame;
+      ssize_t size = read(global_socket, &frame, sizeof(frame));
+
+      if (size==CAN_MTU || size==CANFD_MTU)
+      {
+        pthread_mutex_lock(&global_lock);
+        handle_frame(&frame);
+        pthread_mutex_unlock(&global_lock);
+      }
+    }
+
+    if (fds[1].revents & (POLLIN | POLLHUP))
+    {
+      char line[LINE_SIZE];
+
+      // Keep running on the bus after the input ends
+      if (fgets(line, sizeof(line), stdin) == NULL)
+        fd_count = 1;
+      else
+      {
+        pthread_mutex_lock(&global_lock);
+        handle_input_line(line);
+        pthread_mutex_unlock(&global_lock);
+      }
+    }
+
+    fflush(stdout);
+  }
+
+  pthread_join(thread, NULL);
+
+  printf("frames received=%llu reports sent=%llu faults sent=%llu\n",
+         global_frames_received,
+         global_reports_sent,
+         global_faults_sent);
+  periodic_executor_print_stats(&executor, "reports");
+
+  periodic_executor_close(&executor);
+  close(global_socket);
+
+  return 0;
+}